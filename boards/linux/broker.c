@@ -0,0 +1,872 @@
+/**
+ * \file
+ * \brief  Local MQTT broker standing in for the GCP IoT Core MQTT bridge
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+/*
+ * A single process epoll broker built on the MQTTPacket server serializers. It
+ * accepts what the GCP bridge accepts - MQTT 3.1.1, QoS 0 and 1, topics under
+ * the device's own /devices/<id>/ - and verifies ES256 JWT passwords, so
+ * connection storm, auth latency and publish throughput runs need no cloud.
+ *
+ * Every connection and its buffers are allocated once at start up. Messages are
+ * acknowledged and counted, not routed.
+ */
+
+/* accept4() */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "MQTTPacket.h"
+#include "jwt_verify.h"
+
+/** Receive and transmit buffer per connection - larger packets close the connection */
+#define BROKER_BUF_SIZE             (4096)
+
+/** Topic filters handled in a single subscribe or unsubscribe */
+#define BROKER_MAX_TOPICS           (8)
+
+/** Device ids longer than this are refused */
+#define BROKER_DEVICE_ID_SIZE       (128)
+
+/** Time allowed between accept and the connect packet */
+#define BROKER_CONNECT_TIMEOUT_MS   (10000)
+
+/** The bridge closes connections idle for longer than 1.5 keep alive periods */
+#define BROKER_KEEPALIVE_GRACE(ka)  ((int64_t)(ka) * 1500)
+
+/** Keep alive used when the client asks for none */
+#define BROKER_DEFAULT_KEEPALIVE    (1200)
+
+#define BROKER_EPOLL_EVENTS         (64)
+#define BROKER_SWEEP_PERIOD_MS      (1000)
+
+/* The listening socket is tagged with an index no connection can have */
+#define BROKER_LISTEN_TAG           (UINT32_MAX)
+
+/* CONNACK return codes */
+#define BROKER_CONNACK_ACCEPTED         (0)
+#define BROKER_CONNACK_BAD_PROTOCOL     (1)
+#define BROKER_CONNACK_BAD_IDENTIFIER   (2)
+#define BROKER_CONNACK_NOT_AUTHORIZED   (5)
+
+#define BROKER_SUBACK_FAILURE       (0x80)
+
+typedef enum
+{
+    BROKER_CONN_FREE = 0,           /**< On the free list */
+    BROKER_CONN_CONNECTING,         /**< Accepted, waiting for the connect packet */
+    BROKER_CONN_CONNECTED,          /**< Connect accepted */
+    BROKER_CONN_CLOSING             /**< Refused - close once the connack is sent */
+} BROKER_CONN_STATES;
+
+typedef struct
+{
+    int         fd;
+    uint8_t     state;
+    uint32_t    next_free;
+    uint16_t    keepalive;          /**< Seconds, from the connect packet */
+    int64_t     last_rx_ms;
+    int         rxlen;
+    int         txlen;
+    int         txoff;
+    int         want_write;         /**< EPOLLOUT is armed instead of EPOLLIN */
+    int         prefix_len;
+    char        prefix[BROKER_DEVICE_ID_SIZE + 16];   /**< /devices/<id>/ */
+    uint8_t     rx[BROKER_BUF_SIZE];
+    uint8_t     tx[BROKER_BUF_SIZE];
+} broker_conn;
+
+typedef struct
+{
+    uint64_t    accepted;
+    uint64_t    rejected;           /**< Accepted with no free connection */
+    uint64_t    connects;
+    uint64_t    refused;            /**< Connack with a failure code */
+    uint64_t    closed;
+    uint64_t    timeouts;           /**< Connect or keep alive expired */
+    uint64_t    protocol_errors;
+    uint64_t    publishes;
+    uint64_t    publish_bytes;
+    uint64_t    subscribes;
+    uint64_t    auth_count;
+    uint64_t    auth_total_us;
+    uint64_t    auth_max_us;
+    uint32_t    active;
+    uint32_t    peak_active;
+} broker_stats;
+
+typedef struct
+{
+    int         port;
+    const char* pubkey_path;
+    const char* audience;
+    uint32_t    max_conns;
+    int         stats_period_s;
+} broker_config;
+
+static broker_conn* g_conns;
+static uint32_t g_free_head = BROKER_LISTEN_TAG;
+static int g_epoll = -1;
+static int g_listen = -1;
+static int g_verify_jwt;
+static broker_config g_config = { 1883, NULL, "host-project", 1024, 0 };
+static broker_stats g_stats;
+static volatile sig_atomic_t g_running = 1;
+
+static int64_t broker_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t broker_now_ms(void)
+{
+    return broker_now_us() / 1000;
+}
+
+static void broker_signal(int sig)
+{
+    (void)sig;
+    g_running = 0;
+}
+
+static void broker_print_stats(void)
+{
+    printf("active=%u peak_active=%u accepted=%llu rejected=%llu connects=%llu refused=%llu "
+        "closed=%llu timeouts=%llu protocol_errors=%llu publishes=%llu publish_bytes=%llu "
+        "subscribes=%llu auth_count=%llu auth_avg_us=%llu auth_max_us=%llu\n",
+        g_stats.active, g_stats.peak_active,
+        (unsigned long long)g_stats.accepted, (unsigned long long)g_stats.rejected,
+        (unsigned long long)g_stats.connects, (unsigned long long)g_stats.refused,
+        (unsigned long long)g_stats.closed, (unsigned long long)g_stats.timeouts,
+        (unsigned long long)g_stats.protocol_errors, (unsigned long long)g_stats.publishes,
+        (unsigned long long)g_stats.publish_bytes, (unsigned long long)g_stats.subscribes,
+        (unsigned long long)g_stats.auth_count,
+        (unsigned long long)(g_stats.auth_count ? g_stats.auth_total_us / g_stats.auth_count : 0),
+        (unsigned long long)g_stats.auth_max_us);
+    fflush(stdout);
+}
+
+/* Allocate every connection up front and chain them on the free list */
+static int broker_conns_init(uint32_t count)
+{
+    uint32_t i;
+
+    if (NULL == (g_conns = calloc(count, sizeof(broker_conn))))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        g_conns[i].fd = -1;
+        g_conns[i].next_free = (i + 1 < count) ? i + 1 : BROKER_LISTEN_TAG;
+    }
+    g_free_head = 0;
+
+    return 0;
+}
+
+static void broker_conn_close(broker_conn* conn)
+{
+    uint32_t index = (uint32_t)(conn - g_conns);
+
+    epoll_ctl(g_epoll, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+
+    conn->fd = -1;
+    conn->state = BROKER_CONN_FREE;
+    conn->next_free = g_free_head;
+    g_free_head = index;
+
+    g_stats.closed++;
+    g_stats.active--;
+}
+
+/* Wait to read, or for the socket to take the queued replies - nothing is read while they are held
+ * up, as the replies to more packets might not fit behind them */
+static int broker_conn_events(broker_conn* conn, int want_write)
+{
+    struct epoll_event ev;
+
+    if (conn->want_write == want_write)
+    {
+        return 0;
+    }
+
+    ev.events = want_write ? EPOLLOUT : EPOLLIN;
+    ev.data.u32 = (uint32_t)(conn - g_conns);
+    conn->want_write = want_write;
+
+    return epoll_ctl(g_epoll, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+/* Send what is queued - returns -1 if the connection has to be closed */
+static int broker_conn_flush(broker_conn* conn)
+{
+    ssize_t rc;
+
+    while (conn->txoff < conn->txlen)
+    {
+        rc = send(conn->fd, &conn->tx[conn->txoff], conn->txlen - conn->txoff, MSG_NOSIGNAL);
+        if (rc < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if (EAGAIN == errno || EWOULDBLOCK == errno)
+            {
+                return broker_conn_events(conn, 1);
+            }
+            return -1;
+        }
+        conn->txoff += (int)rc;
+    }
+
+    conn->txoff = 0;
+    conn->txlen = 0;
+
+    if (BROKER_CONN_CLOSING == conn->state)
+    {
+        return -1;
+    }
+    return broker_conn_events(conn, 0);
+}
+
+static int broker_protocol_error(void)
+{
+    g_stats.protocol_errors++;
+    return -1;
+}
+
+/* Account for a serialized reply - a batch of packets is answered and flushed before the next is
+ * read, so the replies always fit */
+static int broker_conn_queued(broker_conn* conn, int len)
+{
+    if (len <= 0)
+    {
+        return -1;
+    }
+    conn->txlen += len;
+    return 0;
+}
+
+/* Take the device id from projects/<p>/locations/<r>/registries/<g>/devices/<id> */
+static int broker_device_prefix(broker_conn* conn, MQTTString* client_id)
+{
+    static const char devices[] = "/devices/";
+    const char* id = client_id->lenstring.data;
+    int len = client_id->lenstring.len;
+    int i;
+
+    for (i = len - (int)sizeof(devices) + 1; i >= 0; i--)
+    {
+        if (!memcmp(&id[i], devices, sizeof(devices) - 1))
+        {
+            break;
+        }
+    }
+    if (i < 0)
+    {
+        return -1;
+    }
+
+    id += i + sizeof(devices) - 1;
+    len -= i + sizeof(devices) - 1;
+    if (len <= 0 || len > BROKER_DEVICE_ID_SIZE || memchr(id, '/', len))
+    {
+        return -1;
+    }
+
+    conn->prefix_len = snprintf(conn->prefix, sizeof(conn->prefix), "%s%.*s/", devices, len, id);
+    return 0;
+}
+
+static int broker_topic_allowed(broker_conn* conn, MQTTString* topic)
+{
+    return topic->lenstring.len > conn->prefix_len
+        && !memcmp(topic->lenstring.data, conn->prefix, conn->prefix_len);
+}
+
+static int broker_handle_connect(broker_conn* conn, uint8_t* buf, int len)
+{
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    uint8_t connack_rc = BROKER_CONNACK_ACCEPTED;
+    int64_t start;
+    int64_t elapsed;
+    int rc;
+
+    if (1 != MQTTDeserialize_connect(&data, buf, len))
+    {
+        return broker_protocol_error();
+    }
+
+    if (4 != data.MQTTVersion)
+    {
+        connack_rc = BROKER_CONNACK_BAD_PROTOCOL;
+    }
+    else if (broker_device_prefix(conn, &data.clientID))
+    {
+        connack_rc = BROKER_CONNACK_BAD_IDENTIFIER;
+    }
+    else if (g_verify_jwt)
+    {
+        start = broker_now_us();
+        rc = jwt_verify(data.password.lenstring.data, data.password.lenstring.len,
+            g_config.audience, (int64_t)time(NULL));
+        elapsed = broker_now_us() - start;
+
+        g_stats.auth_count++;
+        g_stats.auth_total_us += elapsed;
+        if ((uint64_t)elapsed > g_stats.auth_max_us)
+        {
+            g_stats.auth_max_us = elapsed;
+        }
+
+        if (JWT_VERIFY_OK != rc)
+        {
+            fprintf(stderr, "%.*s: %s\n", data.clientID.lenstring.len, data.clientID.lenstring.data,
+                jwt_verify_error(rc));
+            connack_rc = BROKER_CONNACK_NOT_AUTHORIZED;
+        }
+    }
+
+    if (BROKER_CONNACK_ACCEPTED == connack_rc)
+    {
+        conn->state = BROKER_CONN_CONNECTED;
+        conn->keepalive = data.keepAliveInterval ? data.keepAliveInterval : BROKER_DEFAULT_KEEPALIVE;
+        g_stats.connects++;
+    }
+    else
+    {
+        conn->state = BROKER_CONN_CLOSING;
+        g_stats.refused++;
+    }
+
+    return broker_conn_queued(conn, MQTTSerialize_connack(&conn->tx[conn->txlen], BROKER_BUF_SIZE - conn->txlen, connack_rc, 0));
+}
+
+static int broker_handle_subscribe(broker_conn* conn, uint8_t* buf, int len)
+{
+    MQTTString filters[BROKER_MAX_TOPICS];
+    int qos[BROKER_MAX_TOPICS];
+    unsigned short packetid;
+    unsigned char dup;
+    int count;
+    int i;
+
+    if (1 != MQTTDeserialize_subscribe(&dup, &packetid, BROKER_MAX_TOPICS, &count, filters, qos, buf, len))
+    {
+        return broker_protocol_error();
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (!broker_topic_allowed(conn, &filters[i]))
+        {
+            qos[i] = BROKER_SUBACK_FAILURE;
+        }
+        else if (qos[i] > 1)
+        {
+            qos[i] = 1;
+        }
+    }
+    g_stats.subscribes += count;
+
+    return broker_conn_queued(conn, MQTTSerialize_suback(&conn->tx[conn->txlen], BROKER_BUF_SIZE - conn->txlen, packetid, count, qos));
+}
+
+static int broker_handle_unsubscribe(broker_conn* conn, uint8_t* buf, int len)
+{
+    MQTTString filters[BROKER_MAX_TOPICS];
+    unsigned short packetid;
+    unsigned char dup;
+    int count;
+
+    if (1 != MQTTDeserialize_unsubscribe(&dup, &packetid, BROKER_MAX_TOPICS, &count, filters, buf, len))
+    {
+        return broker_protocol_error();
+    }
+
+    return broker_conn_queued(conn, MQTTSerialize_unsuback(&conn->tx[conn->txlen], BROKER_BUF_SIZE - conn->txlen, packetid));
+}
+
+static int broker_handle_publish(broker_conn* conn, uint8_t* buf, int len)
+{
+    MQTTString topic;
+    unsigned char* payload;
+    int payloadlen;
+    unsigned short packetid;
+    unsigned char dup;
+    unsigned char retained;
+    int qos;
+
+    /* The bridge drops the connection for QoS 2 or a topic of another device */
+    if (1 != MQTTDeserialize_publish(&dup, &qos, &retained, &packetid, &topic, &payload, &payloadlen, buf, len)
+        || qos > 1 || !broker_topic_allowed(conn, &topic))
+    {
+        return broker_protocol_error();
+    }
+
+    g_stats.publishes++;
+    g_stats.publish_bytes += payloadlen;
+
+    if (1 == qos)
+    {
+        return broker_conn_queued(conn, MQTTSerialize_puback(&conn->tx[conn->txlen], BROKER_BUF_SIZE - conn->txlen, packetid));
+    }
+    return 0;
+}
+
+/* Handle one complete packet - returns -1 if the connection has to be closed */
+static int broker_handle_packet(broker_conn* conn, uint8_t* buf, int len)
+{
+    MQTTHeader header;
+
+    header.byte = buf[0];
+
+    if (BROKER_CONN_CONNECTING == conn->state)
+    {
+        return (CONNECT == header.bits.type) ? broker_handle_connect(conn, buf, len) : broker_protocol_error();
+    }
+    if (BROKER_CONN_CONNECTED != conn->state)
+    {
+        return 0;
+    }
+
+    switch (header.bits.type)
+    {
+    case PUBLISH:
+        return broker_handle_publish(conn, buf, len);
+    case SUBSCRIBE:
+        return broker_handle_subscribe(conn, buf, len);
+    case UNSUBSCRIBE:
+        return broker_handle_unsubscribe(conn, buf, len);
+    case PINGREQ:
+        return broker_conn_queued(conn, MQTTSerialize_pingresp(&conn->tx[conn->txlen], BROKER_BUF_SIZE - conn->txlen));
+    case DISCONNECT:
+        return -1;
+    default:
+        /* A second CONNECT, QoS 2 flow or a packet only a server sends */
+        return broker_protocol_error();
+    }
+}
+
+/* Split the receive buffer into packets - returns -1 if the connection has to be closed */
+static int broker_conn_parse(broker_conn* conn)
+{
+    int offset = 0;
+    int remaining;
+    int multiplier;
+    int pos;
+    int len;
+
+    while (conn->rxlen - offset >= 2)
+    {
+        /* Remaining length is up to four bytes, seven bits each */
+        remaining = 0;
+        multiplier = 1;
+        pos = offset + 1;
+        do
+        {
+            if (pos >= conn->rxlen)
+            {
+                goto partial;
+            }
+            if (pos - offset > 4)
+            {
+                return broker_protocol_error();
+            }
+            remaining += (conn->rx[pos] & 127) * multiplier;
+            multiplier *= 128;
+        } while (conn->rx[pos++] & 128);
+
+        len = (pos - offset) + remaining;
+        if (len > BROKER_BUF_SIZE)
+        {
+            return broker_protocol_error();
+        }
+        if (offset + len > conn->rxlen)
+        {
+            break;
+        }
+
+        if (broker_handle_packet(conn, &conn->rx[offset], len))
+        {
+            return -1;
+        }
+        offset += len;
+    }
+
+partial:
+    if (offset > 0)
+    {
+        conn->rxlen -= offset;
+        memmove(conn->rx, &conn->rx[offset], conn->rxlen);
+    }
+    return 0;
+}
+
+static int broker_conn_read(broker_conn* conn)
+{
+    ssize_t rc;
+
+    for (;;)
+    {
+        rc = recv(conn->fd, &conn->rx[conn->rxlen], BROKER_BUF_SIZE - conn->rxlen, 0);
+        if (rc == 0)
+        {
+            return -1;
+        }
+        if (rc < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return (EAGAIN == errno || EWOULDBLOCK == errno) ? 0 : -1;
+        }
+
+        conn->rxlen += (int)rc;
+        conn->last_rx_ms = broker_now_ms();
+
+        if (broker_conn_parse(conn) || broker_conn_flush(conn))
+        {
+            return -1;
+        }
+        if (conn->txlen > 0 || conn->rxlen == BROKER_BUF_SIZE)
+        {
+            /* Replies held up, or a full buffer - carry on when epoll says so */
+            return 0;
+        }
+    }
+}
+
+static void broker_accept(void)
+{
+    struct epoll_event ev;
+    broker_conn* conn;
+    uint32_t index;
+    int one = 1;
+    int fd;
+
+    for (;;)
+    {
+        fd = accept4(g_listen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (EINTR == errno || ECONNABORTED == errno)
+            {
+                continue;
+            }
+            return;
+        }
+        g_stats.accepted++;
+
+        if (BROKER_LISTEN_TAG == (index = g_free_head))
+        {
+            g_stats.rejected++;
+            close(fd);
+            continue;
+        }
+
+        conn = &g_conns[index];
+        g_free_head = conn->next_free;
+
+        conn->fd = fd;
+        conn->state = BROKER_CONN_CONNECTING;
+        conn->keepalive = 0;
+        conn->last_rx_ms = broker_now_ms();
+        conn->rxlen = 0;
+        conn->txlen = 0;
+        conn->txoff = 0;
+        conn->want_write = 0;
+        conn->prefix_len = 0;
+
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        ev.events = EPOLLIN;
+        ev.data.u32 = index;
+        if (epoll_ctl(g_epoll, EPOLL_CTL_ADD, fd, &ev))
+        {
+            close(fd);
+            conn->fd = -1;
+            conn->state = BROKER_CONN_FREE;
+            conn->next_free = g_free_head;
+            g_free_head = index;
+            continue;
+        }
+
+        if (++g_stats.active > g_stats.peak_active)
+        {
+            g_stats.peak_active = g_stats.active;
+        }
+    }
+}
+
+/* Close connections that never sent a connect or stopped sending within the keep alive */
+static void broker_sweep(int64_t now)
+{
+    broker_conn* conn;
+    int64_t limit;
+    uint32_t i;
+
+    for (i = 0; i < g_config.max_conns; i++)
+    {
+        conn = &g_conns[i];
+        if (BROKER_CONN_FREE == conn->state)
+        {
+            continue;
+        }
+
+        limit = (BROKER_CONN_CONNECTED == conn->state)
+            ? BROKER_KEEPALIVE_GRACE(conn->keepalive) : BROKER_CONNECT_TIMEOUT_MS;
+        if (now - conn->last_rx_ms > limit)
+        {
+            g_stats.timeouts++;
+            broker_conn_close(conn);
+        }
+    }
+}
+
+static int broker_listen(int port)
+{
+    struct sockaddr_in6 addr;
+    struct epoll_event ev;
+    int zero = 0;
+    int one = 1;
+
+    /* Dual stack, as localhost may resolve to either address family */
+    if (0 > (g_listen = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)))
+    {
+        return -1;
+    }
+    setsockopt(g_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(g_listen, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+
+    if (bind(g_listen, (struct sockaddr*)&addr, sizeof(addr)) || listen(g_listen, SOMAXCONN))
+    {
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.u32 = BROKER_LISTEN_TAG;
+    return epoll_ctl(g_epoll, EPOLL_CTL_ADD, g_listen, &ev);
+}
+
+/* A connection storm needs a descriptor per connection */
+static void broker_raise_fd_limit(uint32_t count)
+{
+    struct rlimit rl;
+
+    if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < count + 16)
+    {
+        rl.rlim_cur = (rl.rlim_max < count + 16) ? rl.rlim_max : count + 16;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static void broker_usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [-p port] [-k pubkey.pem] [-a audience] [-c max_connections] [-s stats_seconds]\n"
+        "  -p  listening port (1883)\n"
+        "  -k  EC public key - connect passwords must be ES256 JWTs signed by it\n"
+        "  -a  JWT audience, the GCP project id (host-project)\n"
+        "  -c  connections allocated at start up (1024)\n"
+        "  -s  print statistics every so many seconds (0 - only on exit)\n",
+        name);
+}
+
+int main(int argc, char* argv[])
+{
+    struct epoll_event events[BROKER_EPOLL_EVENTS];
+    struct sigaction sa;
+    broker_conn* conn;
+    int64_t next_sweep;
+    int64_t next_stats;
+    int64_t now;
+    uint32_t tag;
+    int opt;
+    int n;
+    int i;
+
+    while (-1 != (opt = getopt(argc, argv, "p:k:a:c:s:h")))
+    {
+        switch (opt)
+        {
+        case 'p':
+            g_config.port = atoi(optarg);
+            break;
+        case 'k':
+            g_config.pubkey_path = optarg;
+            break;
+        case 'a':
+            g_config.audience = optarg;
+            break;
+        case 'c':
+            g_config.max_conns = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            g_config.stats_period_s = atoi(optarg);
+            break;
+        default:
+            broker_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (g_config.max_conns == 0 || g_config.max_conns >= BROKER_LISTEN_TAG)
+    {
+        broker_usage(argv[0]);
+        return 1;
+    }
+
+    if (g_config.pubkey_path)
+    {
+        if (jwt_verify_init(g_config.pubkey_path))
+        {
+            fprintf(stderr, "Failed to load an EC public key from %s\n", g_config.pubkey_path);
+            return 1;
+        }
+        g_verify_jwt = 1;
+    }
+
+    broker_raise_fd_limit(g_config.max_conns);
+
+    if (broker_conns_init(g_config.max_conns))
+    {
+        fprintf(stderr, "Failed to allocate %u connections\n", g_config.max_conns);
+        return 1;
+    }
+
+    if (0 > (g_epoll = epoll_create1(EPOLL_CLOEXEC)) || broker_listen(g_config.port))
+    {
+        perror("listen");
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = broker_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Listening on port %d, %u connections, JWT %s\n", g_config.port, g_config.max_conns,
+        g_verify_jwt ? "verified" : "not checked");
+    fflush(stdout);
+
+    now = broker_now_ms();
+    next_sweep = now + BROKER_SWEEP_PERIOD_MS;
+    next_stats = now + (int64_t)g_config.stats_period_s * 1000;
+
+    while (g_running)
+    {
+        n = epoll_wait(g_epoll, events, BROKER_EPOLL_EVENTS, BROKER_SWEEP_PERIOD_MS);
+        if (n < 0 && EINTR != errno)
+        {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            tag = events[i].data.u32;
+            if (BROKER_LISTEN_TAG == tag)
+            {
+                broker_accept();
+                continue;
+            }
+
+            conn = &g_conns[tag];
+            if (BROKER_CONN_FREE == conn->state)
+            {
+                continue;
+            }
+
+            if ((events[i].events & (EPOLLERR | EPOLLHUP))
+                || ((events[i].events & EPOLLIN) && broker_conn_read(conn))
+                || broker_conn_flush(conn))
+            {
+                broker_conn_close(conn);
+            }
+        }
+
+        now = broker_now_ms();
+        if (now >= next_sweep)
+        {
+            broker_sweep(now);
+            next_sweep = now + BROKER_SWEEP_PERIOD_MS;
+        }
+        if (g_config.stats_period_s > 0 && now >= next_stats)
+        {
+            broker_print_stats();
+            next_stats = now + (int64_t)g_config.stats_period_s * 1000;
+        }
+    }
+
+    broker_print_stats();
+
+    for (tag = 0; tag < g_config.max_conns; tag++)
+    {
+        if (BROKER_CONN_FREE != g_conns[tag].state)
+        {
+            close(g_conns[tag].fd);
+        }
+    }
+    close(g_listen);
+    close(g_epoll);
+    free(g_conns);
+    jwt_verify_release();
+
+    return 0;
+}
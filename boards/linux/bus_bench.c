@@ -0,0 +1,313 @@
+/**
+ * \file
+ * \brief  WINC1500 SPI transfer splitting benchmarks on a mock bus
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+/*
+ * Runs winc_bus_transfer, as the SAMD21 and SAMG55 bus wrappers set it up, over
+ * a mock bus for the transfer sizes the WINC driver makes. Each case checks the
+ * bytes both ways and the limits the DMA controllers have, then prints one
+ * key=value line: how the transfer was split, its modelled time on the board
+ * against clocking every byte with the CPU, and the host time to split it. A
+ * case that moved the wrong bytes is marked result=fail and the exit status is 1.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "winc_bus.h"
+#include "winc_bus_mock.h"
+
+/** Transfers between clock reads */
+#define BENCH_BATCH         (256)
+
+typedef enum
+{
+    BENCH_WRITE,    /**< Nothing to receive - commands and data written to the WINC */
+    BENCH_READ,     /**< Nothing to send - responses and data read from the WINC */
+    BENCH_BOTH
+} bench_dir;
+
+typedef struct
+{
+    winc_bus_mock_model model;
+    uint16_t    dma_min;        /**< As the board's bus wrapper has it */
+} bench_board;
+
+/* Cycle costs are estimates for the boards' clocks and SPI settings - the crossover is what matters */
+static const bench_board g_boards[] =
+{
+    /* 48 MHz, 12 MHz SPI, DMAC */
+    { { "samd21", 32, 30, 200, 48 }, 8 },
+    /* 120 MHz, 40 MHz SPI, PDC */
+    { { "samg55", 24, 20, 80, 120 }, 8 },
+};
+
+static const char* const g_dir_names[] = { "write", "read", "both" };
+
+/* Sizes the WINC driver transfers - commands and responses, then payloads */
+static const uint16_t g_sizes[] = { 1, 2, 4, 8, 11, 64, 256, 1400, 4096 };
+
+/* DMA limits that split a transfer, and sizes that leave a DMA tail (1400) or one shorter than dma_min */
+static const uint16_t g_split_maxes[] = { 64, 255 };
+static const uint16_t g_split_sizes[] = { 197, 513, 1400 };
+
+static winc_bus_mock g_mock;
+static uint8_t g_mosi[WINC_BUS_MOCK_LOG_SIZE];
+static uint8_t g_miso[WINC_BUS_MOCK_LOG_SIZE];
+
+static int64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* The calls a transfer should have made - DMA pieces no longer than dma_max, then the tail
+ * shorter than dma_min clocked by the CPU */
+static int bench_check_calls(uint16_t size)
+{
+    const winc_bus_ops* ops = &g_mock.ops;
+    uint32_t n = 0;
+    uint16_t len;
+    bool dma;
+
+    while (size)
+    {
+        dma = ops->dma_min && size >= ops->dma_min;
+        len = (dma && size > ops->dma_max) ? ops->dma_max : size;
+
+        if (n >= g_mock.call_count || n >= WINC_BUS_MOCK_LOG_CALLS ||
+            g_mock.calls[n].dma != dma || g_mock.calls[n].len != len)
+        {
+            return -1;
+        }
+
+        n++;
+        size -= len;
+    }
+
+    return (n == g_mock.call_count) ? 0 : -1;
+}
+
+/* One transfer - returns 0 if it was split as it should be and the right bytes went both ways */
+static int bench_check(bench_dir dir, uint16_t size)
+{
+    const uint8_t* mosi = (dir == BENCH_READ) ? NULL : g_mosi;
+    uint8_t* miso = (dir == BENCH_WRITE) ? NULL : g_miso;
+    uint16_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        g_mosi[i] = (uint8_t)(i * 13 + 1);
+        g_miso[i] = 0xAA;
+    }
+
+    if (winc_bus_transfer(&g_mock.ops, mosi, miso, size))
+    {
+        return -1;
+    }
+
+    if (g_mock.errors || g_mock.selects != 1 || g_mock.selected || g_mock.position != size ||
+        g_mock.pio_bytes + g_mock.dma_bytes != size || bench_check_calls(size))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < size; i++)
+    {
+        if (g_mock.sent[i] != (mosi ? mosi[i] : 0) || (miso && miso[i] != winc_bus_mock_byte(i)))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* A transfer longer than the DMA takes, split into pieces and a tail */
+static int bench_run_split(const bench_board* board, bench_dir dir, uint16_t dma_max, uint16_t size)
+{
+    int failed;
+
+    winc_bus_mock_init(&g_mock, &board->model, board->dma_min, dma_max);
+
+    failed = bench_check(dir, size);
+
+    printf("bench=bus board=%s case=split dma_max=%u dir=%s size=%u dma_transfers=%llu pio_bytes=%llu result=%s\n",
+        board->model.name, dma_max, g_dir_names[dir], size, (unsigned long long)g_mock.dma_calls,
+        (unsigned long long)g_mock.pio_bytes, failed ? "fail" : "pass");
+    fflush(stdout);
+
+    return failed ? 1 : 0;
+}
+
+/* A DMA transfer that fails must come back as an error with the chip select released */
+static int bench_run_failure(const bench_board* board)
+{
+    int rc;
+    int failed;
+
+    winc_bus_mock_init(&g_mock, &board->model, board->dma_min, UINT16_MAX);
+    g_mock.dma_fails = true;
+
+    rc = winc_bus_transfer(&g_mock.ops, g_mosi, g_miso, 1400);
+    failed = (rc != WINC_BUS_ERR_DMA || g_mock.errors || g_mock.selects != 1 || g_mock.selected ||
+        g_mock.dma_calls != 1);
+
+    printf("bench=bus board=%s case=dma_failure rc=%d result=%s\n",
+        board->model.name, rc, failed ? "fail" : "pass");
+    fflush(stdout);
+
+    return failed ? 1 : 0;
+}
+
+static int bench_run_case(const bench_board* board, bench_dir dir, uint16_t size, int64_t duration_ns)
+{
+    const uint8_t* mosi = (dir == BENCH_READ) ? NULL : g_mosi;
+    uint8_t* miso = (dir == BENCH_WRITE) ? NULL : g_miso;
+    const winc_bus_mock_model* model = &board->model;
+    uint64_t cpu_only_cycles = (uint64_t)size * (model->wire_cycles + model->pio_cycles);
+    uint64_t transfers = 0;
+    uint64_t dma_calls;
+    uint64_t pio_bytes;
+    uint64_t cycles;
+    int64_t start;
+    int64_t elapsed;
+    int failed;
+    int i;
+
+    winc_bus_mock_init(&g_mock, model, board->dma_min, UINT16_MAX);
+
+    failed = bench_check(dir, size);
+    dma_calls = g_mock.dma_calls;
+    pio_bytes = g_mock.pio_bytes;
+    cycles = g_mock.cycles;
+
+    start = bench_now_ns();
+    do
+    {
+        for (i = 0; i < BENCH_BATCH; i++)
+        {
+            winc_bus_transfer(&g_mock.ops, mosi, miso, size);
+        }
+        transfers += BENCH_BATCH;
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < duration_ns);
+
+    if (g_mock.errors)
+    {
+        failed = -1;
+    }
+
+    printf("bench=bus board=%s dir=%s size=%u dma_transfers=%llu pio_bytes=%llu bus_us=%.2f cpu_only_us=%.2f "
+        "speedup=%.2f transfers=%llu ns_per_transfer=%.1f result=%s\n",
+        model->name, g_dir_names[dir], size, (unsigned long long)dma_calls, (unsigned long long)pio_bytes,
+        (double)cycles / model->cpu_mhz, (double)cpu_only_cycles / model->cpu_mhz,
+        (double)cpu_only_cycles / cycles, (unsigned long long)transfers, (double)elapsed / transfers,
+        failed ? "fail" : "pass");
+    fflush(stdout);
+
+    return failed ? 1 : 0;
+}
+
+static void bench_usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [-d milliseconds] [-f board]\n"
+        "  -d  time each case for this long (20)\n"
+        "  -f  only run the boards whose name starts with this\n",
+        name);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = NULL;
+    int64_t duration_ns = 20 * 1000000LL;
+    unsigned int b;
+    unsigned int m;
+    unsigned int s;
+    int failures = 0;
+    int dir;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "d:f:h")))
+    {
+        switch (opt)
+        {
+        case 'd':
+            duration_ns = atoll(optarg) * 1000000LL;
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        default:
+            bench_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    for (b = 0; b < sizeof(g_boards) / sizeof(g_boards[0]); b++)
+    {
+        if (filter && strncmp(g_boards[b].model.name, filter, strlen(filter)))
+        {
+            continue;
+        }
+
+        for (dir = BENCH_WRITE; dir <= BENCH_BOTH; dir++)
+        {
+            for (s = 0; s < sizeof(g_sizes) / sizeof(g_sizes[0]); s++)
+            {
+                failures += bench_run_case(&g_boards[b], (bench_dir)dir, g_sizes[s], duration_ns);
+            }
+        }
+
+        for (m = 0; m < sizeof(g_split_maxes) / sizeof(g_split_maxes[0]); m++)
+        {
+            for (dir = BENCH_WRITE; dir <= BENCH_BOTH; dir++)
+            {
+                for (s = 0; s < sizeof(g_split_sizes) / sizeof(g_split_sizes[0]); s++)
+                {
+                    failures += bench_run_split(&g_boards[b], (bench_dir)dir, g_split_maxes[m], g_split_sizes[s]);
+                }
+            }
+        }
+
+        failures += bench_run_failure(&g_boards[b]);
+    }
+
+    printf("failures=%d\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * \file
+ * \brief  Host configuration - connection parameters come from the environment
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <stdarg.h>
+#include "asf.h"
+#include "config.h"
+
+/* Environment variable, default */
+#define CONFIG_HOST         "GCP_IOT_HOST",         "localhost"
+#define CONFIG_PORT         "GCP_IOT_PORT",         "1883"
+#define CONFIG_PROJECT_ID   "GCP_IOT_PROJECT_ID",   "host-project"
+#define CONFIG_REGION_ID    "GCP_IOT_REGION_ID",    "host-region"
+#define CONFIG_REGISTRY_ID  "GCP_IOT_REGISTRY_ID",  "host-registry"
+#define CONFIG_DEVICE_ID    "GCP_IOT_DEVICE_ID",    "host-device"
+#define CONFIG_JWT          "GCP_IOT_JWT",          "unused"
+#define CONFIG_SSID         "GCP_IOT_SSID",         "host-ssid"
+#define CONFIG_PASSWORD     "GCP_IOT_WIFI_PASSWORD", ""
+
+static const char* config_env(const char* name, const char* default_value)
+{
+    const char* value = getenv(name);
+
+    return (value && *value) ? value : default_value;
+}
+
+/* snprintf into buf - 0 if it all fit */
+static int config_format(char* buf, size_t buflen, const char* format, ...)
+{
+    va_list args;
+    int rv;
+
+    if(!buf || !buflen)
+    {
+        return -1;
+    }
+
+    va_start(args, format);
+    rv = vsnprintf(buf, buflen, format, args);
+    va_end(args);
+
+    return (0 < rv && (size_t)rv < buflen) ? 0 : -1;
+}
+
+void config_crypto(void)
+{
+}
+
+bool config_ready(void)
+{
+    return true;
+}
+
+/* Populate the buffer with the WIFI SSID - only the WINC emulator joins an access point */
+int config_get_ssid(char* buf, size_t buflen)
+{
+    return config_format(buf, buflen, "%s", config_env(CONFIG_SSID));
+}
+
+/* Populate the buffer with the WIFI password - empty for an open access point */
+int config_get_password(char* buf, size_t buflen)
+{
+    const char* pass = config_env(CONFIG_PASSWORD);
+
+    /* config_format treats an empty result as a failure */
+    if(!buf || buflen <= strlen(pass))
+    {
+        return -1;
+    }
+
+    strcpy(buf, pass);
+    return 0;
+}
+
+/** \brief Populate the buffer with the client id */
+int config_get_client_id(char* buf, size_t buflen)
+{
+    return config_format(buf, buflen, "projects/%s/locations/%s/registries/%s/devices/%s",
+        config_env(CONFIG_PROJECT_ID), config_env(CONFIG_REGION_ID),
+        config_env(CONFIG_REGISTRY_ID), config_env(CONFIG_DEVICE_ID));
+}
+
+/* Populate the buffer with the username */
+int config_get_client_username(char* buf, size_t buflen)
+{
+    return config_format(buf, buflen, "unused");
+}
+
+/* Populate the buffer with the user's password - a JWT made off the device */
+int config_get_client_password(char* buf, size_t buflen)
+{
+    return config_format(buf, buflen, "%s", config_env(CONFIG_JWT));
+}
+
+/* Get the topic id  where the client will be publishing messages */
+int config_get_client_pub_topic(char* buf, size_t buflen)
+{
+    return config_format(buf, buflen, "/devices/%s/events", config_env(CONFIG_DEVICE_ID));
+}
+
+/* Get the topic filter for the commands sent to the client */
+int config_get_client_cmd_topic(char* buf, size_t buflen)
+{
+    return config_format(buf, buflen, "/devices/%s/commands/#", config_env(CONFIG_DEVICE_ID));
+}
+
+/* Get the topic id  where the client will be receiving messages */
+int config_get_client_sub_topic(char* buf, size_t buflen)
+{
+    return config_format(buf, buflen, "/devices/%s/config", config_env(CONFIG_DEVICE_ID));
+}
+
+/* Populate the buffer with a serial number made from the device id - there is no crypto device */
+int config_get_serial_number(uint8_t* buf, size_t buflen)
+{
+    const char* id = config_env(CONFIG_DEVICE_ID);
+    size_t i;
+
+    if(!buf || buflen < CONFIG_SERIAL_NUMBER_SIZE)
+    {
+        return -1;
+    }
+
+    memset(buf, 0, CONFIG_SERIAL_NUMBER_SIZE);
+    for(i = 0; id[i]; i++)
+    {
+        buf[i % CONFIG_SERIAL_NUMBER_SIZE] = buf[i % CONFIG_SERIAL_NUMBER_SIZE] * 31 + (uint8_t)id[i];
+    }
+
+    return 0;
+}
+
+/* Get the host name and port of the broker */
+int config_get_host_info(char* buf, size_t buflen, uint16_t * port)
+{
+    if(!port)
+    {
+        return -1;
+    }
+
+    *port = (uint16_t)atoi(config_env(CONFIG_PORT));
+
+    return config_format(buf, buflen, "%s", config_env(CONFIG_HOST));
+}
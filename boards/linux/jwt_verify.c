@@ -0,0 +1,316 @@
+/**
+ * \file
+ * \brief  ES256 JWT verification for the host broker
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#include "parson.h"
+#include "jwt_verify.h"
+
+/* ES256 signatures are the raw r and s values */
+#define JWT_ES256_PART_SIZE     (32)
+#define JWT_ES256_SIG_SIZE      (2 * JWT_ES256_PART_SIZE)
+
+/* The device key the tokens are signed with - the bridge looks it up by the device id */
+static EVP_PKEY* g_jwt_key;
+
+/* Value of a base64url character, or -1 */
+static int jwt_b64_value(char c)
+{
+    if ('A' <= c && c <= 'Z')
+    {
+        return c - 'A';
+    }
+    if ('a' <= c && c <= 'z')
+    {
+        return c - 'a' + 26;
+    }
+    if ('0' <= c && c <= '9')
+    {
+        return c - '0' + 52;
+    }
+    if ('-' == c)
+    {
+        return 62;
+    }
+    if ('_' == c)
+    {
+        return 63;
+    }
+    return -1;
+}
+
+/* Decode unpadded base64url - returns the decoded length or -1 */
+static int jwt_b64_decode(const char* in, size_t inlen, uint8_t* out, size_t outlen)
+{
+    uint32_t bits = 0;
+    int nbits = 0;
+    size_t len = 0;
+    size_t i;
+    int v;
+
+    for (i = 0; i < inlen; i++)
+    {
+        if (0 > (v = jwt_b64_value(in[i])))
+        {
+            return -1;
+        }
+        bits = (bits << 6) | (uint32_t)v;
+        nbits += 6;
+        if (nbits >= 8)
+        {
+            nbits -= 8;
+            if (len >= outlen)
+            {
+                return -1;
+            }
+            out[len++] = (uint8_t)(bits >> nbits);
+        }
+    }
+
+    /* A single trailing character can not hold a whole byte */
+    return (nbits >= 6) ? -1 : (int)len;
+}
+
+/* Decode a base64url JSON segment and parse it as an object */
+static JSON_Value* jwt_parse_segment(const char* in, size_t inlen)
+{
+    char json[JWT_VERIFY_MAX_LENGTH];
+    JSON_Value* value;
+    int len;
+
+    if (0 > (len = jwt_b64_decode(in, inlen, (uint8_t*)json, sizeof(json) - 1)))
+    {
+        return NULL;
+    }
+    json[len] = '\0';
+
+    value = json_parse_string(json);
+    if (value && JSONObject != json_value_get_type(value))
+    {
+        json_value_free(value);
+        value = NULL;
+    }
+    return value;
+}
+
+/* Check the raw r||s signature over the signing input */
+static int jwt_check_signature(const char* input, size_t inlen, const uint8_t* raw)
+{
+    ECDSA_SIG* sig;
+    BIGNUM* r;
+    BIGNUM* s;
+    EVP_MD_CTX* ctx;
+    uint8_t der[JWT_ES256_SIG_SIZE + 16];
+    uint8_t* p = der;
+    int derlen;
+    int ok = 0;
+
+    /* OpenSSL wants the signature DER encoded */
+    sig = ECDSA_SIG_new();
+    r = BN_bin2bn(raw, JWT_ES256_PART_SIZE, NULL);
+    s = BN_bin2bn(&raw[JWT_ES256_PART_SIZE], JWT_ES256_PART_SIZE, NULL);
+    if (!sig || !r || !s || !ECDSA_SIG_set0(sig, r, s))
+    {
+        BN_free(r);
+        BN_free(s);
+        ECDSA_SIG_free(sig);
+        return 0;
+    }
+
+    derlen = i2d_ECDSA_SIG(sig, NULL);
+    if (0 < derlen && derlen <= (int)sizeof(der))
+    {
+        derlen = i2d_ECDSA_SIG(sig, &p);
+
+        if (NULL != (ctx = EVP_MD_CTX_new()))
+        {
+            ok = (1 == EVP_DigestVerifyInit(ctx, NULL, EVP_sha256(), NULL, g_jwt_key)
+                && 1 == EVP_DigestVerifyUpdate(ctx, input, inlen)
+                && 1 == EVP_DigestVerifyFinal(ctx, der, (size_t)derlen));
+            EVP_MD_CTX_free(ctx);
+        }
+    }
+    ECDSA_SIG_free(sig);
+
+    return ok;
+}
+
+/** \brief Load the PEM public key tokens are verified against */
+int jwt_verify_init(const char* pubkey_path)
+{
+    FILE* fp;
+
+    jwt_verify_release();
+
+    if (NULL == (fp = fopen(pubkey_path, "r")))
+    {
+        return -1;
+    }
+    g_jwt_key = PEM_read_PUBKEY(fp, NULL, NULL, NULL);
+    fclose(fp);
+
+    if (!g_jwt_key || EVP_PKEY_EC != EVP_PKEY_base_id(g_jwt_key))
+    {
+        jwt_verify_release();
+        return -1;
+    }
+    return 0;
+}
+
+void jwt_verify_release(void)
+{
+    EVP_PKEY_free(g_jwt_key);
+    g_jwt_key = NULL;
+}
+
+/**
+ * \brief Verify a token the way the GCP MQTT bridge does
+ *
+ * \param token[in]     The password from the connect packet - not terminated
+ * \param token_len[in] The token length
+ * \param audience[in]  The project id the token must be issued for
+ * \param now[in]       The broker time in seconds since the epoch
+ *
+ * \return JWT_VERIFY_OK or one of the JWT_VERIFY_STATUS errors
+ */
+int jwt_verify(const char* token, size_t token_len, const char* audience, int64_t now)
+{
+    const char* dot1;
+    const char* dot2;
+    const char* end = &token[token_len];
+    uint8_t sig[JWT_ES256_SIG_SIZE + 1];
+    JSON_Value* header = NULL;
+    JSON_Value* claims = NULL;
+    JSON_Object* obj;
+    const char* str;
+    double iat;
+    double exp;
+    int rv = JWT_VERIFY_FORMAT;
+
+    if (!g_jwt_key || !token || token_len > JWT_VERIFY_MAX_LENGTH)
+    {
+        return JWT_VERIFY_FORMAT;
+    }
+
+    dot1 = memchr(token, '.', token_len);
+    dot2 = dot1 ? memchr(dot1 + 1, '.', end - dot1 - 1) : NULL;
+    if (!dot2 || memchr(dot2 + 1, '.', end - dot2 - 1))
+    {
+        return JWT_VERIFY_FORMAT;
+    }
+
+    do
+    {
+        if (!(header = jwt_parse_segment(token, dot1 - token))
+            || !(claims = jwt_parse_segment(dot1 + 1, dot2 - dot1 - 1)))
+        {
+            break;
+        }
+
+        obj = json_value_get_object(header);
+        str = json_object_get_string(obj, "alg");
+        if (!str || strcmp(str, "ES256"))
+        {
+            rv = JWT_VERIFY_ALGORITHM;
+            break;
+        }
+
+        if (JWT_ES256_SIG_SIZE != jwt_b64_decode(dot2 + 1, end - dot2 - 1, sig, sizeof(sig)))
+        {
+            rv = JWT_VERIFY_SIGNATURE;
+            break;
+        }
+
+        /* The signing input is everything before the second dot */
+        if (!jwt_check_signature(token, dot2 - token, sig))
+        {
+            rv = JWT_VERIFY_SIGNATURE;
+            break;
+        }
+
+        obj = json_value_get_object(claims);
+        str = json_object_get_string(obj, "aud");
+        if (!str || !audience || strcmp(str, audience))
+        {
+            rv = JWT_VERIFY_AUDIENCE;
+            break;
+        }
+
+        if (JSONNumber != json_value_get_type(json_object_get_value(obj, "iat"))
+            || JSONNumber != json_value_get_type(json_object_get_value(obj, "exp")))
+        {
+            rv = JWT_VERIFY_TIME;
+            break;
+        }
+        iat = json_object_get_number(obj, "iat");
+        exp = json_object_get_number(obj, "exp");
+        if (iat > now + JWT_VERIFY_CLOCK_SKEW || exp + JWT_VERIFY_CLOCK_SKEW < now
+            || exp <= iat || exp - iat > JWT_VERIFY_MAX_LIFETIME)
+        {
+            rv = JWT_VERIFY_TIME;
+            break;
+        }
+
+        rv = JWT_VERIFY_OK;
+    } while (0);
+
+    json_value_free(header);
+    json_value_free(claims);
+
+    return rv;
+}
+
+const char* jwt_verify_error(int status)
+{
+    switch (status)
+    {
+    case JWT_VERIFY_OK:
+        return "ok";
+    case JWT_VERIFY_FORMAT:
+        return "malformed token";
+    case JWT_VERIFY_ALGORITHM:
+        return "not ES256";
+    case JWT_VERIFY_SIGNATURE:
+        return "bad signature";
+    case JWT_VERIFY_AUDIENCE:
+        return "wrong audience";
+    case JWT_VERIFY_TIME:
+        return "bad iat/exp";
+    default:
+        return "unknown";
+    }
+}
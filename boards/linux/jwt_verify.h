@@ -0,0 +1,62 @@
+/**
+ * \file
+ * \brief  ES256 JWT verification for the host broker
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef JWT_VERIFY_H_
+#define JWT_VERIFY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Allowed difference between the device and broker clocks in seconds */
+#define JWT_VERIFY_CLOCK_SKEW       (600)
+
+/** Longest token lifetime the bridge accepts in seconds */
+#define JWT_VERIFY_MAX_LIFETIME     (86400)
+
+/** Largest token accepted */
+#define JWT_VERIFY_MAX_LENGTH       (1024)
+
+typedef enum
+{
+    JWT_VERIFY_OK = 0,
+    JWT_VERIFY_FORMAT = -1,     /**< Not three base64url parts of JSON */
+    JWT_VERIFY_ALGORITHM = -2,  /**< Header alg is not ES256 */
+    JWT_VERIFY_SIGNATURE = -3,  /**< Signature does not match the key */
+    JWT_VERIFY_AUDIENCE = -4,   /**< aud is not the project id */
+    JWT_VERIFY_TIME = -5        /**< iat/exp missing, not yet valid, expired or too long */
+} JWT_VERIFY_STATUS;
+
+int jwt_verify_init(const char* pubkey_path);
+void jwt_verify_release(void);
+int jwt_verify(const char* token, size_t token_len, const char* audience, int64_t now);
+const char* jwt_verify_error(int status);
+
+#endif /* JWT_VERIFY_H_ */
@@ -0,0 +1,208 @@
+/**
+ * \file
+ * \brief  Linux host entry point - runs the unchanged client tasks
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <signal.h>
+#include "asf.h"
+#include "config.h"
+
+/* Tasks */
+#include "wifi_task.h"
+#include "client_task.h"
+#include "sensor_task.h"
+
+/* Paho Client Timer */
+#include "timer_interface.h"
+
+/* Fault injection between the client and its socket */
+#include "network_impair.h"
+
+#define IMPAIR_SPEC     "GCP_IOT_IMPAIR"
+
+static volatile sig_atomic_t g_stop;
+
+/* One simulated device */
+static wifi_context    g_wifi_context;
+static client_context  g_client_context;
+static sensor_context  g_sensor_context;
+
+/* The link the client runs over when IMPAIR_SPEC is set */
+static network_impair  g_impair;
+static bool            g_impaired;
+
+/* Reconnects seen by the impaired link, and how long the publish backlog took to drain after them */
+static uint32_t g_drain_reconnects;
+static uint64_t g_drain_start;
+static uint32_t g_drains;
+static uint64_t g_drain_ms_total;
+static uint64_t g_drain_ms_max;
+
+static void stop_handler(int signum)
+{
+    g_stop = 1;
+}
+
+/* Monotonic milliseconds */
+static uint64_t host_time_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* A hard disconnect closes the socket so the broker sees it too */
+static void impair_disconnect(void* context)
+{
+    wifi_disconnect((wifi_context*)context);
+}
+
+/* Time the publish backlog draining after each reconnect */
+static void impair_track_backlog(uint64_t now)
+{
+    if(g_impair.stats.reconnects != g_drain_reconnects)
+    {
+        g_drain_reconnects = g_impair.stats.reconnects;
+        g_drain_start = now;
+    }
+
+    if(g_drain_start && 0 == client_publish_queue_depth(&g_client_context))
+    {
+        uint64_t elapsed = now - g_drain_start;
+
+        g_drains++;
+        g_drain_ms_total += elapsed;
+        if(elapsed > g_drain_ms_max)
+        {
+            g_drain_ms_max = elapsed;
+        }
+        g_drain_start = 0;
+    }
+}
+
+/* Print what the impaired link did as key=value pairs */
+static void impair_report(uint64_t elapsed_ms)
+{
+    const network_impair_stats* stats = &g_impair.stats;
+
+    if(!elapsed_ms)
+    {
+        elapsed_ms = 1;
+    }
+
+    printf("impair elapsed_ms=%llu bytes_in=%llu bytes_out=%llu in_bytes_per_s=%llu out_bytes_per_s=%llu "
+        "partial_reads=%u partial_writes=%u dropped_in=%u dropped_out=%u disconnects=%u reconnects=%u "
+        "reconnect_ms_min=%u reconnect_ms_avg=%llu reconnect_ms_max=%u drains=%u drain_ms_avg=%llu drain_ms_max=%llu\r\n",
+        (unsigned long long)elapsed_ms,
+        (unsigned long long)stats->bytes_in, (unsigned long long)stats->bytes_out,
+        (unsigned long long)(stats->bytes_in * 1000 / elapsed_ms),
+        (unsigned long long)(stats->bytes_out * 1000 / elapsed_ms),
+        stats->partial_reads, stats->partial_writes, stats->dropped_in, stats->dropped_out,
+        stats->disconnects, stats->reconnects, stats->reconnect_ms_min,
+        (unsigned long long)(stats->reconnects ? stats->reconnect_ms_total / stats->reconnects : 0),
+        stats->reconnect_ms_max, g_drains,
+        (unsigned long long)(g_drains ? g_drain_ms_total / g_drains : 0),
+        (unsigned long long)g_drain_ms_max);
+}
+
+/* What the periodic timer interrupt does on the boards */
+void update_timers(void)
+{
+    wifi_timer_update(&g_wifi_context);
+    client_timer_update(&g_client_context);
+    TimerCallback();
+}
+
+int main(int argc, char** argv)
+{
+    const struct timespec idle = {0, 1000000};
+    network_impair_config impair_config;
+    const char* impair_spec;
+    uint64_t started;
+    uint64_t next_tick;
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    /* Writes to a closed connection are reported by send() */
+    signal(SIGPIPE, SIG_IGN);
+
+    wifi_init(&g_wifi_context);
+    sensor_init(&g_sensor_context);
+    client_init(&g_client_context, &g_wifi_context, &g_sensor_context);
+
+    impair_spec = getenv(IMPAIR_SPEC);
+    if(impair_spec && *impair_spec)
+    {
+        if(network_impair_parse(&impair_config, impair_spec))
+        {
+            fprintf(stderr, "Bad %s \"%s\"\r\n", IMPAIR_SPEC, impair_spec);
+            return 1;
+        }
+        network_impair_init(&g_impair, &g_client_context.mqtt_net, &impair_config, &impair_disconnect);
+        client_set_transport(&g_client_context, &g_impair.net);
+        g_impaired = true;
+    }
+
+    started = host_time_ms();
+    next_tick = host_time_ms() + TIMER_UPDATE_PERIOD;
+
+    while(!g_stop)
+    {
+        /* Catch up on any ticks missed while the tasks were busy */
+        while(host_time_ms() >= next_tick)
+        {
+            update_timers();
+            next_tick += TIMER_UPDATE_PERIOD;
+        }
+
+        wifi_task(&g_wifi_context);
+        client_task(&g_client_context);
+        sensor_task(&g_sensor_context);
+
+        if(g_impaired)
+        {
+            impair_track_backlog(host_time_ms());
+        }
+
+        nanosleep(&idle, NULL);
+    }
+
+    printf("Publish queue depth %u, dropped %u\r\n",
+        (unsigned)client_publish_queue_depth(&g_client_context),
+        (unsigned)client_publish_queue_dropped(&g_client_context));
+
+    if(g_impaired)
+    {
+        impair_report(host_time_ms() - started);
+    }
+
+    return 0;
+}
@@ -0,0 +1,603 @@
+/**
+ * \file
+ * \brief  Fault injecting Network decorator - an impaired link for host testing
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "MQTTClient.h"
+#include "network_impair.h"
+
+/* Sits between the client's read-ahead buffer and the socket transport. Received data goes through
+ * a delay line so latency and jitter hold bytes back without blocking the caller, partial reads and
+ * writes, byte drops and hard disconnects are decided per call from a seeded generator. The transport
+ * must provide mqttreadsome. */
+
+/* Monotonic milliseconds */
+uint64_t network_impair_time_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void network_impair_sleep_ms(uint64_t ms)
+{
+    struct timespec delay;
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = (ms % 1000) * 1000000;
+
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+    {
+    }
+}
+
+/* xorshift32 - the schedule only has to be repeatable */
+static uint32_t network_impair_rand(network_impair* ni)
+{
+    ni->rand ^= ni->rand << 13;
+    ni->rand ^= ni->rand >> 17;
+    ni->rand ^= ni->rand << 5;
+
+    return ni->rand;
+}
+
+/* True per_mille times in a thousand */
+static int network_impair_chance(network_impair* ni, uint32_t per_mille)
+{
+    return per_mille && (network_impair_rand(ni) % 1000) < per_mille;
+}
+
+/* Next hard disconnect - between a half and one and a half times the mean from now */
+static void network_impair_schedule(network_impair* ni, uint64_t now)
+{
+    uint32_t mean = ni->config.disconnect_ms;
+
+    ni->next_disconnect = mean ? now + mean / 2 + network_impair_rand(ni) % (mean + 1) : 0;
+}
+
+/* Forget everything held in the delay line */
+static void network_impair_flush(network_impair* ni)
+{
+    ni->delay_head = 0;
+    ni->delay_tail = 0;
+    ni->chunk_head = 0;
+    ni->chunk_count = 0;
+    ni->closed = 0;
+}
+
+/* Take the link down when the schedule says so - returns non-zero while it is down */
+static int network_impair_down(network_impair* ni, uint64_t now)
+{
+    if (ni->down_until)
+    {
+        if (now < ni->down_until)
+        {
+            return 1;
+        }
+        ni->down_until = 0;
+        network_impair_schedule(ni, now);
+    }
+
+    if (ni->next_disconnect && now >= ni->next_disconnect)
+    {
+        ni->stats.disconnects++;
+        if (ni->disconnect)
+        {
+            ni->disconnect(ni->transport->context);
+        }
+        network_impair_flush(ni);
+        ni->next_disconnect = 0;
+        ni->down_until = now + ni->config.outage_ms + 1;
+        ni->disconnected_at = now;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Pull whatever the transport has into the delay line - returns the bytes added, 0 on timeout */
+static int network_impair_pull(network_impair* ni, int timeout_ms)
+{
+    uint32_t tail;
+    uint64_t now;
+    uint64_t release;
+    uint32_t i;
+    int rc;
+
+    if (ni->closed)
+    {
+        return 0;
+    }
+
+    /* Keep the free space in one piece */
+    if (ni->delay_head > 0)
+    {
+        memmove(ni->delay, &ni->delay[ni->delay_head], ni->delay_tail - ni->delay_head);
+        for (i = 0; i < ni->chunk_count; i++)
+        {
+            ni->chunks[(ni->chunk_head + i) % NETWORK_IMPAIR_DELAY_CHUNKS].end -= ni->delay_head;
+        }
+        ni->delay_tail -= ni->delay_head;
+        ni->delay_head = 0;
+    }
+
+    /* A full delay line pushes back on the transport like a full receive window */
+    if (ni->delay_tail == NETWORK_IMPAIR_DELAY_SIZE || ni->chunk_count == NETWORK_IMPAIR_DELAY_CHUNKS)
+    {
+        return 0;
+    }
+
+    rc = ni->transport->mqttreadsome(ni->transport, &ni->delay[ni->delay_tail],
+        NETWORK_IMPAIR_DELAY_SIZE - ni->delay_tail, timeout_ms);
+    if (rc < 0)
+    {
+        /* Deliver what was received before the connection closed, then fail */
+        ni->closed = 1;
+        return 0;
+    }
+    if (rc == 0)
+    {
+        return 0;
+    }
+
+    now = network_impair_time_ms();
+    release = now + ni->config.latency_ms;
+    if (ni->config.jitter_ms)
+    {
+        release += network_impair_rand(ni) % (ni->config.jitter_ms + 1);
+    }
+
+    /* Jitter delays, it never reorders */
+    if (ni->chunk_count)
+    {
+        tail = (ni->chunk_head + ni->chunk_count - 1) % NETWORK_IMPAIR_DELAY_CHUNKS;
+        if (release < ni->chunks[tail].release)
+        {
+            release = ni->chunks[tail].release;
+        }
+    }
+
+    tail = (ni->chunk_head + ni->chunk_count) % NETWORK_IMPAIR_DELAY_CHUNKS;
+    ni->delay_tail += rc;
+    ni->chunks[tail].end = ni->delay_tail;
+    ni->chunks[tail].release = release;
+    ni->chunk_count++;
+
+    /* The first data since a hard disconnect - the client is back */
+    if (ni->disconnected_at)
+    {
+        uint32_t elapsed = (uint32_t)(now - ni->disconnected_at);
+
+        ni->stats.reconnects++;
+        ni->stats.reconnect_ms_total += elapsed;
+        if (ni->stats.reconnects == 1 || elapsed < ni->stats.reconnect_ms_min)
+        {
+            ni->stats.reconnect_ms_min = elapsed;
+        }
+        if (elapsed > ni->stats.reconnect_ms_max)
+        {
+            ni->stats.reconnect_ms_max = elapsed;
+        }
+        ni->disconnected_at = 0;
+    }
+
+    return rc;
+}
+
+/* Bytes whose release time has passed */
+static uint32_t network_impair_released(network_impair* ni, uint64_t now)
+{
+    uint32_t end = ni->delay_head;
+    uint32_t i;
+
+    for (i = 0; i < ni->chunk_count; i++)
+    {
+        uint32_t chunk = (ni->chunk_head + i) % NETWORK_IMPAIR_DELAY_CHUNKS;
+
+        if (ni->chunks[chunk].release > now)
+        {
+            break;
+        }
+        end = ni->chunks[chunk].end;
+    }
+
+    return end - ni->delay_head;
+}
+
+/* Hand released bytes to the client, cut short or missing a byte when the schedule says so */
+static int network_impair_deliver(network_impair* ni, unsigned char* read_buffer, int length, uint32_t available)
+{
+    uint8_t* data = &ni->delay[ni->delay_head];
+    uint32_t count = ((uint32_t)length < available) ? (uint32_t)length : available;
+    uint32_t delivered = count;
+    uint32_t drop;
+
+    if (count > 1 && network_impair_chance(ni, ni->config.partial))
+    {
+        count = 1 + network_impair_rand(ni) % (count - 1);
+        delivered = count;
+        ni->stats.partial_reads++;
+    }
+
+    if (network_impair_chance(ni, ni->config.drop))
+    {
+        drop = network_impair_rand(ni) % count;
+        memcpy(read_buffer, data, drop);
+        memcpy(&read_buffer[drop], &data[drop + 1], count - drop - 1);
+        delivered = count - 1;
+        ni->stats.dropped_in++;
+    }
+    else
+    {
+        memcpy(read_buffer, data, count);
+    }
+
+    ni->delay_head += count;
+    while (ni->chunk_count && ni->chunks[ni->chunk_head].end <= ni->delay_head)
+    {
+        ni->chunk_head = (ni->chunk_head + 1) % NETWORK_IMPAIR_DELAY_CHUNKS;
+        ni->chunk_count--;
+    }
+
+    ni->stats.bytes_in += delivered;
+
+    return (int)delivered;
+}
+
+/* Write the buffers to the transport in order - returns the bytes written */
+static int network_impair_forward(network_impair* ni, NetworkIOVec* iov, int iovcnt, int timeout_ms)
+{
+    int total = 0;
+    int rc;
+    int i;
+
+    if (ni->transport->mqttwritev)
+    {
+        return ni->transport->mqttwritev(ni->transport, iov, iovcnt, timeout_ms);
+    }
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        rc = ni->transport->mqttwrite(ni->transport, iov[i].base, iov[i].length, timeout_ms);
+        if (rc < 0)
+        {
+            return (total > 0) ? total : rc;
+        }
+        total += rc;
+        if (rc < iov[i].length)
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+/* Write the buffers, cut short or missing a byte when the schedule says so */
+static int network_impair_send(network_impair* ni, NetworkIOVec* iov, int iovcnt, int timeout_ms)
+{
+    NetworkIOVec out[iovcnt + 1];
+    int outcnt = 0;
+    int total = 0;
+    int count;
+    int drop = -1;
+    int partial = 0;
+    int offset = 0;
+    int rc;
+    int i;
+
+    if (network_impair_down(ni, network_impair_time_ms()))
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        total += iov[i].length;
+    }
+
+    count = total;
+    if (count > 1 && network_impair_chance(ni, ni->config.partial))
+    {
+        count = 1 + network_impair_rand(ni) % (count - 1);
+        partial = 1;
+    }
+    if (count > 0 && network_impair_chance(ni, ni->config.drop))
+    {
+        drop = network_impair_rand(ni) % count;
+    }
+
+    /* The first count bytes, less the dropped one */
+    for (i = 0; i < iovcnt && offset < count; i++)
+    {
+        int length = iov[i].length;
+
+        if (length > count - offset)
+        {
+            length = count - offset;
+        }
+
+        if (drop >= offset && drop < offset + length)
+        {
+            out[outcnt].base = iov[i].base;
+            out[outcnt].length = drop - offset;
+            outcnt++;
+            out[outcnt].base = &iov[i].base[drop - offset + 1];
+            out[outcnt].length = length - (drop - offset) - 1;
+            outcnt++;
+        }
+        else
+        {
+            out[outcnt].base = iov[i].base;
+            out[outcnt].length = length;
+            outcnt++;
+        }
+        offset += length;
+    }
+
+    rc = network_impair_forward(ni, out, outcnt, timeout_ms);
+    if (rc < 0)
+    {
+        return rc;
+    }
+
+    /* The client counts the dropped byte as sent */
+    if (drop >= 0 && rc >= drop)
+    {
+        rc++;
+        ni->stats.dropped_out++;
+    }
+    ni->stats.partial_writes += partial;
+    ni->stats.bytes_out += rc;
+
+    return rc;
+}
+
+/**
+ * \brief Parse an impairment such as "latency=50,jitter=20,drop=1,disconnect=30000,outage=2000"
+ *
+ * \param config[out]               The impairment - fields not named are zero
+ * \param spec[in]                  Comma separated name=value pairs: seed, latency, jitter,
+ *                                  partial, drop, disconnect and outage
+ *
+ * \return    0 on success, -1 on an unknown name or a bad value
+ */
+int network_impair_parse(network_impair_config* config, const char* spec)
+{
+    static const struct {
+        const char* name;
+        size_t      offset;
+    } fields[] = {
+        { "seed",       offsetof(network_impair_config, seed) },
+        { "latency",    offsetof(network_impair_config, latency_ms) },
+        { "jitter",     offsetof(network_impair_config, jitter_ms) },
+        { "partial",    offsetof(network_impair_config, partial) },
+        { "drop",       offsetof(network_impair_config, drop) },
+        { "disconnect", offsetof(network_impair_config, disconnect_ms) },
+        { "outage",     offsetof(network_impair_config, outage_ms) },
+    };
+    const char* equals;
+    char* end;
+    unsigned long value;
+    size_t length;
+    size_t i;
+
+    memset(config, 0, sizeof(*config));
+
+    while (*spec)
+    {
+        if (NULL == (equals = strchr(spec, '=')))
+        {
+            return -1;
+        }
+        length = equals - spec;
+
+        errno = 0;
+        value = strtoul(equals + 1, &end, 0);
+        if (errno || end == equals + 1 || (*end && *end != ',') || value > UINT32_MAX)
+        {
+            return -1;
+        }
+
+        for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+        {
+            if (strlen(fields[i].name) == length && 0 == strncmp(fields[i].name, spec, length))
+            {
+                break;
+            }
+        }
+        if (i == sizeof(fields) / sizeof(fields[0]))
+        {
+            return -1;
+        }
+        *(uint32_t*)((uint8_t*)config + fields[i].offset) = (uint32_t)value;
+
+        spec = (*end == ',') ? end + 1 : end;
+    }
+
+    /* Rates are per thousand calls */
+    return (config->partial > 1000 || config->drop > 1000) ? -1 : 0;
+}
+
+/**
+ * \brief Initialize an impaired link on top of a transport
+ *
+ * \param ni[out]                   The impaired link - hand ni->net to the client
+ * \param transport[in]             The link being impaired - must provide mqttreadsome
+ * \param config[in]                The impairment
+ * \param disconnect[in]            Closes the transport's connection, called with its context
+ *                                  on a hard disconnect - optional
+ */
+void network_impair_init(network_impair* ni, Network* transport, const network_impair_config* config,
+    void (*disconnect)(void* context))
+{
+    memset(ni, 0, sizeof(*ni));
+    ni->net.mqttread = &network_impair_read;
+    ni->net.mqttreadsome = &network_impair_read_some;
+    ni->net.mqttwrite = &network_impair_write;
+    ni->net.mqttwritev = &network_impair_writev;
+    ni->net.context = transport->context;
+
+    ni->transport = transport;
+    ni->config = *config;
+    ni->disconnect = disconnect;
+    ni->rand = config->seed ? config->seed : 1;
+
+    network_impair_schedule(ni, network_impair_time_ms());
+}
+
+/**
+ * \brief Reads up to length bytes - Network mqttreadsome operation
+ *
+ * \param network[in]               The impaired link's Network
+ * \param read_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The number of bytes read, 0 on timeout, or the MQTT status
+ */
+int network_impair_read_some(Network* network, unsigned char* read_buffer, int length, int timeout_ms)
+{
+    network_impair* ni = (network_impair*)network;
+    uint64_t deadline = network_impair_time_ms() + timeout_ms;
+    uint64_t release;
+    uint64_t now;
+    uint32_t available;
+
+    for (;;)
+    {
+        now = network_impair_time_ms();
+        if (network_impair_down(ni, now))
+        {
+            return MQTTCLIENT_FAILURE;
+        }
+
+        network_impair_pull(ni, 0);
+
+        if ((available = network_impair_released(ni, now)) > 0)
+        {
+            return network_impair_deliver(ni, read_buffer, length, available);
+        }
+
+        if (ni->closed && ni->chunk_count == 0)
+        {
+            network_impair_flush(ni);
+            return MQTTCLIENT_FAILURE;
+        }
+
+        if (now >= deadline)
+        {
+            return 0;
+        }
+
+        if (ni->chunk_count || ni->closed)
+        {
+            /* Wait for the next arrival to be released */
+            release = ni->chunk_count ? ni->chunks[ni->chunk_head].release : deadline;
+            network_impair_sleep_ms(((release < deadline) ? release : deadline) - now);
+        }
+        else
+        {
+            network_impair_pull(ni, (int)(deadline - now));
+        }
+    }
+}
+
+/**
+ * \brief Reads exactly length bytes - Network mqttread operation
+ *
+ * \param network[in]               The impaired link's Network
+ * \param read_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    length on success otherwise the MQTT status
+ */
+int network_impair_read(Network* network, unsigned char* read_buffer, int length, int timeout_ms)
+{
+    uint64_t deadline = network_impair_time_ms() + timeout_ms;
+    uint64_t now;
+    int total = 0;
+    int rc;
+
+    while (total < length)
+    {
+        now = network_impair_time_ms();
+        rc = network_impair_read_some(network, &read_buffer[total], length - total,
+            (now < deadline) ? (int)(deadline - now) : 0);
+        if (rc < 0 || (rc == 0 && network_impair_time_ms() >= deadline))
+        {
+            return MQTTCLIENT_FAILURE;
+        }
+        total += rc;
+    }
+
+    return total;
+}
+
+/**
+ * \brief Writes data - Network mqttwrite operation
+ *
+ * \param network[in]               The impaired link's Network
+ * \param send_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The number of bytes written, or the MQTT status
+ */
+int network_impair_write(Network* network, unsigned char* send_buffer, int length, int timeout_ms)
+{
+    NetworkIOVec iov;
+
+    iov.base = send_buffer;
+    iov.length = length;
+
+    return network_impair_send((network_impair*)network, &iov, 1, timeout_ms);
+}
+
+/**
+ * \brief Writes several buffers in order - Network mqttwritev operation
+ *
+ * \param network[in]               The impaired link's Network
+ * \param iov[in]                   The buffers
+ * \param iovcnt[in]                The number of buffers
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The total number of bytes written, or the MQTT status
+ */
+int network_impair_writev(Network* network, NetworkIOVec* iov, int iovcnt, int timeout_ms)
+{
+    return network_impair_send((network_impair*)network, iov, iovcnt, timeout_ms);
+}
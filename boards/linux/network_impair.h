@@ -0,0 +1,102 @@
+/**
+ * \file
+ * \brief  Fault injecting Network decorator - an impaired link for host testing
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef NETWORK_IMPAIR_H_
+#define NETWORK_IMPAIR_H_
+
+#include <stdint.h>
+#include "network_interface.h"
+
+/** Received bytes held back by the delay line */
+#define NETWORK_IMPAIR_DELAY_SIZE   (8192)
+/** Separately timed arrivals held back by the delay line */
+#define NETWORK_IMPAIR_DELAY_CHUNKS (64)
+
+/** How the link is impaired - zero everywhere is a clean link */
+typedef struct _network_impair_config {
+    uint32_t    seed;           /**< Seeds the schedule - the same seed gives the same faults */
+    uint32_t    latency_ms;     /**< Added to every arrival */
+    uint32_t    jitter_ms;      /**< Up to this much more, without reordering */
+    uint32_t    partial;        /**< Reads and writes cut short, per thousand */
+    uint32_t    drop;           /**< Reads and writes missing a byte, per thousand */
+    uint32_t    disconnect_ms;  /**< Mean time between hard disconnects */
+    uint32_t    outage_ms;      /**< Time the link stays down after one */
+} network_impair_config;
+
+/** What the impairment has done so far */
+typedef struct _network_impair_stats {
+    uint64_t    bytes_in;           /**< Delivered to the client */
+    uint64_t    bytes_out;          /**< Accepted from the client */
+    uint32_t    partial_reads;
+    uint32_t    partial_writes;
+    uint32_t    dropped_in;
+    uint32_t    dropped_out;
+    uint32_t    disconnects;
+    uint32_t    reconnects;         /**< Data received again after a disconnect */
+    uint64_t    reconnect_ms_total; /**< From the disconnect to the first data after it */
+    uint32_t    reconnect_ms_min;
+    uint32_t    reconnect_ms_max;
+} network_impair_stats;
+
+typedef struct _network_impair {
+    Network                 net;        /**< Must be the first element - handed to the client */
+    Network*                transport;  /**< The link being impaired */
+    network_impair_config   config;
+    network_impair_stats    stats;
+    /** Closes the transport's connection on a hard disconnect - optional */
+    void                    (*disconnect)(void* context);
+    uint32_t                rand;
+    uint64_t                next_disconnect;    /**< Monotonic ms, 0 for never */
+    uint64_t                down_until;         /**< Monotonic ms the outage ends */
+    uint64_t                disconnected_at;    /**< Monotonic ms, 0 once reconnected */
+    int                     closed;             /**< The transport failed - fail once the delay line drains */
+    uint8_t                 delay[NETWORK_IMPAIR_DELAY_SIZE];
+    uint32_t                delay_head;         /**< First byte not yet delivered */
+    uint32_t                delay_tail;         /**< One past the last byte received */
+    struct {
+        uint32_t    end;        /**< Offset one past the chunk's last byte */
+        uint64_t    release;    /**< Monotonic ms it may be delivered */
+    }                       chunks[NETWORK_IMPAIR_DELAY_CHUNKS];
+    uint32_t                chunk_head;
+    uint32_t                chunk_count;
+} network_impair;
+
+int network_impair_parse(network_impair_config* config, const char* spec);
+void network_impair_init(network_impair* ni, Network* transport, const network_impair_config* config,
+    void (*disconnect)(void* context));
+uint64_t network_impair_time_ms(void);
+
+int network_impair_read(Network* network, unsigned char* read_buffer, int length, int timeout_ms);
+int network_impair_read_some(Network* network, unsigned char* read_buffer, int length, int timeout_ms);
+int network_impair_write(Network* network, unsigned char* send_buffer, int length, int timeout_ms);
+int network_impair_writev(Network* network, NetworkIOVec* iov, int iovcnt, int timeout_ms);
+
+#endif /* NETWORK_IMPAIR_H_ */
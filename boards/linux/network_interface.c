@@ -0,0 +1,402 @@
+/**
+ *
+ * \file
+ *
+ * \brief Platform network interface for Linux hosts
+ *
+ * Copyright (c) 2014-2016 Atmel Corporation. All rights reserved.
+ *
+ * \asf_license_start
+ *
+ * \page License
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. The name of Atmel may not be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. This software may only be redistributed and used in connection with an
+ *    Atmel microcontroller product.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * EXPRESSLY AND SPECIFICALLY DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * \asf_license_stop
+ *
+ */
+
+#include "asf.h"
+#include "MQTTClient.h"
+#include "network_interface.h"
+#include "wifi_task.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/* On a host the WIFI socket handling API is a plain non-blocking TCP socket - wifi_init marks
+ * sock and connect_sock unused with -1 */
+
+/* Milliseconds left on a timer as a poll() timeout */
+static int network_poll_ms(Timer *timer)
+{
+    return TimerIsExpired(timer) ? 0 : TimerLeftMS(timer);
+}
+
+/* Wait for the socket to become readable or writable - returns 1 if it did, 0 on timeout */
+static int network_wait(int sock, short events, int timeout_ms)
+{
+    struct pollfd pfd;
+    int rc;
+
+    pfd.fd = sock;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    do
+    {
+        rc = poll(&pfd, 1, timeout_ms);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    /* Errors and hang ups are reported by the recv/send that follows */
+    return (rc > 0) ? 1 : 0;
+}
+
+/* Start connecting a socket to a host - finish with wifi_connect_step */
+int wifi_connect_start(wifi_context *ctx, char * host, int port)
+{
+    struct addrinfo hints;
+    struct addrinfo *result = NULL;
+    char service[8];
+    int sock;
+
+    if (ctx->connect_sock >= 0)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    /* Never leak the last connection's socket */
+    wifi_disconnect(ctx);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+
+    /* The resolver blocks, which is acceptable on a host */
+    if (getaddrinfo(host, service, &hints, &result) != 0 || result == NULL)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock < 0)
+    {
+        freeaddrinfo(result);
+        return MQTTCLIENT_FAILURE;
+    }
+
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    if (connect(sock, result->ai_addr, result->ai_addrlen) != 0 && errno != EINPROGRESS)
+    {
+        close(sock);
+        freeaddrinfo(result);
+        return MQTTCLIENT_FAILURE;
+    }
+
+    freeaddrinfo(result);
+    ctx->connect_sock = sock;
+
+    return MQTTCLIENT_SUCCESS;
+}
+
+/* Advance a connect started by wifi_connect_start - returns MQTTCLIENT_IN_PROGRESS until it is done */
+int wifi_connect_step(wifi_context *ctx)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    int one = 1;
+    int rc;
+
+    if (ctx->connect_sock < 0)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    if (0 == (rc = network_wait(ctx->connect_sock, POLLOUT, 0)))
+    {
+        return MQTTCLIENT_IN_PROGRESS;
+    }
+
+    if (rc < 0 || getsockopt(ctx->connect_sock, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0)
+    {
+        close(ctx->connect_sock);
+        ctx->connect_sock = -1;
+        return MQTTCLIENT_FAILURE;
+    }
+
+    /* MQTT packets are small - send them as soon as they are written */
+    setsockopt(ctx->connect_sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    ctx->sock = ctx->connect_sock;
+    ctx->connect_sock = -1;
+
+    return MQTTCLIENT_SUCCESS;
+}
+
+/* Connect to a host and create a socket - blocking call */
+int wifi_connect(wifi_context *ctx, char * host, int port)
+{
+    Timer timer;
+    int status;
+
+    if (MQTTCLIENT_SUCCESS != (status = wifi_connect_start(ctx, host, port)))
+    {
+        return status;
+    }
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, WIFI_COUNTER_CONNECT_WAIT);
+
+    while (MQTTCLIENT_IN_PROGRESS == (status = wifi_connect_step(ctx)))
+    {
+        if (TimerIsExpired(&timer))
+        {
+            close(ctx->connect_sock);
+            ctx->connect_sock = -1;
+            return MQTTCLIENT_FAILURE;
+        }
+        network_wait(ctx->connect_sock, POLLOUT, network_poll_ms(&timer));
+    }
+
+    return status;
+}
+
+/* Close the connected socket, if there is one */
+void wifi_disconnect(wifi_context *ctx)
+{
+    if (ctx->sock >= 0)
+    {
+        close(ctx->sock);
+        ctx->sock = -1;
+    }
+}
+
+/* Read whatever has been received, up to read_length bytes - 0 if nothing arrives in time */
+int wifi_read_some(wifi_context *ctx, uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms)
+{
+    ssize_t rc;
+    int ready;
+
+    if (ctx->sock < 0)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    if ((ready = network_wait(ctx->sock, POLLIN, timeout_ms)) <= 0)
+    {
+        return ready;
+    }
+
+    do
+    {
+        rc = recv(ctx->sock, read_buffer, read_length, 0);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return 0;
+    }
+
+    /* The peer closing the connection is an error to the client */
+    return (rc > 0) ? (int)rc : MQTTCLIENT_FAILURE;
+}
+
+/* Read whatever has been received, up to read_length bytes, without waiting */
+int wifi_read_poll(wifi_context *ctx, uint8_t *read_buffer, uint32_t read_length)
+{
+    return wifi_read_some(ctx, read_buffer, read_length, 0);
+}
+
+/* Read exactly read_length bytes - fewer if the timeout expires or the read fails part way */
+int wifi_read_data(wifi_context *ctx, uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms)
+{
+    Timer timer;
+    uint32_t total = 0;
+    int rc;
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, timeout_ms);
+
+    while (total < read_length)
+    {
+        rc = wifi_read_some(ctx, &read_buffer[total], read_length - total, network_poll_ms(&timer));
+        if (rc < 0 || (rc == 0 && TimerIsExpired(&timer)))
+        {
+            return (total > 0) ? (int)total : MQTTCLIENT_FAILURE;
+        }
+        total += rc;
+    }
+
+    return (int)total;
+}
+
+/* Write the buffers in order, as far as the timeout allows - returns the bytes written */
+static int network_writev(wifi_context *ctx, struct iovec *iov, int iovcnt, uint32_t timeout_ms)
+{
+    Timer timer;
+    int total = 0;
+    ssize_t rc;
+
+    if (ctx->sock < 0)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, timeout_ms);
+
+    while (iovcnt > 0)
+    {
+        rc = writev(ctx->sock, iov, iovcnt);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if ((errno != EAGAIN && errno != EWOULDBLOCK) || TimerIsExpired(&timer))
+            {
+                break;
+            }
+            network_wait(ctx->sock, POLLOUT, network_poll_ms(&timer));
+            continue;
+        }
+
+        total += rc;
+
+        /* Step past whatever was written */
+        while (iovcnt > 0 && (size_t)rc >= iov->iov_len)
+        {
+            rc -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + rc;
+            iov->iov_len -= rc;
+        }
+    }
+
+    return (iovcnt == 0 || total > 0) ? total : MQTTCLIENT_FAILURE;
+}
+
+/* Send data to a socket - blocking call */
+int wifi_send_data(wifi_context *ctx, uint8_t *send_buffer, uint32_t send_length, uint32_t timeout_ms)
+{
+    struct iovec iov;
+
+    iov.iov_base = send_buffer;
+    iov.iov_len = send_length;
+
+    return network_writev(ctx, &iov, 1, timeout_ms);
+}
+
+/**
+ * \brief Reads data from the socket.
+ *
+ * \param network[in]               The Eclipse Paho MQTT network information
+ * \param read_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    length, fewer bytes if the read failed part way, or the MQTT status
+ */
+int mqtt_packet_read(Network *network, unsigned char *read_buffer, int length, int timeout_ms)
+{
+    return wifi_read_data(network->context, read_buffer, length, timeout_ms);
+}
+
+/**
+ * \brief Reads whatever data the socket has received, up to length.
+ *
+ * \param network[in]               The Eclipse Paho MQTT network information
+ * \param read_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout - zero returns straight away
+ *
+ * \return    The number of bytes read, 0 on timeout, or the MQTT status
+ */
+int mqtt_packet_read_some(Network *network, unsigned char *read_buffer, int length, int timeout_ms)
+{
+    return wifi_read_some(network->context, read_buffer, length, timeout_ms);
+}
+
+/**
+ * \brief Writes data to the socket.
+ *
+ * \param network[in]               The Eclipse Paho MQTT network information
+ * \param send_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The number of bytes written, or the MQTT status
+ */
+int mqtt_packet_write(Network *network, unsigned char *send_buffer, int length, int timeout_ms)
+{
+    return wifi_send_data(network->context, send_buffer, length, timeout_ms);
+}
+
+/**
+ * \brief Writes several buffers to the socket with a single writev.
+ *
+ * \param network[in]               The Eclipse Paho MQTT network information
+ * \param iov[in]                   The buffers, in order
+ * \param iovcnt[in]                The number of buffers
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The total number of bytes written, or the MQTT status
+ */
+int mqtt_packet_writev(Network *network, NetworkIOVec *iov, int iovcnt, int timeout_ms)
+{
+    struct iovec vec[iovcnt];
+    int i;
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        vec[i].iov_base = iov[i].base;
+        vec[i].iov_len = iov[i].length;
+    }
+
+    return network_writev(network->context, vec, iovcnt, timeout_ms);
+}
@@ -0,0 +1,679 @@
+/**
+ * \file
+ * \brief  MQTTPacket serialization and deserialization benchmarks
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+/*
+ * Times the packet layer the device and the broker stand-in are built on, for
+ * each packet type across payload sizes, the client's inbound topic dispatch
+ * across subscription counts, and reading inbound packets with and without
+ * the read-ahead buffer, and prints one key=value line per case. Given a
+ * thresholds file, a case slower than its floor is marked result=fail and the
+ * exit status is 1, so a change to MQTTPacket can be checked for speed as
+ * well as correctness.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "MQTTClient.h"
+#include "network_buffer.h"
+
+/** Largest payload benchmarked */
+#define BENCH_MAX_PAYLOAD       (16384)
+#define BENCH_BUF_SIZE          (BENCH_MAX_PAYLOAD + 256)
+
+/** Iterations between clock reads */
+#define BENCH_BATCH             (1024)
+
+#define BENCH_MAX_THRESHOLDS    (64)
+
+/** Most topic filters subscribed - the dispatch cases build with MAX_MESSAGE_HANDLERS this large */
+#define BENCH_MAX_FILTERS       (MAX_MESSAGE_HANDLERS)
+#define BENCH_FILTER_SIZE       (64)
+
+/** Read-ahead buffer size, as client_task uses */
+#define BENCH_READAHEAD_SIZE    (256)
+#define BENCH_NAME_SIZE         (32)
+
+/* What the device sends to the GCP bridge */
+#define BENCH_CLIENT_ID     "projects/host-project/locations/host-region/registries/host-registry/devices/host-device"
+#define BENCH_TOPIC         "/devices/host-device/events"
+
+/* What the device subscribes to - the config topic, and commands with per subfolder handlers */
+#define BENCH_DEVICE_TOPIC  "/devices/host-device/"
+typedef struct
+{
+    uint8_t     buf[BENCH_BUF_SIZE];        /**< Serialized packet or string under test */
+    int         len;                        /**< Bytes in buf the case works on */
+    uint8_t     payload[BENCH_MAX_PAYLOAD];
+    char        password[BENCH_MAX_PAYLOAD + 1];
+    uint8_t     tmpl_buf[MQTTPublishTemplate_size(sizeof(BENCH_TOPIC))];
+    MQTTPublishTemplate tmpl;
+    char        filters[BENCH_MAX_FILTERS][BENCH_FILTER_SIZE];
+    int         filter_count;
+    MQTTTopicTrie trie;
+    char        topic_name[BENCH_FILTER_SIZE];
+    MQTTString  topic;                      /**< Inbound publish topic, as it is in the read buffer */
+    uint8_t     stream[BENCH_BUF_SIZE];     /**< Inbound packets the transport repeats */
+    int         stream_len;
+    int         stream_pos;
+    uint64_t    transport_reads;            /**< Calls into the transport */
+    Network     transport;
+    NetworkBuffer readahead;
+    uint8_t     readahead_buf[BENCH_READAHEAD_SIZE];
+} bench_state;
+
+typedef struct
+{
+    const char* name;
+    const int*  sizes;          /**< Sizes the case is run at, ending with -1 */
+    int         (*setup)(bench_state* state, int size);     /**< Returns the bytes one packet is */
+    int         (*run)(bench_state* state, int size, int iterations);
+} bench_case;
+
+typedef struct
+{
+    char        name[BENCH_NAME_SIZE];
+    int         size;
+    double      min_packets_per_s;
+} bench_threshold;
+
+static bench_state g_state;
+static bench_threshold g_thresholds[BENCH_MAX_THRESHOLDS];
+static int g_threshold_count;
+
+/* Keeps the results of the calls under test live */
+static volatile unsigned int g_sink;
+
+static int64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Remaining length encoding - size is the value encoded */
+static int bench_encode_setup(bench_state* state, int size)
+{
+    return MQTTPacket_encode(state->buf, size);
+}
+
+static int bench_encode_run(bench_state* state, int size, int iterations)
+{
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTPacket_encode(state->buf, size);
+    }
+    return sum;
+}
+
+static int bench_decode_run(bench_state* state, int size, int iterations)
+{
+    unsigned int sum = 0;
+    int value;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTPacket_decodeBuf(state->buf, &value);
+        sum += value;
+    }
+    return sum;
+}
+
+/* A length prefixed string of size bytes */
+static int bench_lenstring_setup(bench_state* state, int size)
+{
+    unsigned char* ptr = state->buf;
+
+    writeInt(&ptr, size);
+    memset(ptr, 'a', size);
+    state->len = size + 2;
+
+    return state->len;
+}
+
+static int bench_lenstring_run(bench_state* state, int size, int iterations)
+{
+    MQTTString string;
+    unsigned char* ptr;
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        ptr = state->buf;
+        sum += readMQTTLenString(&string, &ptr, &state->buf[state->len]);
+        sum += string.lenstring.len;
+    }
+    return sum;
+}
+
+/* A connect with the device's client id - size is the password (JWT) length */
+static void bench_connect_options(bench_state* state, int size, MQTTPacket_connectData* options)
+{
+    memset(state->password, 'j', size);
+    state->password[size] = '\0';
+
+    options->MQTTVersion = 4;
+    options->keepAliveInterval = 900;
+    options->cleansession = 0;
+    options->clientID.cstring = BENCH_CLIENT_ID;
+    options->username.cstring = "unused";
+    options->password.cstring = state->password;
+}
+
+static int bench_connect_setup(bench_state* state, int size)
+{
+    MQTTPacket_connectData options = MQTTPacket_connectData_initializer;
+
+    bench_connect_options(state, size, &options);
+    state->len = MQTTSerialize_connect(state->buf, BENCH_BUF_SIZE, &options);
+
+    return state->len;
+}
+
+static int bench_connect_serialize_run(bench_state* state, int size, int iterations)
+{
+    MQTTPacket_connectData options = MQTTPacket_connectData_initializer;
+    unsigned int sum = 0;
+    int i;
+
+    bench_connect_options(state, size, &options);
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTSerialize_connect(state->buf, BENCH_BUF_SIZE, &options);
+    }
+    return sum;
+}
+
+static int bench_connect_deserialize_run(bench_state* state, int size, int iterations)
+{
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTDeserialize_connect(&data, state->buf, state->len);
+        sum += data.password.lenstring.len;
+    }
+    return sum;
+}
+
+/* A QoS 1 telemetry publish with a size byte payload */
+static int bench_publish_setup(bench_state* state, int size)
+{
+    MQTTString topic = MQTTString_initializer;
+
+    topic.cstring = BENCH_TOPIC;
+    memset(state->payload, 'p', size);
+    state->len = MQTTSerialize_publish(state->buf, BENCH_BUF_SIZE, 0, 1, 0, 1, topic, state->payload, size);
+
+    MQTTPublishTemplate_init(&state->tmpl, state->tmpl_buf, sizeof(state->tmpl_buf), 1, 0, topic);
+
+    return state->len;
+}
+
+static int bench_publish_serialize_run(bench_state* state, int size, int iterations)
+{
+    MQTTString topic = MQTTString_initializer;
+    unsigned int sum = 0;
+    int i;
+
+    topic.cstring = BENCH_TOPIC;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTSerialize_publish(state->buf, BENCH_BUF_SIZE, 0, 1, 0, (unsigned short)(i | 1),
+            topic, state->payload, size);
+    }
+    return sum;
+}
+
+/* The header for a payload sent from its own buffer, as client_task does */
+static int bench_publish_template_run(bench_state* state, int size, int iterations)
+{
+    unsigned char* header;
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTPublishTemplate_header(&state->tmpl, 0, (unsigned short)(i | 1), size, &header);
+        sum += *header;
+    }
+    return sum;
+}
+
+static int bench_publish_deserialize_run(bench_state* state, int size, int iterations)
+{
+    MQTTString topic;
+    unsigned char* payload;
+    int payloadlen;
+    unsigned short packetid;
+    unsigned char dup;
+    unsigned char retained;
+    int qos;
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTDeserialize_publish(&dup, &qos, &retained, &packetid, &topic, &payload, &payloadlen,
+            state->buf, state->len);
+        sum += payloadlen;
+    }
+    return sum;
+}
+
+/* The handler match the client made before the trie - every filter is compared in turn */
+static char bench_is_topic_matched(char* topicFilter, MQTTString* topicName)
+{
+    char* curf = topicFilter;
+    char* curn = topicName->lenstring.data;
+    char* curn_end = curn + topicName->lenstring.len;
+
+    while (*curf && curn < curn_end)
+    {
+        if (*curn == '/' && *curf != '/')
+            break;
+        if (*curf != '+' && *curf != '#' && *curf != *curn)
+            break;
+        if (*curf == '+')
+        {   // skip until we meet the next separator, or end of string
+            char* nextpos = curn + 1;
+            while (nextpos < curn_end && *nextpos != '/')
+                nextpos = ++curn + 1;
+        }
+        else if (*curf == '#')
+            curn = curn_end - 1;    // skip until end of string
+        curf++;
+        curn++;
+    };
+
+    return (curn == curn_end) && (*curf == '\0');
+}
+
+static MQTTTopicHandlerMask bench_linear_match(bench_state* state)
+{
+    MQTTTopicHandlerMask found = 0;
+    int i;
+
+    for (i = 0; i < state->filter_count; i++)
+    {
+        if (MQTTPacket_equals(&state->topic, state->filters[i]) ||
+            bench_is_topic_matched(state->filters[i], &state->topic))
+        {
+            found |= ((MQTTTopicHandlerMask)1 << i);
+        }
+    }
+    return found;
+}
+
+/* size topic filters - the config topic, every command and a handler per command
+ * subfolder. The topic is the last subfolder's command, which the commands filter
+ * matches as well. */
+static int bench_dispatch_setup(bench_state* state, int size)
+{
+    int i;
+
+    state->filter_count = size;
+    snprintf(state->filters[0], BENCH_FILTER_SIZE, BENCH_DEVICE_TOPIC "config");
+    snprintf(state->filters[1], BENCH_FILTER_SIZE, BENCH_DEVICE_TOPIC "commands/#");
+    for (i = 2; i < size; i++)
+    {
+        snprintf(state->filters[i], BENCH_FILTER_SIZE, BENCH_DEVICE_TOPIC "commands/sub%d/+", i);
+    }
+
+    MQTTTopicTrie_init(&state->trie);
+    for (i = 0; i < size; i++)
+    {
+        if (MQTTTopicTrie_insert(&state->trie, state->filters[i], i))
+        {
+            fprintf(stderr, "dispatch: no room for %d filters in the trie\n", size);
+            exit(2);
+        }
+    }
+
+    snprintf(state->topic_name, BENCH_FILTER_SIZE, BENCH_DEVICE_TOPIC "commands/sub%d/fan", size - 1);
+    state->topic.cstring = NULL;
+    state->topic.lenstring.data = state->topic_name;
+    state->topic.lenstring.len = strlen(state->topic_name);
+
+    /* Both must pick the same handlers or the comparison means nothing */
+    if (MQTTTopicTrie_match(&state->trie, &state->topic) != bench_linear_match(state))
+    {
+        fprintf(stderr, "dispatch: the trie and the linear match differ for %d filters\n", size);
+        exit(2);
+    }
+
+    return state->topic.lenstring.len;
+}
+
+static int bench_dispatch_trie_run(bench_state* state, int size, int iterations)
+{
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTTopicTrie_match(&state->trie, &state->topic);
+    }
+    return sum;
+}
+
+static int bench_dispatch_linear_run(bench_state* state, int size, int iterations)
+{
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += bench_linear_match(state);
+    }
+    return sum;
+}
+
+/* Transport with every byte of the stream already received - exactly length bytes */
+static int bench_transport_read(Network* n, unsigned char* read_buffer, int length, int timeout_ms)
+{
+    bench_state* state = (bench_state*)n->context;
+    int first = state->stream_len - state->stream_pos;
+
+    state->transport_reads++;
+
+    if (first > length)
+    {
+        first = length;
+    }
+    memcpy(read_buffer, &state->stream[state->stream_pos], first);
+    memcpy(&read_buffer[first], state->stream, length - first);
+    state->stream_pos = (state->stream_pos + length) % state->stream_len;
+
+    return length;
+}
+
+/* Up to length bytes - a socket returns what has arrived, here everything up to the end of the stream */
+static int bench_transport_read_some(Network* n, unsigned char* read_buffer, int length, int timeout_ms)
+{
+    bench_state* state = (bench_state*)n->context;
+
+    if (length > state->stream_len - state->stream_pos)
+    {
+        length = state->stream_len - state->stream_pos;
+    }
+    return bench_transport_read(n, read_buffer, length, timeout_ms);
+}
+
+/* MQTTPacket_read getfn straight from the transport - the header byte, each remaining
+ * length byte and the rest are separate calls, as the client made before the
+ * read-ahead buffer */
+static int bench_direct_get(unsigned char* buf, int len)
+{
+    return bench_transport_read(&g_state.transport, buf, len, 0);
+}
+
+/* The same reads served by the read-ahead buffer */
+static int bench_buffered_get(unsigned char* buf, int len)
+{
+    return network_buffer_read(&g_state.readahead.net, buf, len, 0);
+}
+
+/* What the device receives - a puback for its telemetry, then a command with a size byte payload */
+static int bench_read_setup(bench_state* state, int size)
+{
+    MQTTString topic = MQTTString_initializer;
+
+    topic.cstring = BENCH_DEVICE_TOPIC "commands";
+    memset(state->payload, 'c', size);
+    state->stream_len = MQTTSerialize_puback(state->stream, BENCH_BUF_SIZE, 1);
+    state->stream_len += MQTTSerialize_publish(&state->stream[state->stream_len], BENCH_BUF_SIZE - state->stream_len,
+        0, 1, 0, 2, topic, state->payload, size);
+    state->stream_pos = 0;
+
+    memset(&state->transport, 0, sizeof(state->transport));
+    state->transport.mqttread = &bench_transport_read;
+    state->transport.mqttreadsome = &bench_transport_read_some;
+    state->transport.context = state;
+    network_buffer_init(&state->readahead, &state->transport, state->readahead_buf, BENCH_READAHEAD_SIZE);
+
+    /* Average bytes per packet */
+    return state->stream_len / 2;
+}
+
+static int bench_read_direct_run(bench_state* state, int size, int iterations)
+{
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTPacket_read(state->buf, BENCH_BUF_SIZE, &bench_direct_get);
+    }
+    return sum;
+}
+
+static int bench_read_buffered_run(bench_state* state, int size, int iterations)
+{
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        sum += MQTTPacket_read(state->buf, BENCH_BUF_SIZE, &bench_buffered_get);
+    }
+    return sum;
+}
+
+/* Remaining lengths taking one to four bytes */
+static const int g_encode_sizes[] = { 100, 10000, 1000000, 200000000, -1 };
+static const int g_string_sizes[] = { 8, 64, 256, 1024, -1 };
+static const int g_password_sizes[] = { 0, 256, 512, -1 };
+static const int g_payload_sizes[] = { 0, 16, 64, 256, 1024, 4096, BENCH_MAX_PAYLOAD, -1 };
+static const int g_filter_counts[] = { 2, 5, 16, BENCH_MAX_FILTERS, -1 };
+static const int g_command_sizes[] = { 16, 128, 1024, -1 };
+
+static const bench_case g_cases[] =
+{
+    { "encode",                 g_encode_sizes,     bench_encode_setup,     bench_encode_run },
+    { "decode",                 g_encode_sizes,     bench_encode_setup,     bench_decode_run },
+    { "lenstring_read",         g_string_sizes,     bench_lenstring_setup,  bench_lenstring_run },
+    { "connect_serialize",      g_password_sizes,   bench_connect_setup,    bench_connect_serialize_run },
+    { "connect_deserialize",    g_password_sizes,   bench_connect_setup,    bench_connect_deserialize_run },
+    { "publish_serialize",      g_payload_sizes,    bench_publish_setup,    bench_publish_serialize_run },
+    { "publish_template",       g_payload_sizes,    bench_publish_setup,    bench_publish_template_run },
+    { "publish_deserialize",    g_payload_sizes,    bench_publish_setup,    bench_publish_deserialize_run },
+    { "dispatch_trie",          g_filter_counts,    bench_dispatch_setup,   bench_dispatch_trie_run },
+    { "dispatch_linear",        g_filter_counts,    bench_dispatch_setup,   bench_dispatch_linear_run },
+    { "read_direct",            g_command_sizes,    bench_read_setup,       bench_read_direct_run },
+    { "read_buffered",          g_command_sizes,    bench_read_setup,       bench_read_buffered_run },
+};
+
+/* Lines of "<case> <size> <minimum packets per second>", # starts a comment */
+static int bench_load_thresholds(const char* path)
+{
+    char line[128];
+    bench_threshold* t;
+    FILE* fp;
+
+    if (NULL == (fp = fopen(path, "r")))
+    {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) && g_threshold_count < BENCH_MAX_THRESHOLDS)
+    {
+        t = &g_thresholds[g_threshold_count];
+        if ('#' != line[0] && 3 == sscanf(line, "%31s %d %lf", t->name, &t->size, &t->min_packets_per_s))
+        {
+            g_threshold_count++;
+        }
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+static const bench_threshold* bench_find_threshold(const char* name, int size)
+{
+    int i;
+
+    for (i = 0; i < g_threshold_count; i++)
+    {
+        if (g_thresholds[i].size == size && !strcmp(g_thresholds[i].name, name))
+        {
+            return &g_thresholds[i];
+        }
+    }
+    return NULL;
+}
+
+/* Run one case for at least duration_ns - returns 1 if it fell below its threshold */
+static int bench_run_case(const bench_case* bc, int size, int64_t duration_ns, double scale)
+{
+    const bench_threshold* threshold;
+    const char* result = "none";
+    double packets_per_s;
+    double min_packets_per_s = 0;
+    int64_t start;
+    int64_t elapsed;
+    uint64_t packets = 0;
+    int packet_len;
+
+    packet_len = bc->setup(&g_state, size);
+
+    /* Warm the caches and branch predictors */
+    g_sink += bc->run(&g_state, size, BENCH_BATCH);
+    g_state.transport_reads = 0;
+
+    start = bench_now_ns();
+    do
+    {
+        g_sink += bc->run(&g_state, size, BENCH_BATCH);
+        packets += BENCH_BATCH;
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < duration_ns);
+
+    packets_per_s = packets * 1e9 / elapsed;
+
+    if (NULL != (threshold = bench_find_threshold(bc->name, size)))
+    {
+        min_packets_per_s = threshold->min_packets_per_s * scale;
+        result = (packets_per_s >= min_packets_per_s) ? "pass" : "fail";
+    }
+
+    printf("bench=%s size=%d packet_bytes=%d packets=%llu ns_per_packet=%.1f packets_per_s=%.0f "
+        "bytes_per_s=%.0f min_packets_per_s=%.0f ",
+        bc->name, size, packet_len, (unsigned long long)packets, (double)elapsed / packets,
+        packets_per_s, packets_per_s * packet_len, min_packets_per_s);
+    if (g_state.transport_reads)
+    {
+        printf("transport_reads_per_packet=%.2f ", (double)g_state.transport_reads / packets);
+    }
+    printf("result=%s\n", result);
+    fflush(stdout);
+
+    return (threshold && packets_per_s < min_packets_per_s) ? 1 : 0;
+}
+
+static void bench_usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [-t thresholds] [-s scale] [-d milliseconds] [-f case]\n"
+        "  -t  fail (exit status 1) when a case is slower than its line in this file\n"
+        "  -s  multiply the thresholds, e.g. 0.5 on a slow machine (1.0)\n"
+        "  -d  time each case for this long (200)\n"
+        "  -f  only run the cases whose name starts with this\n",
+        name);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = NULL;
+    int64_t duration_ns = 200 * 1000000LL;
+    double scale = 1.0;
+    unsigned int i;
+    int failures = 0;
+    int opt;
+    int s;
+
+    while (-1 != (opt = getopt(argc, argv, "t:s:d:f:h")))
+    {
+        switch (opt)
+        {
+        case 't':
+            if (bench_load_thresholds(optarg))
+            {
+                fprintf(stderr, "Failed to read %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 's':
+            scale = atof(optarg);
+            break;
+        case 'd':
+            duration_ns = atoll(optarg) * 1000000LL;
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        default:
+            bench_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    for (i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++)
+    {
+        if (filter && strncmp(g_cases[i].name, filter, strlen(filter)))
+        {
+            continue;
+        }
+
+        for (s = 0; g_cases[i].sizes[s] >= 0; s++)
+        {
+            failures += bench_run_case(&g_cases[i], g_cases[i].sizes[s], duration_ns, scale);
+        }
+    }
+
+    printf("failures=%d\n", failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * \file
+ * \brief  WIFI control API for a Linux host - the network is always up
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include "asf.h"
+#include "config.h"
+#include "wifi_task.h"
+#include "time_utils.h"
+
+/** \brief Set up a context - no socket is open */
+void wifi_init(wifi_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+
+    ctx->sock = -1;
+    ctx->connect_sock = -1;
+}
+
+/* Nothing to drive - the socket calls complete in the kernel */
+void wifi_task(wifi_context *ctx)
+{
+}
+
+void wifi_timer_update(wifi_context *ctx)
+{
+}
+
+int wifi_is_ready(wifi_context *ctx)
+{
+    return true;
+}
+
+int wifi_is_busy(wifi_context *ctx)
+{
+    return false;
+}
+
+/* Received data waits in the kernel - nothing is notified */
+void wifi_set_rx_notify(wifi_context *ctx, void (*notify)(void *arg), void *arg)
+{
+    ctx->rx_notify = notify;
+    ctx->rx_notify_arg = arg;
+}
+
+/* Socket errors are returned by the socket calls themselves */
+int wifi_has_error(wifi_context *ctx)
+{
+    return false;
+}
+
+/** \brief The system clock is already UTC */
+uint32_t host_time_utc(void)
+{
+    return (uint32_t)time(NULL);
+}
+
+/* Take the time from the system clock rather than NTP */
+void wifi_request_time(wifi_context *ctx)
+{
+    time_t now = time(NULL);
+    struct tm utc;
+
+    if(gmtime_r(&now, &utc))
+    {
+        time_utils_set(utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec);
+    }
+}
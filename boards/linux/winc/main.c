@@ -0,0 +1,154 @@
+/**
+ * \file
+ * \brief  Linux host entry point - runs the device WIFI task on the WINC1500 emulator
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <signal.h>
+#include <unistd.h>
+#include "asf.h"
+#include "config.h"
+
+/* Tasks */
+#include "wifi_task.h"
+#include "client_task.h"
+#include "sensor_task.h"
+
+/* Paho Client Timer */
+#include "timer_interface.h"
+
+/* The module under the WIFI task */
+#include "winc_emu.h"
+#include "winc_host.h"
+
+static volatile sig_atomic_t g_stop;
+
+/* One simulated device */
+static wifi_context    g_wifi_context;
+static client_context  g_client_context;
+static sensor_context  g_sensor_context;
+
+static void stop_handler(int signum)
+{
+    g_stop = 1;
+}
+
+/* What the periodic timer interrupt does on the boards - delivered by the emulator */
+void update_timers(void)
+{
+    wifi_timer_update(&g_wifi_context);
+    client_timer_update(&g_client_context);
+    TimerCallback();
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-t virtual_seconds] [-s settle_ms] [-r restart_seconds] [-d dhcp_ms]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    winc_emu_config config = WINC_EMU_CONFIG_DEFAULT;
+    const winc_emu_stats* stats;
+    uint64_t limit_ms = 0;
+    uint64_t started;
+    uint64_t real_ms;
+    uint64_t virtual_ms;
+    int opt;
+
+    while((opt = getopt(argc, argv, "t:s:r:d:")) != -1)
+    {
+        switch(opt)
+        {
+            case 't':
+            limit_ms = strtoull(optarg, NULL, 0) * 1000;
+            break;
+
+            case 's':
+            config.settle_ms = strtoul(optarg, NULL, 0);
+            break;
+
+            case 'r':
+            config.restart_ms = strtoul(optarg, NULL, 0) * 1000;
+            break;
+
+            case 'd':
+            config.dhcp_ms = strtoul(optarg, NULL, 0);
+            break;
+
+            default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    winc_emu_init(&config, &update_timers, TIMER_UPDATE_PERIOD);
+
+    wifi_init(&g_wifi_context);
+    sensor_init(&g_sensor_context);
+    client_init(&g_client_context, &g_wifi_context, &g_sensor_context);
+
+    started = winc_host_real_ms();
+
+    /* No idle sleep - the tasks run as fast as the emulator's virtual clock allows */
+    while(!g_stop && (!limit_ms || winc_emu_time_ms() < limit_ms))
+    {
+        wifi_task(&g_wifi_context);
+        client_task(&g_client_context);
+        sensor_task(&g_sensor_context);
+
+        winc_emu_pass_done();
+    }
+
+    real_ms = winc_host_real_ms() - started;
+    virtual_ms = winc_emu_time_ms();
+    stats = winc_emu_get_stats();
+
+    printf("Publish queue depth %u, dropped %u\r\n",
+        (unsigned)client_publish_queue_depth(&g_client_context),
+        (unsigned)client_publish_queue_dropped(&g_client_context));
+
+    printf("winc virtual_ms=%llu real_ms=%llu speedup=%llu ticks=%llu events=%llu joins=%u join_scans=%u joined_joins=%u join_ms=%llu "
+        "scans=%u restarts=%u resolves=%u connects=%u "
+        "sends=%llu send_bytes=%llu recvs=%llu recv_bytes=%llu recv_timeouts=%llu skipped_ms=%llu waited_ms=%llu\r\n",
+        (unsigned long long)virtual_ms, (unsigned long long)real_ms,
+        (unsigned long long)(virtual_ms / (real_ms ? real_ms : 1)),
+        (unsigned long long)stats->ticks, (unsigned long long)stats->events,
+        stats->joins, stats->join_scans, stats->joined_joins, (unsigned long long)stats->join_ms, stats->scans, stats->restarts,
+        stats->resolves, stats->connects,
+        (unsigned long long)stats->sends, (unsigned long long)stats->send_bytes,
+        (unsigned long long)stats->recvs, (unsigned long long)stats->recv_bytes,
+        (unsigned long long)stats->recv_timeouts, (unsigned long long)stats->skipped_ms,
+        (unsigned long long)stats->waited_ms);
+
+    /* The module was told to join while it still was - the WIFI task lost track of it */
+    return stats->joined_joins ? 1 : 0;
+}
@@ -0,0 +1,959 @@
+/**
+ * \file
+ * \brief  WINC1500 emulator - the driver API on POSIX sockets under a virtual clock
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include "asf.h"
+
+/* The WINC1500 driver headers, exactly as the boards build against them */
+#include "driver/include/m2m_wifi.h"
+#include "driver/include/m2m_periph.h"
+#include "driver/include/m2m_ssl.h"
+#include "driver/include/m2m_types.h"
+#include "socket/include/socket.h"
+
+#include "winc_emu.h"
+#include "winc_host.h"
+
+/* The module is emulated at its API: the calls wifi_task.c makes are answered with the callbacks the
+ * firmware would send, from m2m_wifi_handle_events as the driver does. Sockets are host TCP
+ * sockets - TLS is not emulated. Time is virtual. It runs in step with the wall clock while an
+ * answer from the far end is awaited, and jumps to the next tick, event or timeout when a pass of
+ * the main loop ends with nothing to do. The periodic timer interrupt is delivered from m2m_wifi_handle_events, so
+ * the holdoffs and the Paho timers run on the virtual clock too. */
+
+/** Callbacks waiting for their virtual time */
+#define WINC_EMU_EVENTS     (32)
+
+/** Address handed out by the emulated DHCP server */
+#define WINC_EMU_IP_ADDRESS ((uint32)((100 << 24) | (1 << 16) | (168 << 8) | 192))
+
+/** Idle polls within one pass of the main loop before the application is taken to be waiting on the clock */
+#define WINC_EMU_IDLE_POLLS (64)
+
+/** Bytes of sends the module holds before send returns SOCK_ERR_BUFFER_FULL */
+#define WINC_EMU_TX_BUFFER  (4 * SOCKET_BUFFER_MAX_LENGTH)
+
+/** Sends the module holds */
+#define WINC_EMU_TX_SENDS   (8)
+
+/** Chip ID of a WINC1500 */
+#define WINC_EMU_CHIP_ID    (0x1503A0)
+
+/** A scan finds the access point and a neighbour on another channel */
+#define WINC_EMU_SCAN_APS   (2)
+
+/** The access point and its neighbour */
+static const uint8 g_winc_emu_bssid[WINC_EMU_SCAN_APS][M2M_MAC_ADDRES_LEN] = {
+    {0x02, 0x00, 0x00, 0x00, 0x00, 0x01},
+    {0x02, 0x00, 0x00, 0x00, 0x00, 0x02}
+};
+
+enum {
+    WINC_EMU_EVENT_WIFI,
+    WINC_EMU_EVENT_SOCKET,
+    WINC_EMU_EVENT_RESOLVE,
+    WINC_EMU_EVENT_RESTART      /**< The access point restarts */
+};
+
+typedef struct _winc_emu_event {
+    uint64_t    due;        /**< Virtual ms the callback is made */
+    uint8_t     kind;
+    uint8_t     msg;
+    SOCKET      sock;
+    union {
+        tstrM2mWifiStateChanged state;
+        tstrM2MIPConfig         ip;
+        tstrM2MConnInfo         conn_info;
+        tstrM2mScanDone         scan_done;
+        tstrM2mWifiscanResult   scan_result;
+        tstrSystemTime          time;
+        tstrSocketConnectMsg    connect;
+        tstrSocketRecvMsg       recv;
+        sint16                  sent;
+        uint32                  addr;
+    } u;
+    char        name[HOSTNAME_MAX_SIZE];
+} winc_emu_event;
+
+typedef struct _winc_emu_socket {
+    bool        used;
+    int         fd;
+    bool        connecting;
+    bool        connected;
+    bool        rx_posted;      /**< A recv is waiting for data */
+    uint8*      rx_buf;
+    uint16      rx_len;
+    uint64_t    rx_deadline;    /**< Virtual ms the recv times out, 0 for never */
+    uint8       tx_buf[WINC_EMU_TX_BUFFER];     /**< Sends not yet written out, in order */
+    uint16      tx_len;         /**< Bytes in tx_buf */
+    uint16      tx_sent;        /**< Bytes of tx_buf written to the host socket */
+    uint16      tx_sends[WINC_EMU_TX_SENDS];    /**< Length of each send in tx_buf */
+    uint8       tx_count;
+} winc_emu_socket;
+
+static struct {
+    winc_emu_config     config;
+    winc_emu_stats      stats;
+    void                (*tick)(void);
+    uint32_t            tick_ms;
+    uint64_t            now;            /**< Virtual ms */
+    uint64_t            next_tick;
+    time_t              utc_base;       /**< Wall clock UTC when virtual time started */
+    bool                awaiting;       /**< Sent something and nothing has been received since */
+    uint64_t            awaiting_since; /**< Real ms */
+    bool                pass_done;      /**< The main loop has finished a pass since the last skip */
+    uint32_t            idle_polls;     /**< Idle polls since the last skip or delivery */
+    uint32_t            channel;        /**< The access point's channel now */
+    bool                associated;     /**< Joined to the access point, or about to be */
+    char                ssid[M2M_MAX_SSID_LEN];     /**< Of the last join */
+    tpfAppWifiCb        wifi_cb;
+    tpfAppSocketCb      socket_cb;
+    tpfAppResolveCb     resolve_cb;
+    winc_emu_event      events[WINC_EMU_EVENTS];
+    uint32_t            event_count;
+    winc_emu_socket     sockets[TCP_SOCK_MAX];
+} g_emu;
+
+/* Move virtual time forward, delivering the timer interrupts on the way */
+static void winc_emu_advance(uint64_t target)
+{
+    while(g_emu.tick_ms && g_emu.next_tick <= target)
+    {
+        g_emu.now = g_emu.next_tick;
+        g_emu.next_tick += g_emu.tick_ms;
+        g_emu.stats.ticks++;
+        if(g_emu.tick)
+        {
+            g_emu.tick();
+        }
+    }
+
+    if(target > g_emu.now)
+    {
+        g_emu.now = target;
+    }
+}
+
+/* Queue a callback - events due at the same time keep their order */
+static winc_emu_event* winc_emu_post(uint8_t kind, uint8_t msg, SOCKET sock, uint32_t delay_ms)
+{
+    winc_emu_event* event;
+    uint64_t due = g_emu.now + delay_ms;
+    uint32_t i;
+
+    if(g_emu.event_count == WINC_EMU_EVENTS)
+    {
+        /* The application is not calling m2m_wifi_handle_events */
+        return NULL;
+    }
+
+    for(i = g_emu.event_count; i > 0 && g_emu.events[i - 1].due > due; i--)
+    {
+    }
+    memmove(&g_emu.events[i + 1], &g_emu.events[i], (g_emu.event_count - i) * sizeof(g_emu.events[0]));
+    g_emu.event_count++;
+
+    event = &g_emu.events[i];
+    memset(event, 0, sizeof(*event));
+    event->due = due;
+    event->kind = kind;
+    event->msg = msg;
+    event->sock = sock;
+
+    return event;
+}
+
+/* Drop the callbacks still queued for a closed socket */
+static void winc_emu_purge(SOCKET sock)
+{
+    uint32_t i;
+    uint32_t kept = 0;
+
+    for(i = 0; i < g_emu.event_count; i++)
+    {
+        if(g_emu.events[i].kind != WINC_EMU_EVENT_SOCKET || g_emu.events[i].sock != sock)
+        {
+            g_emu.events[kept++] = g_emu.events[i];
+        }
+    }
+    g_emu.event_count = kept;
+}
+
+/* Restart the access point - the station is dropped, and every other time it comes back on another channel */
+static void winc_emu_restart(void)
+{
+    winc_emu_event* event;
+
+    g_emu.stats.restarts++;
+    if(0 == (g_emu.stats.restarts % 2))
+    {
+        g_emu.channel = (g_emu.channel % M2M_WIFI_CH_11) + 1;
+    }
+
+    if(g_emu.associated)
+    {
+        g_emu.associated = false;
+        if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_RESP_CON_STATE_CHANGED, 0, 0)))
+        {
+            event->u.state.u8CurrState = M2M_WIFI_DISCONNECTED;
+        }
+    }
+
+    winc_emu_post(WINC_EMU_EVENT_RESTART, 0, 0, g_emu.config.restart_ms);
+}
+
+/* Make the callbacks that are due - returns the number made */
+static uint32_t winc_emu_deliver(void)
+{
+    winc_emu_event event;
+    uint32_t delivered = 0;
+
+    while(g_emu.event_count && g_emu.events[0].due <= g_emu.now)
+    {
+        /* Callbacks may queue more events */
+        event = g_emu.events[0];
+        g_emu.event_count--;
+        memmove(&g_emu.events[0], &g_emu.events[1], g_emu.event_count * sizeof(g_emu.events[0]));
+
+        switch(event.kind)
+        {
+            case WINC_EMU_EVENT_WIFI:
+            if(g_emu.wifi_cb)
+            {
+                g_emu.wifi_cb(event.msg, &event.u);
+            }
+            break;
+
+            case WINC_EMU_EVENT_SOCKET:
+            if(g_emu.socket_cb)
+            {
+                g_emu.socket_cb(event.sock, event.msg, &event.u);
+            }
+            break;
+
+            case WINC_EMU_EVENT_RESOLVE:
+            if(g_emu.resolve_cb)
+            {
+                g_emu.resolve_cb((uint8*)event.name, event.u.addr);
+            }
+            break;
+
+            case WINC_EMU_EVENT_RESTART:
+            winc_emu_restart();
+            break;
+
+            default:
+            break;
+        }
+
+        g_emu.stats.events++;
+        delivered++;
+    }
+
+    return delivered;
+}
+
+/* Complete a posted recv */
+static void winc_emu_recv_done(SOCKET sock, sint16 size)
+{
+    winc_emu_socket* s = &g_emu.sockets[sock];
+    winc_emu_event* event;
+
+    s->rx_posted = false;
+
+    if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_SOCKET, SOCKET_MSG_RECV, sock, 0)))
+    {
+        event->u.recv.pu8Buffer = s->rx_buf;
+        event->u.recv.s16BufferSize = size;
+        event->u.recv.u16RemainingSize = 0;
+    }
+}
+
+/* Complete a send */
+static void winc_emu_send_done(SOCKET sock, sint16 sent)
+{
+    winc_emu_event* event;
+
+    if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_SOCKET, SOCKET_MSG_SEND, sock, 0)))
+    {
+        event->u.sent = sent;
+    }
+}
+
+/* Write out as much of the held sends as the host socket takes, completing each once it is written */
+static void winc_emu_flush(SOCKET sock)
+{
+    winc_emu_socket* s = &g_emu.sockets[sock];
+    uint16 length;
+    int rc;
+
+    while(s->tx_sent < s->tx_len)
+    {
+        rc = winc_host_send(s->fd, &s->tx_buf[s->tx_sent], s->tx_len - s->tx_sent);
+        if(rc == WINC_HOST_AGAIN)
+        {
+            break;
+        }
+        if(rc < 0)
+        {
+            /* Every send still held fails */
+            while(s->tx_count)
+            {
+                s->tx_count--;
+                winc_emu_send_done(sock, SOCK_ERR_CONN_ABORTED);
+            }
+            s->tx_len = 0;
+            s->tx_sent = 0;
+            return;
+        }
+        s->tx_sent += rc;
+    }
+
+    while(s->tx_count && s->tx_sends[0] <= s->tx_sent)
+    {
+        length = s->tx_sends[0];
+
+        g_emu.stats.sends++;
+        g_emu.stats.send_bytes += length;
+        g_emu.awaiting = true;
+        g_emu.awaiting_since = winc_host_real_ms();
+        winc_emu_send_done(sock, (sint16)length);
+
+        memmove(&s->tx_buf[0], &s->tx_buf[length], s->tx_len - length);
+        s->tx_len -= length;
+        s->tx_sent -= length;
+
+        s->tx_count--;
+        memmove(&s->tx_sends[0], &s->tx_sends[1], s->tx_count * sizeof(s->tx_sends[0]));
+    }
+}
+
+/* Move the host sockets on - waits up to timeout_ms of real time for one to become ready */
+static void winc_emu_poll(int timeout_ms)
+{
+    int fds[TCP_SOCK_MAX];
+    uint8_t want[TCP_SOCK_MAX];
+    uint8_t ready[TCP_SOCK_MAX];
+    SOCKET socks[TCP_SOCK_MAX];
+    winc_emu_event* event;
+    winc_emu_socket* s;
+    int count = 0;
+    int rc;
+    int i;
+
+    for(i = 0; i < TCP_SOCK_MAX; i++)
+    {
+        s = &g_emu.sockets[i];
+        if(!s->used)
+        {
+            continue;
+        }
+
+        /* Receives time out in virtual time */
+        if(s->rx_posted && s->rx_deadline && g_emu.now >= s->rx_deadline)
+        {
+            g_emu.stats.recv_timeouts++;
+            winc_emu_recv_done(i, SOCK_ERR_TIMEOUT);
+        }
+
+        want[count] = ((s->connecting || s->tx_count) ? WINC_HOST_WRITABLE : 0) |
+            (s->rx_posted ? WINC_HOST_READABLE : 0);
+        if(want[count])
+        {
+            fds[count] = s->fd;
+            socks[count] = i;
+            count++;
+        }
+    }
+
+    if(winc_host_wait(fds, want, ready, count, timeout_ms) <= 0)
+    {
+        return;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        s = &g_emu.sockets[socks[i]];
+
+        if(s->connecting && (ready[i] & WINC_HOST_WRITABLE))
+        {
+            if(0 != (rc = winc_host_connect_result(s->fd)))
+            {
+                s->connecting = false;
+                s->connected = (rc > 0);
+                g_emu.stats.connects += s->connected;
+                if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_SOCKET, SOCKET_MSG_CONNECT, socks[i], 0)))
+                {
+                    event->u.connect.sock = socks[i];
+                    event->u.connect.s8Error = s->connected ? SOCK_ERR_NO_ERROR : SOCK_ERR_CONN_ABORTED;
+                }
+            }
+            continue;
+        }
+
+        if(s->tx_count && (ready[i] & WINC_HOST_WRITABLE))
+        {
+            winc_emu_flush(socks[i]);
+        }
+
+        if(s->rx_posted && (ready[i] & WINC_HOST_READABLE))
+        {
+            rc = winc_host_recv(s->fd, s->rx_buf, s->rx_len);
+            if(rc == WINC_HOST_AGAIN)
+            {
+                continue;
+            }
+            if(rc > 0)
+            {
+                g_emu.stats.recvs++;
+                g_emu.stats.recv_bytes += rc;
+                g_emu.awaiting = false;
+                winc_emu_recv_done(socks[i], (sint16)rc);
+            }
+            else
+            {
+                /* The peer closed the connection */
+                winc_emu_recv_done(socks[i], SOCK_ERR_CONN_ABORTED);
+            }
+        }
+    }
+}
+
+/* Nothing was delivered - wait on the far end, or skip to when something can next happen */
+static void winc_emu_idle(void)
+{
+    uint64_t started = winc_host_real_ms();
+    uint64_t target;
+    uint64_t waited;
+    bool busy = g_emu.awaiting && (started - g_emu.awaiting_since) < g_emu.config.settle_ms;
+    int i;
+
+    for(i = 0; i < TCP_SOCK_MAX; i++)
+    {
+        busy |= g_emu.sockets[i].used && (g_emu.sockets[i].connecting || g_emu.sockets[i].tx_count);
+    }
+
+    if(busy)
+    {
+        /* Keep virtual time in step with the wall clock until the answer arrives */
+        winc_emu_poll(1);
+        waited = winc_host_real_ms() - started;
+        g_emu.stats.waited_ms += waited;
+        winc_emu_advance(g_emu.now + waited);
+        return;
+    }
+
+    /* An idle poll costs microseconds on a board, so skip ahead only once the pass is over -
+       or when the application keeps polling because it is blocked on the clock */
+    if(!g_emu.pass_done && ++g_emu.idle_polls < WINC_EMU_IDLE_POLLS)
+    {
+        return;
+    }
+    g_emu.pass_done = false;
+    g_emu.idle_polls = 0;
+
+    target = g_emu.tick_ms ? g_emu.next_tick : g_emu.now + 1;
+    if(g_emu.event_count && g_emu.events[0].due < target)
+    {
+        target = g_emu.events[0].due;
+    }
+    for(i = 0; i < TCP_SOCK_MAX; i++)
+    {
+        if(g_emu.sockets[i].used && g_emu.sockets[i].rx_posted && g_emu.sockets[i].rx_deadline &&
+            g_emu.sockets[i].rx_deadline < target)
+        {
+            target = g_emu.sockets[i].rx_deadline;
+        }
+    }
+
+    g_emu.stats.skipped_ms += target - g_emu.now;
+    winc_emu_advance(target);
+}
+
+/* A socket handle the application may use */
+static winc_emu_socket* winc_emu_socket_get(SOCKET sock)
+{
+    if(sock < 0 || sock >= TCP_SOCK_MAX || !g_emu.sockets[sock].used)
+    {
+        return NULL;
+    }
+
+    return &g_emu.sockets[sock];
+}
+
+/**
+ * \brief Start the emulator - call before the application's first WINC call
+ *
+ * \param config[in]        Delays and pacing, NULL for WINC_EMU_CONFIG_DEFAULT
+ * \param tick[in]          The periodic timer interrupt handler
+ * \param tick_ms[in]       Virtual ms between timer interrupts
+ */
+void winc_emu_init(const winc_emu_config* config, void (*tick)(void), uint32_t tick_ms)
+{
+    const winc_emu_config defaults = WINC_EMU_CONFIG_DEFAULT;
+
+    memset(&g_emu, 0, sizeof(g_emu));
+
+    g_emu.config = config ? *config : defaults;
+    g_emu.tick = tick;
+    g_emu.tick_ms = tick_ms;
+    g_emu.next_tick = tick_ms;
+    g_emu.utc_base = time(NULL);
+    g_emu.channel = g_emu.config.channel;
+}
+
+/** \brief Mark the end of a pass of the main loop - idle time after it may be skipped */
+void winc_emu_pass_done(void)
+{
+    g_emu.pass_done = true;
+}
+
+/** \brief Virtual milliseconds since winc_emu_init */
+uint64_t winc_emu_time_ms(void)
+{
+    return g_emu.now;
+}
+
+const winc_emu_stats* winc_emu_get_stats(void)
+{
+    return &g_emu.stats;
+}
+
+/** \brief The application's UTC clock follows virtual time */
+uint32_t host_time_utc(void)
+{
+    return (uint32_t)(g_emu.utc_base + g_emu.now / 1000);
+}
+
+/************************************************************************/
+/* BSP, COMMON AND PERIPHERAL API                                       */
+/************************************************************************/
+
+sint8 nm_bsp_init(void)
+{
+    return M2M_SUCCESS;
+}
+
+void m2m_memset(uint8* pBuf, uint8 val, uint32 sz)
+{
+    memset(pBuf, val, sz);
+}
+
+sint8 m2m_periph_pullup_ctrl(uint32 pinmask, uint8 enable)
+{
+    return M2M_SUCCESS;
+}
+
+/************************************************************************/
+/* WIFI API                                                             */
+/************************************************************************/
+
+sint8 m2m_wifi_init(tstrWifiInitParam* pWifiInitParam)
+{
+    if(!pWifiInitParam)
+    {
+        return M2M_ERR_FAIL;
+    }
+
+    g_emu.wifi_cb = pWifiInitParam->pfAppWifiCb;
+    g_emu.event_count = 0;
+    g_emu.associated = false;
+
+    if(g_emu.config.restart_ms)
+    {
+        winc_emu_post(WINC_EMU_EVENT_RESTART, 0, 0, g_emu.config.restart_ms);
+    }
+
+    return M2M_SUCCESS;
+}
+
+sint8 m2m_wifi_get_firmware_version(tstrM2mRev* pstrRev)
+{
+    memset(pstrRev, 0, sizeof(*pstrRev));
+    pstrRev->u32Chipid = WINC_EMU_CHIP_ID;
+    pstrRev->u8FirmwareMajor = M2M_RELEASE_VERSION_MAJOR_NO;
+    pstrRev->u8FirmwareMinor = M2M_RELEASE_VERSION_MINOR_NO;
+    pstrRev->u8FirmwarePatch = M2M_RELEASE_VERSION_PATCH_NO;
+    pstrRev->u8DriverMajor = M2M_RELEASE_VERSION_MAJOR_NO;
+    pstrRev->u8DriverMinor = M2M_RELEASE_VERSION_MINOR_NO;
+    pstrRev->u8DriverPatch = M2M_RELEASE_VERSION_PATCH_NO;
+
+    return M2M_SUCCESS;
+}
+
+/** \brief Join the access point - any SSID and credentials are accepted, on its channel or with a scan */
+sint8 m2m_wifi_connect(char* pcSsid, uint8 u8SsidLen, uint8 u8SecType, void* pvAuthInfo, uint16 u16Ch)
+{
+    winc_emu_event* event;
+    uint32_t join_ms = g_emu.config.channel_join_ms;
+
+    if(!g_emu.wifi_cb || !pcSsid || !u8SsidLen || u8SsidLen >= M2M_MAX_SSID_LEN ||
+        (u16Ch > M2M_WIFI_CH_14 && u16Ch != M2M_WIFI_CH_ALL))
+    {
+        return M2M_ERR_FAIL;
+    }
+
+    g_emu.stats.joins++;
+    if(g_emu.associated)
+    {
+        g_emu.stats.joined_joins++;
+    }
+    if(u16Ch == M2M_WIFI_CH_ALL)
+    {
+        g_emu.stats.join_scans++;
+        join_ms = g_emu.config.join_ms;
+    }
+    g_emu.stats.join_ms += join_ms;
+
+    if(u16Ch != M2M_WIFI_CH_ALL && u16Ch != g_emu.channel)
+    {
+        /* Nothing answers on that channel */
+        if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_RESP_CON_STATE_CHANGED, 0, join_ms)))
+        {
+            event->u.state.u8CurrState = M2M_WIFI_DISCONNECTED;
+            event->u.state.u8ErrCode = M2M_ERR_SCAN_FAIL;
+        }
+        return M2M_SUCCESS;
+    }
+
+    memset(g_emu.ssid, 0, sizeof(g_emu.ssid));
+    memcpy(g_emu.ssid, pcSsid, u8SsidLen);
+    g_emu.associated = true;
+
+    if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_RESP_CON_STATE_CHANGED, 0, join_ms)))
+    {
+        event->u.state.u8CurrState = M2M_WIFI_CONNECTED;
+    }
+
+    if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_REQ_DHCP_CONF, 0,
+        join_ms + g_emu.config.dhcp_ms)))
+    {
+        event->u.ip.u32StaticIP = WINC_EMU_IP_ADDRESS;
+    }
+
+    return M2M_SUCCESS;
+}
+
+/** \brief Answer with the access point joined - its BSSID is the peer MAC address */
+sint8 m2m_wifi_get_connection_info(void)
+{
+    winc_emu_event* event;
+    uint32 ip = WINC_EMU_IP_ADDRESS;
+
+    if(!g_emu.associated ||
+        NULL == (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_RESP_CONN_INFO, 0, 0)))
+    {
+        return M2M_ERR_FAIL;
+    }
+
+    memcpy(event->u.conn_info.acSSID, g_emu.ssid, sizeof(event->u.conn_info.acSSID));
+    event->u.conn_info.u8SecType = M2M_WIFI_SEC_WPA_PSK;
+    memcpy(event->u.conn_info.au8IPAddr, &ip, sizeof(event->u.conn_info.au8IPAddr));
+    memcpy(event->u.conn_info.au8MACAddress, g_winc_emu_bssid[0], M2M_MAC_ADDRES_LEN);
+    event->u.conn_info.s8RSSI = -45;
+
+    return M2M_SUCCESS;
+}
+
+/** \brief Scan - takes as long as a join that scans every channel */
+sint8 m2m_wifi_request_scan(uint8 ch)
+{
+    winc_emu_event* event;
+
+    if(NULL == (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_RESP_SCAN_DONE, 0, g_emu.config.join_ms)))
+    {
+        return M2M_ERR_FAIL;
+    }
+
+    g_emu.stats.scans++;
+    event->u.scan_done.u8NumofCh = WINC_EMU_SCAN_APS;
+    event->u.scan_done.s8ScanState = M2M_SUCCESS;
+
+    return M2M_SUCCESS;
+}
+
+/** \brief Answer with a scan result - the neighbour comes first, on a channel away from the access point */
+sint8 m2m_wifi_req_scan_result(uint8 index)
+{
+    winc_emu_event* event;
+    tstrM2mWifiscanResult* result;
+
+    if(index >= WINC_EMU_SCAN_APS ||
+        NULL == (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_RESP_SCAN_RESULT, 0, 0)))
+    {
+        return M2M_ERR_FAIL;
+    }
+
+    result = &event->u.scan_result;
+    result->u8index = index;
+    result->u8AuthType = M2M_WIFI_SEC_WPA_PSK;
+    if(index == 0)
+    {
+        result->s8rssi = -70;
+        result->u8ch = (g_emu.channel > M2M_WIFI_CH_6) ? M2M_WIFI_CH_1 : M2M_WIFI_CH_11;
+        memcpy(result->au8BSSID, g_winc_emu_bssid[1], M2M_MAC_ADDRES_LEN);
+        strcpy((char*)result->au8SSID, "neighbour");
+    }
+    else
+    {
+        result->s8rssi = -45;
+        result->u8ch = g_emu.channel;
+        memcpy(result->au8BSSID, g_winc_emu_bssid[0], M2M_MAC_ADDRES_LEN);
+        memcpy(result->au8SSID, g_emu.ssid, sizeof(g_emu.ssid));
+    }
+
+    return M2M_SUCCESS;
+}
+
+sint8 m2m_wifi_enable_sntp(uint8 bEnable)
+{
+    return M2M_SUCCESS;
+}
+
+/** \brief Answer with the virtual UTC time */
+sint8 m2m_wifi_get_sytem_time(void)
+{
+    winc_emu_event* event;
+    time_t now = (time_t)host_time_utc() + g_emu.config.sntp_ms / 1000;
+    struct tm utc;
+
+    if(!gmtime_r(&now, &utc) ||
+        NULL == (event = winc_emu_post(WINC_EMU_EVENT_WIFI, M2M_WIFI_RESP_GET_SYS_TIME, 0, g_emu.config.sntp_ms)))
+    {
+        return M2M_ERR_FAIL;
+    }
+
+    event->u.time.u16Year = utc.tm_year + 1900;
+    event->u.time.u8Month = utc.tm_mon + 1;
+    event->u.time.u8Day = utc.tm_mday;
+    event->u.time.u8Hour = utc.tm_hour;
+    event->u.time.u8Minute = utc.tm_min;
+    event->u.time.u8Second = utc.tm_sec;
+
+    return M2M_SUCCESS;
+}
+
+/** \brief Deliver the callbacks that are due and let virtual time move on */
+sint8 m2m_wifi_handle_events(void* arg)
+{
+    winc_emu_poll(0);
+
+    if(!winc_emu_deliver())
+    {
+        winc_emu_idle();
+    }
+    else
+    {
+        g_emu.idle_polls = 0;
+    }
+
+    return M2M_SUCCESS;
+}
+
+/************************************************************************/
+/* SSL API - TLS is not emulated                                        */
+/************************************************************************/
+
+sint8 m2m_ssl_init(tpfAppSSLCb pfAppSSLCb)
+{
+    return M2M_SUCCESS;
+}
+
+sint8 m2m_ssl_set_active_ciphersuites(uint32 u32SslCsBMP)
+{
+    return M2M_SUCCESS;
+}
+
+/************************************************************************/
+/* SOCKET API                                                           */
+/************************************************************************/
+
+void socketInit(void)
+{
+    SOCKET sock;
+
+    for(sock = 0; sock < TCP_SOCK_MAX; sock++)
+    {
+        if(g_emu.sockets[sock].used)
+        {
+            close(sock);
+        }
+    }
+}
+
+void registerSocketCallback(tpfAppSocketCb socket_cb, tpfAppResolveCb resolve_cb)
+{
+    g_emu.socket_cb = socket_cb;
+    g_emu.resolve_cb = resolve_cb;
+}
+
+/** \brief Resolve with the host resolver - completed by the resolve callback */
+sint8 gethostbyname(uint8* pcHostName)
+{
+    winc_emu_event* event;
+
+    if(!pcHostName || strlen((char*)pcHostName) >= HOSTNAME_MAX_SIZE)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+
+    if(NULL == (event = winc_emu_post(WINC_EMU_EVENT_RESOLVE, 0, 0, g_emu.config.dns_ms)))
+    {
+        return SOCK_ERR_BUFFER_FULL;
+    }
+
+    strcpy(event->name, (char*)pcHostName);
+    event->u.addr = winc_host_resolve(event->name);
+    g_emu.stats.resolves++;
+
+    return SOCK_ERR_NO_ERROR;
+}
+
+/** \brief A TCP socket - UDP is not emulated */
+SOCKET socket(uint16 u16Domain, uint8 u8Type, uint8 u8Flags)
+{
+    SOCKET sock;
+    int fd;
+
+    if(u16Domain != AF_INET || u8Type != SOCK_STREAM)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+
+    for(sock = 0; sock < TCP_SOCK_MAX; sock++)
+    {
+        if(!g_emu.sockets[sock].used)
+        {
+            if((fd = winc_host_socket()) < 0)
+            {
+                return SOCK_ERR_INVALID;
+            }
+            memset(&g_emu.sockets[sock], 0, sizeof(g_emu.sockets[sock]));
+            g_emu.sockets[sock].used = true;
+            g_emu.sockets[sock].fd = fd;
+            return sock;
+        }
+    }
+
+    return SOCK_ERR_MAX_TCP_SOCK;
+}
+
+sint8 setsockopt(SOCKET socket, uint8 u8Level, uint8 option_name, const void* option_value, uint16 u16OptionLen)
+{
+    return winc_emu_socket_get(socket) ? SOCK_ERR_NO_ERROR : SOCK_ERR_INVALID_ARG;
+}
+
+/** \brief Start connecting - completed by SOCKET_MSG_CONNECT */
+sint8 connect(SOCKET sock, struct sockaddr* pstrAddr, uint8 u8AddrLen)
+{
+    winc_emu_socket* s = winc_emu_socket_get(sock);
+    struct sockaddr_in* addr = (struct sockaddr_in*)pstrAddr;
+    winc_emu_event* event;
+
+    if(!s || !addr || u8AddrLen != sizeof(struct sockaddr_in) || s->connecting || s->connected)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+
+    if(winc_host_connect(s->fd, addr->sin_addr.s_addr, addr->sin_port) != 0)
+    {
+        /* Refused straight away - the firmware still answers with the callback */
+        if(NULL != (event = winc_emu_post(WINC_EMU_EVENT_SOCKET, SOCKET_MSG_CONNECT, sock, 0)))
+        {
+            event->u.connect.sock = sock;
+            event->u.connect.s8Error = SOCK_ERR_CONN_ABORTED;
+        }
+        return SOCK_ERR_NO_ERROR;
+    }
+
+    s->connecting = true;
+
+    return SOCK_ERR_NO_ERROR;
+}
+
+/** \brief Post a receive - completed by SOCKET_MSG_RECV, u32Timeoutmsec of 0 waits forever */
+sint16 recv(SOCKET sock, void* pvRecvBuf, uint16 u16BufLen, uint32 u32Timeoutmsec)
+{
+    winc_emu_socket* s = winc_emu_socket_get(sock);
+
+    if(!s || !pvRecvBuf || !u16BufLen || !s->connected || s->rx_posted)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+
+    s->rx_posted = true;
+    s->rx_buf = pvRecvBuf;
+    s->rx_len = u16BufLen;
+    s->rx_deadline = u32Timeoutmsec ? g_emu.now + u32Timeoutmsec : 0;
+
+    return SOCK_ERR_NO_ERROR;
+}
+
+/** \brief Queue a send - completed by SOCKET_MSG_SEND */
+sint16 send(SOCKET sock, void* pvSendBuffer, uint16 u16SendLength, uint16 u16Flags)
+{
+    winc_emu_socket* s = winc_emu_socket_get(sock);
+
+    if(!s || !pvSendBuffer || !u16SendLength || u16SendLength > SOCKET_BUFFER_MAX_LENGTH || !s->connected)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+
+    if(s->tx_count == WINC_EMU_TX_SENDS || s->tx_len + u16SendLength > WINC_EMU_TX_BUFFER)
+    {
+        return SOCK_ERR_BUFFER_FULL;
+    }
+
+    /* Taken in by the module - the caller's buffer is free on return */
+    memcpy(&s->tx_buf[s->tx_len], pvSendBuffer, u16SendLength);
+    s->tx_len += u16SendLength;
+    s->tx_sends[s->tx_count++] = u16SendLength;
+
+    winc_emu_flush(sock);
+
+    return SOCK_ERR_NO_ERROR;
+}
+
+/** \brief Close a socket - nothing more is delivered for it */
+sint8 close(SOCKET sock)
+{
+    winc_emu_socket* s = winc_emu_socket_get(sock);
+
+    if(!s)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+
+    winc_host_close(s->fd);
+    memset(s, 0, sizeof(*s));
+    winc_emu_purge(sock);
+
+    return SOCK_ERR_NO_ERROR;
+}
@@ -0,0 +1,77 @@
+/**
+ * \file
+ * \brief  WINC1500 emulator - the driver API on POSIX sockets under a virtual clock
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef WINC_EMU_H_
+#define WINC_EMU_H_
+
+#include <stdint.h>
+
+/** How long the emulated module takes over the steps that have no host equivalent */
+typedef struct _winc_emu_config {
+    uint32_t    join_ms;    /**< Virtual ms from m2m_wifi_connect to joining the access point, scanning every channel */
+    uint32_t    channel_join_ms;    /**< The same on a single channel - or to fail if the access point is not on it */
+    uint32_t    dhcp_ms;    /**< Virtual ms from joining to the DHCP lease */
+    uint32_t    dns_ms;     /**< Virtual ms a gethostbyname takes */
+    uint32_t    sntp_ms;    /**< Virtual ms m2m_wifi_get_sytem_time takes */
+    uint32_t    settle_ms;  /**< Real ms to wait for an answer to a send before skipping ahead */
+    uint32_t    channel;    /**< The access point's channel */
+    uint32_t    restart_ms; /**< Virtual ms between access point restarts, 0 for never - every other one changes channel */
+} winc_emu_config;
+
+#define WINC_EMU_CONFIG_DEFAULT { 1500, 200, 500, 20, 50, 50, 6, 0 }
+
+/** What the emulator has done so far */
+typedef struct _winc_emu_stats {
+    uint64_t    events;         /**< Callbacks delivered to the application */
+    uint32_t    joins;          /**< m2m_wifi_connect calls */
+    uint32_t    join_scans;     /**< Joins that scanned every channel */
+    uint32_t    joined_joins;   /**< Joins started while still joined - the application lost track of the module */
+    uint64_t    join_ms;        /**< Virtual time spent joining, or failing to */
+    uint32_t    scans;          /**< m2m_wifi_request_scan calls */
+    uint32_t    restarts;       /**< Access point restarts */
+    uint32_t    resolves;       /**< gethostbyname calls */
+    uint32_t    connects;
+    uint64_t    sends;
+    uint64_t    send_bytes;
+    uint64_t    recvs;          /**< Completed with data */
+    uint64_t    recv_bytes;
+    uint64_t    recv_timeouts;
+    uint64_t    ticks;          /**< Periodic timer interrupts delivered */
+    uint64_t    skipped_ms;     /**< Virtual time jumped over while nothing could happen */
+    uint64_t    waited_ms;      /**< Real time spent waiting on the far end */
+} winc_emu_stats;
+
+void winc_emu_init(const winc_emu_config* config, void (*tick)(void), uint32_t tick_ms);
+void winc_emu_pass_done(void);
+uint64_t winc_emu_time_ms(void);
+const winc_emu_stats* winc_emu_get_stats(void);
+
+#endif /* WINC_EMU_H_ */
@@ -0,0 +1,214 @@
+/**
+ * \file
+ * \brief  POSIX sockets and clocks behind the WINC1500 emulator
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "winc_host.h"
+
+/** \brief A non-blocking IPv4 TCP socket - the only kind the application asks the WINC for */
+int winc_host_socket(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    /* The WINC sends each buffer as it is handed over */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return fd;
+}
+
+/** \brief Start connecting - addr and port are in network byte order */
+int winc_host_connect(int fd, uint32_t addr, uint16_t port)
+{
+    struct sockaddr_in sin;
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = addr;
+    sin.sin_port = port;
+
+    if(connect(fd, (struct sockaddr*)&sin, sizeof(sin)) != 0 && errno != EINPROGRESS)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/** \brief 1 once a connect has succeeded, 0 while it is in progress, -1 if it failed */
+int winc_host_connect_result(int fd)
+{
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    socklen_t len = sizeof(int);
+    int error = 0;
+
+    if(poll(&pfd, 1, 0) == 0)
+    {
+        return 0;
+    }
+
+    if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0)
+    {
+        return -1;
+    }
+
+    return 1;
+}
+
+/** \brief Bytes received, 0 once the peer has closed, WINC_HOST_AGAIN or -1 */
+int winc_host_recv(int fd, void* buf, uint32_t len)
+{
+    ssize_t rc;
+
+    do
+    {
+        rc = recv(fd, buf, len, 0);
+    } while(rc < 0 && errno == EINTR);
+
+    if(rc < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? WINC_HOST_AGAIN : -1;
+    }
+
+    return (int)rc;
+}
+
+/** \brief Bytes sent, WINC_HOST_AGAIN or -1 */
+int winc_host_send(int fd, const void* buf, uint32_t len)
+{
+    ssize_t rc;
+
+    do
+    {
+        rc = send(fd, buf, len, MSG_NOSIGNAL);
+    } while(rc < 0 && errno == EINTR);
+
+    if(rc < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? WINC_HOST_AGAIN : -1;
+    }
+
+    return (int)rc;
+}
+
+void winc_host_close(int fd)
+{
+    close(fd);
+}
+
+/** \brief The first IPv4 address of a host in network byte order, 0 if there is none */
+uint32_t winc_host_resolve(const char* name)
+{
+    struct addrinfo hints;
+    struct addrinfo* result = NULL;
+    uint32_t addr = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if(getaddrinfo(name, NULL, &hints, &result) == 0 && result)
+    {
+        addr = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+    }
+
+    if(result)
+    {
+        freeaddrinfo(result);
+    }
+
+    return addr;
+}
+
+/**
+ * \brief Wait up to timeout_ms of real time for any of the sockets to become ready
+ *
+ * \param fds[in]           The sockets
+ * \param want[in]          WINC_HOST_READABLE and WINC_HOST_WRITABLE for each socket
+ * \param ready[out]        What each socket is ready for
+ * \param count[in]         The number of sockets
+ * \param timeout_ms[in]    Real milliseconds to wait, 0 to check without waiting
+ *
+ * \return The number of sockets that are ready, or -1
+ */
+int winc_host_wait(const int* fds, const uint8_t* want, uint8_t* ready, int count, int timeout_ms)
+{
+    struct pollfd pfd[count > 0 ? count : 1];
+    int rc;
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        pfd[i].fd = fds[i];
+        pfd[i].events = ((want[i] & WINC_HOST_READABLE) ? POLLIN : 0) |
+            ((want[i] & WINC_HOST_WRITABLE) ? POLLOUT : 0);
+        pfd[i].revents = 0;
+    }
+
+    do
+    {
+        rc = poll(pfd, count, timeout_ms);
+    } while(rc < 0 && errno == EINTR);
+
+    for(i = 0; i < count; i++)
+    {
+        /* Errors and hang ups are picked up by the recv or send they wake */
+        ready[i] = ((pfd[i].revents & (POLLIN | POLLERR | POLLHUP)) ? WINC_HOST_READABLE : 0) |
+            ((pfd[i].revents & (POLLOUT | POLLERR | POLLHUP)) ? WINC_HOST_WRITABLE : 0);
+    }
+
+    return rc;
+}
+
+/** \brief Monotonic wall clock milliseconds - only used to pace the virtual clock */
+uint64_t winc_host_real_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
@@ -0,0 +1,57 @@
+/**
+ * \file
+ * \brief  POSIX sockets and clocks behind the WINC1500 emulator
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef WINC_HOST_H_
+#define WINC_HOST_H_
+
+#include <stdint.h>
+
+/* Kept apart from winc_emu.c - the WINC socket.h and the host's <sys/socket.h> declare the same
+ * names differently, so no file can include both */
+
+/** Returned when the socket call would have to wait */
+#define WINC_HOST_AGAIN     (-2)
+
+/** What winc_host_wait reports for each socket */
+#define WINC_HOST_READABLE  (0x01)
+#define WINC_HOST_WRITABLE  (0x02)
+
+int winc_host_socket(void);
+int winc_host_connect(int fd, uint32_t addr, uint16_t port);
+int winc_host_connect_result(int fd);
+int winc_host_recv(int fd, void* buf, uint32_t len);
+int winc_host_send(int fd, const void* buf, uint32_t len);
+void winc_host_close(int fd);
+uint32_t winc_host_resolve(const char* name);
+int winc_host_wait(const int* fds, const uint8_t* want, uint8_t* ready, int count, int timeout_ms);
+uint64_t winc_host_real_ms(void);
+
+#endif /* WINC_HOST_H_ */
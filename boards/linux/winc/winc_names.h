@@ -0,0 +1,52 @@
+/**
+ * \file
+ * \brief  Keeps the WINC1500 socket API off the C library's names
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef WINC_NAMES_H_
+#define WINC_NAMES_H_
+
+/* The WINC socket.h declares socket(), connect(), recv(), send(), close() and friends with its own
+ * signatures. Linked into a host program under those names they would replace the C library's,
+ * so every file built against socket.h is compiled with this header forced in first. */
+#define socket          winc_socket
+#define bind            winc_bind
+#define listen          winc_listen
+#define accept          winc_accept
+#define connect         winc_connect
+#define recv            winc_recv
+#define recvfrom        winc_recvfrom
+#define send            winc_send
+#define sendto          winc_sendto
+#define close           winc_close
+#define gethostbyname   winc_gethostbyname
+#define setsockopt      winc_setsockopt
+#define getsockopt      winc_getsockopt
+
+#endif /* WINC_NAMES_H_ */
@@ -0,0 +1,155 @@
+/**
+ * \file
+ * \brief  A WINC1500 SPI bus that checks the transfers it is given and models their time
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "winc_bus_mock.h"
+
+/* Clock bytes through the slave */
+static void winc_bus_mock_clock(winc_bus_mock *mock, const uint8_t *mosi, uint8_t *miso, uint16_t len)
+{
+    uint16_t i;
+
+    if (!mock->selected)
+    {
+        mock->errors++;
+        return;
+    }
+
+    for (i = 0; i < len; i++, mock->position++)
+    {
+        if (mock->position < WINC_BUS_MOCK_LOG_SIZE)
+        {
+            mock->sent[mock->position] = mosi ? mosi[i] : 0;
+        }
+        if (miso)
+        {
+            miso[i] = winc_bus_mock_byte(mock->position);
+        }
+    }
+}
+
+/* Keep the kind and length of a call */
+static void winc_bus_mock_log_call(winc_bus_mock *mock, bool dma, uint16_t len)
+{
+    if (mock->call_count < WINC_BUS_MOCK_LOG_CALLS)
+    {
+        mock->calls[mock->call_count].dma = dma;
+        mock->calls[mock->call_count].len = len;
+    }
+    mock->call_count++;
+}
+
+static void winc_bus_mock_select(void *ctx, bool enable)
+{
+    winc_bus_mock *mock = ctx;
+
+    if (enable == mock->selected)
+    {
+        mock->errors++;
+    }
+
+    mock->selected = enable;
+    if (enable)
+    {
+        mock->position = 0;
+        mock->call_count = 0;
+        mock->selects++;
+    }
+}
+
+static void winc_bus_mock_pio(void *ctx, const uint8_t *mosi, uint8_t *miso, uint16_t len)
+{
+    winc_bus_mock *mock = ctx;
+
+    winc_bus_mock_log_call(mock, false, len);
+    mock->pio_calls++;
+    mock->pio_bytes += len;
+    mock->cycles += (uint64_t)len * (mock->model->wire_cycles + mock->model->pio_cycles);
+
+    winc_bus_mock_clock(mock, mosi, miso, len);
+}
+
+static int winc_bus_mock_dma(void *ctx, const uint8_t *mosi, uint8_t *miso, uint16_t len)
+{
+    winc_bus_mock *mock = ctx;
+    const winc_bus_ops *ops = &mock->ops;
+
+    if (len == 0 || len < ops->dma_min || len > ops->dma_max)
+    {
+        mock->errors++;
+    }
+
+    winc_bus_mock_log_call(mock, true, len);
+    mock->dma_calls++;
+
+    if (mock->dma_fails)
+    {
+        /* The controller gave up before clocking anything */
+        return -1;
+    }
+
+    mock->dma_bytes += len;
+    mock->cycles += mock->model->dma_cycles + (uint64_t)len * mock->model->wire_cycles;
+
+    winc_bus_mock_clock(mock, mosi, miso, len);
+
+    return 0;
+}
+
+/**
+ * \brief Set up a mock bus - dma_min of 0 clocks everything with the CPU, and a
+ *        dma_max of 0xFFFF never splits a transfer.
+ */
+void winc_bus_mock_init(winc_bus_mock *mock, const winc_bus_mock_model *model,
+    uint16_t dma_min, uint16_t dma_max)
+{
+    memset(mock, 0, sizeof(*mock));
+
+    mock->model = model;
+    mock->ops.ctx = mock;
+    mock->ops.select = winc_bus_mock_select;
+    mock->ops.pio = winc_bus_mock_pio;
+    mock->ops.dma = winc_bus_mock_dma;
+    mock->ops.dma_min = dma_min;
+    mock->ops.dma_max = dma_max;
+}
+
+void winc_bus_mock_reset_stats(winc_bus_mock *mock)
+{
+    mock->selects = 0;
+    mock->pio_calls = 0;
+    mock->pio_bytes = 0;
+    mock->dma_calls = 0;
+    mock->dma_bytes = 0;
+    mock->cycles = 0;
+    mock->errors = 0;
+}
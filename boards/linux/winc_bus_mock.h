@@ -0,0 +1,95 @@
+/**
+ * \file
+ * \brief  A WINC1500 SPI bus that checks the transfers it is given and models their time
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef WINC_BUS_MOCK_H_
+#define WINC_BUS_MOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "winc_bus.h"
+
+/** Longest transfer the mock keeps the sent bytes of */
+#define WINC_BUS_MOCK_LOG_SIZE  (8192)
+
+/** Most pio and dma calls in one transfer the mock keeps the lengths of */
+#define WINC_BUS_MOCK_LOG_CALLS (256)
+
+/** One pio or dma call */
+typedef struct _winc_bus_mock_call {
+    bool        dma;
+    uint16_t    len;
+} winc_bus_mock_call;
+
+/** What a board's bus costs, in CPU cycles */
+typedef struct _winc_bus_mock_model {
+    const char  *name;
+    uint32_t    wire_cycles;    /**< One byte on the wire */
+    uint32_t    pio_cycles;     /**< CPU overhead per byte clocked by the CPU, on top of the wire */
+    uint32_t    dma_cycles;     /**< Setting up and finishing one DMA transfer */
+    uint32_t    cpu_mhz;
+} winc_bus_mock_model;
+
+/**
+ * Stands in for a bus wrapper's select, pio and dma. The slave side answers the
+ * n-th byte after the chip select with winc_bus_mock_byte(n) and keeps what it
+ * was sent, so the caller can check both directions. Anything a wrapper would get
+ * wrong on the hardware - a byte clocked without the chip select, a DMA transfer
+ * outside the limits - is counted as an error.
+ */
+typedef struct _winc_bus_mock {
+    winc_bus_ops                ops;
+    const winc_bus_mock_model   *model;
+    bool        selected;
+    uint32_t    position;       /**< Bytes since the chip select */
+    uint8_t     sent[WINC_BUS_MOCK_LOG_SIZE];
+    winc_bus_mock_call  calls[WINC_BUS_MOCK_LOG_CALLS];
+    uint32_t    call_count;     /**< pio and dma calls since the chip select */
+    uint64_t    selects;
+    uint64_t    pio_calls;
+    uint64_t    pio_bytes;
+    uint64_t    dma_calls;
+    uint64_t    dma_bytes;
+    uint64_t    cycles;         /**< Modelled bus time */
+    uint64_t    errors;
+    bool        dma_fails;      /**< Set to have every dma call report a failure */
+} winc_bus_mock;
+
+void winc_bus_mock_init(winc_bus_mock *mock, const winc_bus_mock_model *model,
+    uint16_t dma_min, uint16_t dma_max);
+void winc_bus_mock_reset_stats(winc_bus_mock *mock);
+
+/** The byte the slave answers with at a position after the chip select */
+static inline uint8_t winc_bus_mock_byte(uint32_t position)
+{
+    return (uint8_t)(position * 7 + 3);
+}
+
+#endif /* WINC_BUS_MOCK_H_ */
@@ -45,6 +45,7 @@
 #include "bus_wrapper/include/nm_bus_wrapper.h"
 #include "asf.h"
 #include "conf_winc.h"
+#include "winc_bus.h"
 
 #define NM_BUS_MAX_TRX_SZ 4096
 
@@ -91,35 +92,105 @@ Pio *p_pio_cs;
 /** Pointer to PDC SPI data structure. */
 static Pdc *g_p_pdc_spi;
 
-static sint8 spi_rw(uint8 *pu8Mosi, uint8 *pu8Miso, uint16 u16Sz)
-{
-	pdc_packet_t pdc_spi_tx_packet, pdc_spi_rx_packet;
+/** Transfers shorter than this are clocked by the CPU - the PDC costs more to set up. */
+#define NM_BUS_PDC_MIN_SZ		8
 
-	if(((pu8Miso == NULL)&& (pu8Mosi == NULL)) ||(u16Sz == 0)) {
-		return M2M_ERR_INVALID_ARG;
+/** Polls of the SPI status allowed per byte before a transfer is given up - a byte at CONF_WINC_SPI_CLOCK takes a few. */
+#define NM_BUS_PDC_WAIT_PER_BYTE	64
+
+static void spi_select(void *ctx, bool enable)
+{
+	if (enable) {
+		SPI_ASSERT_CS();
+	} else {
+		SPI_DEASSERT_CS();
 	}
-	pdc_spi_tx_packet.ul_addr = (uint32_t)pu8Mosi;;
-	pdc_spi_rx_packet.ul_addr = (uint32_t)pu8Miso;
-	pdc_spi_tx_packet.ul_size = u16Sz;
-	pdc_spi_rx_packet.ul_size = u16Sz;
+}
+
+/* Clock a short transfer a byte at a time */
+static void spi_pio_rw(void *ctx, const uint8 *pu8Mosi, uint8 *pu8Miso, uint16 u16Sz)
+{
+	uint8 u8Rx;
+
+	while (u16Sz--) {
+		while ((CONF_WINC_SPI->SPI_SR & SPI_SR_TDRE) == 0)
+			;
+		CONF_WINC_SPI->SPI_TDR = pu8Mosi ? *pu8Mosi++ : 0;
 
-	if (pu8Miso == 0) {
-		pdc_spi_rx_packet.ul_addr = (uint32_t)0x400000;
+		while ((CONF_WINC_SPI->SPI_SR & SPI_SR_RDRF) == 0)
+			;
+		u8Rx = (uint8)CONF_WINC_SPI->SPI_RDR;
+		if (pu8Miso) {
+			*pu8Miso++ = u8Rx;
+		}
 	}
+}
 
+/*
+ * Clock a transfer with the PDC in one go. The PDC always increments, so with nothing
+ * to send it sends the flash from its start - the WINC ignores what it is sent while it
+ * answers - and with nothing to keep only the transmit side runs.
+ */
+static int spi_pdc_rw(void *ctx, const uint8 *pu8Mosi, uint8 *pu8Miso, uint16 u16Sz)
+{
+	pdc_packet_t pdc_spi_tx_packet, pdc_spi_rx_packet;
+	uint32 u32Wait = ((uint32)u16Sz + 1) * NM_BUS_PDC_WAIT_PER_BYTE;
+	uint32 u32Done;
+	int ret = M2M_SUCCESS;
 
+	pdc_spi_tx_packet.ul_addr = pu8Mosi ? (uint32_t)pu8Mosi : (uint32_t)IFLASH_ADDR;
+	pdc_spi_tx_packet.ul_size = u16Sz;
 	pdc_tx_init(g_p_pdc_spi, &pdc_spi_tx_packet, NULL);
-	pdc_rx_init(g_p_pdc_spi, &pdc_spi_rx_packet, NULL);
-	/* Trigger SPI PDC transfer. */
-	SPI_ASSERT_CS();
-	g_p_pdc_spi->PERIPH_PTCR = PERIPH_PTCR_RXTEN | PERIPH_PTCR_TXTEN;
-	while ((CONF_WINC_SPI->SPI_SR & SPI_SR_RXBUFF) == 0)
-		;
-	SPI_DEASSERT_CS();
+
+	if (pu8Miso) {
+		pdc_spi_rx_packet.ul_addr = (uint32_t)pu8Miso;
+		pdc_spi_rx_packet.ul_size = u16Sz;
+		pdc_rx_init(g_p_pdc_spi, &pdc_spi_rx_packet, NULL);
+		u32Done = SPI_SR_RXBUFF;
+		/* Trigger SPI PDC transfer. */
+		g_p_pdc_spi->PERIPH_PTCR = PERIPH_PTCR_RXTEN | PERIPH_PTCR_TXTEN;
+	} else {
+		/* Over once the PDC has handed over the last byte and the SPI has shifted it out */
+		u32Done = SPI_SR_TXBUFE | SPI_SR_TXEMPTY;
+		g_p_pdc_spi->PERIPH_PTCR = PERIPH_PTCR_TXTEN;
+	}
+
+	while ((CONF_WINC_SPI->SPI_SR & u32Done) != u32Done) {
+		if (--u32Wait == 0) {
+			ret = M2M_ERR_BUS_FAIL;
+			break;
+		}
+	}
 
 	g_p_pdc_spi->PERIPH_PTCR = PERIPH_PTCR_TXTDIS | PERIPH_PTCR_RXTDIS;
 
-	return M2M_SUCCESS;
+	if (!pu8Miso || ret != M2M_SUCCESS) {
+		/* Drop the bytes nobody read, and the overrun they caused, for the next transfer */
+		(void)CONF_WINC_SPI->SPI_RDR;
+		(void)CONF_WINC_SPI->SPI_SR;
+	}
+
+	return ret;
+}
+
+static const winc_bus_ops spi_bus = {
+	.select = spi_select,
+	.pio = spi_pio_rw,
+	.dma = spi_pdc_rw,
+	.dma_min = NM_BUS_PDC_MIN_SZ,
+	.dma_max = 0xFFFF,
+};
+
+static sint8 spi_rw(uint8 *pu8Mosi, uint8 *pu8Miso, uint16 u16Sz)
+{
+	switch (winc_bus_transfer(&spi_bus, pu8Mosi, pu8Miso, u16Sz)) {
+	case 0:
+		return M2M_SUCCESS;
+	case WINC_BUS_ERR_DMA:
+		return M2M_ERR_BUS_FAIL;
+	default:
+		return M2M_ERR_INVALID_ARG;
+	}
 }
 #endif
 
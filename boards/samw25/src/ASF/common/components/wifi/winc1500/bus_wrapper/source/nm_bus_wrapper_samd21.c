@@ -45,6 +45,7 @@
 #include "bus_wrapper/include/nm_bus_wrapper.h"
 #include "asf.h"
 #include "conf_winc.h"
+#include "winc_bus.h"
 
 #define NM_BUS_MAX_TRX_SZ	256
 
@@ -118,17 +119,24 @@ static sint8 nm_i2c_write_special(uint8 *wb1, uint16 sz1, uint8 *wb2, uint16 sz2
 struct spi_module master;
 struct spi_slave_inst slave_inst;
 
-static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
+static void spi_select(void *ctx, bool enable)
+{
+	if (!enable) {
+		while (!spi_is_write_complete(&master))
+			;
+	}
+
+	spi_select_slave(&master, &slave_inst, enable);
+}
+
+/* Clock a transfer a byte at a time - for the short ones the DMAC costs more to set up */
+static void spi_pio_rw(void *ctx, const uint8 *pu8Mosi, uint8 *pu8Miso, uint16 u16Sz)
 {
 	uint8 u8Dummy = 0;
 	uint8 u8SkipMosi = 0, u8SkipMiso = 0;
 	uint16_t txd_data = 0;
 	uint16_t rxd_data = 0;
 
-	if(((pu8Miso == NULL) && (pu8Mosi == NULL)) ||(u16Sz == 0)) {
-		return M2M_ERR_INVALID_ARG;
-	}
-
 	if (pu8Mosi == NULL) {
 		pu8Mosi = &u8Dummy;
 		u8SkipMosi = 1;
@@ -138,8 +146,6 @@ static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
 		u8SkipMiso = 1;
 	}
 
-	spi_select_slave(&master, &slave_inst, true);
-
 	while (u16Sz) {
 		txd_data = *pu8Mosi;
 		while (!spi_is_ready_to_write(&master))
@@ -160,13 +166,137 @@ static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
 		if (!u8SkipMosi)
 			pu8Mosi++;
 	}
+}
+
+#ifdef CONF_WINC_SPI_DMAC_ID_TX
+/** Transfers shorter than this are clocked by the CPU. */
+#define NM_BUS_DMA_MIN_SZ	8
+
+/** DMAC channels - the descriptor sections only cover these, so nothing else can use the DMAC. */
+#define NM_BUS_DMA_CH_TX	0
+#define NM_BUS_DMA_CH_RX	1
+#define NM_BUS_DMA_CHANNELS	2
+
+/** Polls of the DMAC allowed per byte before a transfer is given up - a byte at CONF_WINC_SPI_CLOCK takes a few. */
+#define NM_BUS_DMA_WAIT_PER_BYTE	64
+
+COMPILER_ALIGNED(16) static DmacDescriptor dma_descriptor[NM_BUS_DMA_CHANNELS];
+COMPILER_ALIGNED(16) static DmacDescriptor dma_writeback[NM_BUS_DMA_CHANNELS];
+
+/** Sent with the address held when there is nothing to send, or received into when the data is not wanted. */
+static uint8 u8DmaDummy;
+
+/*
+ * The wrapper owns the DMAC: it resets it and points BASEADDR and WRBADDR at the two
+ * channel descriptors above, so any other user of the DMAC would lose its channels.
+ * conf_winc.h leaves the triggers undefined until this has been run on the hardware.
+ */
+static void spi_dma_init(void)
+{
+	uint8 ch;
+
+	PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+	PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
 
-	while (!spi_is_write_complete(&master))
+	DMAC->CTRL.reg &= ~DMAC_CTRL_DMAENABLE;
+	DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+	while (DMAC->CTRL.reg & DMAC_CTRL_SWRST)
 		;
 
-	spi_select_slave(&master, &slave_inst, false);
+	DMAC->BASEADDR.reg = (uint32_t)dma_descriptor;
+	DMAC->WRBADDR.reg = (uint32_t)dma_writeback;
+	DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN0;
 
-	return M2M_SUCCESS;
+	/* Each channel moves one byte per SERCOM request */
+	for (ch = 0; ch < NM_BUS_DMA_CHANNELS; ch++) {
+		DMAC->CHID.reg = DMAC_CHID_ID(ch);
+		DMAC->CHCTRLA.reg = 0;
+		DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+		while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST)
+			;
+		DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGACT_BEAT |
+			DMAC_CHCTRLB_TRIGSRC((ch == NM_BUS_DMA_CH_TX) ? CONF_WINC_SPI_DMAC_ID_TX : CONF_WINC_SPI_DMAC_ID_RX);
+	}
+}
+
+/* Clock a transfer with the DMAC - a missing buffer is replaced by the dummy byte, its address held */
+static int spi_dma_rw(void *ctx, const uint8 *pu8Mosi, uint8 *pu8Miso, uint16 u16Sz)
+{
+	SercomSpi *const spi_hw = &(master.hw->SPI);
+	DmacDescriptor *tx = &dma_descriptor[NM_BUS_DMA_CH_TX];
+	DmacDescriptor *rx = &dma_descriptor[NM_BUS_DMA_CH_RX];
+	uint32 u32Wait = ((uint32)u16Sz + 1) * NM_BUS_DMA_WAIT_PER_BYTE;
+	uint16_t rxd_data;
+	uint8 u8Flags;
+	int ret = M2M_SUCCESS;
+
+	u8DmaDummy = 0;
+
+	/* An incrementing address is given as the end of the block */
+	tx->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | (pu8Mosi ? DMAC_BTCTRL_SRCINC : 0);
+	tx->BTCNT.reg = u16Sz;
+	tx->SRCADDR.reg = pu8Mosi ? (uint32_t)(pu8Mosi + u16Sz) : (uint32_t)&u8DmaDummy;
+	tx->DSTADDR.reg = (uint32_t)&spi_hw->DATA.reg;
+	tx->DESCADDR.reg = 0;
+
+	rx->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | (pu8Miso ? DMAC_BTCTRL_DSTINC : 0);
+	rx->BTCNT.reg = u16Sz;
+	rx->SRCADDR.reg = (uint32_t)&spi_hw->DATA.reg;
+	rx->DSTADDR.reg = pu8Miso ? (uint32_t)(pu8Miso + u16Sz) : (uint32_t)&u8DmaDummy;
+	rx->DESCADDR.reg = 0;
+
+	/* Receive first so the first byte in is not missed */
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_CH_RX);
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_CH_TX);
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+
+	/* The transfer is over once the last byte is in */
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_CH_RX);
+	do {
+		u8Flags = DMAC->CHINTFLAG.reg & (DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR);
+	} while (!u8Flags && --u32Wait);
+
+	if (u8Flags != DMAC_CHINTFLAG_TCMPL) {
+		/* Bus error or stuck - stop both channels where they are and drop what the SERCOM still holds */
+		DMAC->CHCTRLA.reg = 0;
+		DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_CH_TX);
+		DMAC->CHCTRLA.reg = 0;
+		while (spi_is_ready_to_read(&master)) {
+			spi_read(&master, &rxd_data);
+		}
+		ret = M2M_ERR_BUS_FAIL;
+	}
+
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_CH_RX);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR;
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_CH_TX);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR;
+
+	return ret;
+}
+#endif /* CONF_WINC_SPI_DMAC_ID_TX */
+
+static const winc_bus_ops spi_bus = {
+	.select = spi_select,
+	.pio = spi_pio_rw,
+#ifdef CONF_WINC_SPI_DMAC_ID_TX
+	.dma = spi_dma_rw,
+	.dma_min = NM_BUS_DMA_MIN_SZ,
+	.dma_max = 0xFFFF,
+#endif
+};
+
+static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
+{
+	switch (winc_bus_transfer(&spi_bus, pu8Mosi, pu8Miso, u16Sz)) {
+	case 0:
+		return M2M_SUCCESS;
+	case WINC_BUS_ERR_DMA:
+		return M2M_ERR_BUS_FAIL;
+	default:
+		return M2M_ERR_INVALID_ARG;
+	}
 }
 #endif
 
@@ -220,6 +350,10 @@ sint8 nm_bus_init(void *pvinit)
 	/* Enable the SPI master. */
 	spi_enable(&master);
 
+#ifdef CONF_WINC_SPI_DMAC_ID_TX
+	spi_dma_init();
+#endif
+
 	nm_bsp_reset();
 	nm_bsp_sleep(1);
 #endif
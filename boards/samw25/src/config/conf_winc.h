@@ -94,6 +94,15 @@ extern "C" {
 /** SPI clock. */
 #define CONF_WINC_SPI_CLOCK				(12000000)
 
+/**
+ * DMAC triggers of the SPI SERCOM - leave undefined to clock every transfer with the CPU.
+ * Off until the DMA path has been built and run on the hardware. When defined, the bus
+ * wrapper owns the DMAC: it resets it and points BASEADDR and WRBADDR at its own two
+ * channel descriptors, so nothing else in the application may use the DMAC.
+ */
+/* #define CONF_WINC_SPI_DMAC_ID_TX		SERCOM2_DMAC_ID_TX */
+/* #define CONF_WINC_SPI_DMAC_ID_RX		SERCOM2_DMAC_ID_RX */
+
 /*
    ---------------------------------
    --------- Debug Options ---------
@@ -152,6 +161,10 @@ extern "C" {
 /** SPI clock. */
 #define CONF_WINC_SPI_CLOCK				(12000000)
 
+/** DMAC triggers of the SPI SERCOM - see above before defining them. */
+/* #define CONF_WINC_SPI_DMAC_ID_TX		SERCOM1_DMAC_ID_TX */
+/* #define CONF_WINC_SPI_DMAC_ID_RX		SERCOM1_DMAC_ID_RX */
+
 /*
    ---------------------------------
    --------- Debug Options ---------
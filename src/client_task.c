@@ -41,6 +41,8 @@
 #include "fan_click.h"
 
 #include "MQTTClient.h"
+#include "network_buffer.h"
+#include "publish_queue.h"
 
 #ifdef CONFIG_USE_JSON_LIB
 #include "parson.h"
@@ -52,29 +54,17 @@
 #define CLIENT_PRINTF(...)  __NOP()
 #endif
 
-/* Global structures */
-static struct _g_client_context {
-    tiny_state_ctx      state;      /**< Must be the first element */
-    uint32_t            holdoff;
-    Network             mqtt_net;
-    MQTTClient          mqtt_client;
-    uint8_t             mqtt_rx_buf[CLIENT_MQTT_RX_BUF_SIZE];
-    uint8_t             mqtt_tx_buf[CLIENT_MQTT_TX_BUF_SIZE];
-    uint8_t             sub_topic[100];
-    uint16_t            update_period;
-} g_client_context;
-
 /* Helper functions */
 static bool client_counter_finished(void* pCtx)
 {
-    struct _g_client_context* ctx = (struct _g_client_context*)pCtx;
+    client_context* ctx = (client_context*)pCtx;
 
     return (0 == ctx->holdoff);
 }
 
 static void client_counter_set(void* pCtx, uint32_t val)
 {
-    struct _g_client_context* ctx = (struct _g_client_context*)pCtx;
+    client_context* ctx = (client_context*)pCtx;
 
     /* Convert to loop time*/
     ctx->holdoff = val / CLIENT_UPDATE_PERIOD;
@@ -86,62 +76,56 @@ static void client_counter_set(void* pCtx, uint32_t val)
 }
 
 /* Must be called on the CLIENT_UPDATE_PERIOD */
-void client_timer_update(void)
+void client_timer_update(client_context* ctx)
 {
-    if(g_client_context.holdoff)
+    if(ctx->holdoff)
+    {
+        ctx->holdoff--;
+    }
+
+    if(ctx->report_holdoff)
     {
-        g_client_context.holdoff--;
+        ctx->report_holdoff--;
     }
+
+    publish_queue_timer_update(&ctx->pub_queue);
 }
 
-/** \brief Get a unique message id - Simply implemented as a counter */
-static uint16_t client_get_message_id(void)
+/** \brief Number of telemetry reports not yet acknowledged by the broker */
+uint32_t client_publish_queue_depth(client_context* ctx)
 {
-    static uint16_t message_id = 0;
+    return publish_queue_depth(&ctx->pub_queue);
+}
 
-    message_id++;
-    
-    if (message_id == (UINT16_MAX - 1))
-    {
-        message_id = 1;
-    }
+/** \brief Number of telemetry reports lost because the publish queue was full */
+uint32_t client_publish_queue_dropped(client_context* ctx)
+{
+    return publish_queue_dropped(&ctx->pub_queue);
+}
 
-    return message_id;
+/** \brief Received data has landed in the wifi receive ring */
+static void client_rx_notify(void* arg)
+{
+    client_context* ctx = (client_context*)arg;
+
+    ctx->rx_ready = true;
 }
 
-/** \brief Publish a telemetry event */
-static void client_publish_message(MQTTClient* mqtt_client)
+/** \brief Queue a telemetry event - sent by client_state_run once connected */
+static void client_publish_message(client_context* ctx)
 {
-    int status = MQTTCLIENT_FAILURE;
-    MQTTMessage message;
-    char json_message[256];
+    char json_message[PUBLISH_QUEUE_MSG_SIZE];
     uint32_t ts = time_utils_get_utc();
-    uint32_t temp = sensor_get_temperature();
-    uint32_t speed = sensor_get_fan_speed();
-    char topic[100];
-
-    if(config_get_client_pub_topic(topic, sizeof(topic)))
-    {
-        CLIENT_PRINTF("Failed to get topic string");
-        return;
-    }
+    uint32_t temp = sensor_get_temperature(ctx->sensor);
+    uint32_t speed = sensor_get_fan_speed(ctx->sensor);
 
     snprintf(json_message, sizeof(json_message), "{ \"timestamp\": %u, \"temperature\": %d.%02d, \"fan-speed\": %d }", ts, temp/1000, temp % 1000,  speed);
 
-    message.qos      = QOS1;
-    message.retained = 0;
-    message.dup      = 0;
-    message.id       = client_get_message_id();
-    
-    message.payload = (void*)json_message;
-    message.payloadlen = strlen(json_message);
+    CLIENT_PRINTF("Queueing MQTT Message %s\r\n", json_message);
 
-    CLIENT_PRINTF("Publishing MQTT Message %s\r\n", json_message);
-
-    status = MQTTPublish(mqtt_client, topic, &message);
-    if (status != MQTTCLIENT_SUCCESS)
+    if (publish_queue_push(&ctx->pub_queue, (uint8_t*)json_message, strlen(json_message)) != MQTTCLIENT_SUCCESS)
     {
-        CLIENT_PRINTF("Failed to publish the MQTT message: %d\r\n", status);
+        CLIENT_PRINTF("Failed to queue the MQTT message\r\n");
     }
 }
 
@@ -149,6 +133,7 @@ static void client_publish_message(MQTTClient* mqtt_client)
 static void client_process_message(MessageData *data)
 {
 #ifdef CONFIG_USE_JSON_LIB
+    client_context* ctx = (client_context*)data->context;
     JSON_Value *json_message_value = NULL;
     JSON_Object *json_message_object = NULL;
     JSON_Object *json_override_object = NULL;
@@ -162,21 +147,21 @@ static void client_process_message(MessageData *data)
 
     if(json_array_settings)
     {
-        update_settings_from_json(json_array_settings);
+        update_settings_from_json(ctx->sensor, json_array_settings);
     }
 
     json_override_object = json_object_get_object(json_message_object, "override");
 
     if(json_override_object)
     {
-        override_from_json(json_override_object);
+        override_from_json(ctx->sensor, json_override_object);
     }
 
     update_rate = json_object_get_number(json_message_object, "update-rate");
 
     if(1000 < update_rate)
     {
-        g_client_context.update_period = update_rate;
+        ctx->update_period = update_rate;
     }
 #endif
 }
@@ -190,13 +175,16 @@ enum {
     CLIENT_STATE_INIT = 0,    /**< Should always start with 0 */
     CLIENT_STATE_GET_TIME,
     CLIENT_STATE_CONNECT,
+    CLIENT_STATE_CONNECT_SOCKET,
+    CLIENT_STATE_CONNECT_MQTT,
+    CLIENT_STATE_SUBSCRIBE,
     CLIENT_STATE_RUN,
     CLIENT_STATE_ERROR        /**< Error states can be anywhere but are recommended at the end */
 } CLIENT_STATES;
 
 static void client_state_update(void* pCtx, uint32_t next, uint32_t wait)
 {
-    struct _g_client_context* ctx = (struct _g_client_context*)pCtx;
+    client_context* ctx = (client_context*)pCtx;
 
     //CLIENT_PRINTF("%s(%u) -> %s(%u)\r\n", tiny_state_name(ctx, ctx->state.state),
     //      ctx->state.state, tiny_state_name(ctx, next), next);
@@ -208,19 +196,27 @@ static void client_state_update(void* pCtx, uint32_t next, uint32_t wait)
     client_counter_set(pCtx, wait);
 }
 
-/* Initialize the client */
+/* A connection attempt failed - try again after the wait the reconnect policy gives */
+static void client_state_retry(void* pCtx)
+{
+    client_context* ctx = (client_context*)pCtx;
+
+    client_state_update(pCtx, CLIENT_STATE_CONNECT, reconnect_policy_next(&ctx->reconnect));
+}
+
+/* Start a new connection */
 static void client_state_init(void * pCtx)
 {
-    struct _g_client_context * ctx = (struct _g_client_context *)pCtx;
+    client_context * ctx = (client_context *)pCtx;
     
-    /* Initialize the Paho MQTT Network Structure */
-    ctx->mqtt_net.mqttread  = &mqtt_packet_read;
-    ctx->mqtt_net.mqttwrite = &mqtt_packet_write;
+    /* The MQTT client lives across connections - the session the broker keeps uses its packet ids.
+     * Anything still awaiting a puback goes back to the publish queue to be sent again with DUP. */
+    MQTTConnectionLost(&ctx->mqtt_client);
 
-    /* Initialize the Paho MQTT Client Structure */
-    MQTTClientInit(&ctx->mqtt_client, &ctx->mqtt_net, CLIENT_MQTT_TIMEOUT_MS,
-        ctx->mqtt_tx_buf, CLIENT_MQTT_TX_BUF_SIZE,
-        ctx->mqtt_rx_buf, CLIENT_MQTT_RX_BUF_SIZE);
+    /* Pull socket data in bulk so packet headers are parsed from memory - nothing buffered from
+     * the last connection carries over */
+    network_buffer_init(&ctx->mqtt_readahead, ctx->transport,
+        ctx->mqtt_readahead_buf, CLIENT_MQTT_READAHEAD_SIZE);
 
     ctx->update_period = CLIENT_REPORT_PERIOD_DEFAULT;
 
@@ -231,11 +227,13 @@ static void client_state_init(void * pCtx)
 /* Check/Get Time */
 static void client_state_get_time(void* pCtx)
 {
+    client_context* ctx = (client_context*)pCtx;
+
     if(client_counter_finished(pCtx))
     {
         if(!time_utils_get_utc())
         {
-            wifi_request_time();
+            wifi_request_time(ctx->wifi);
             client_counter_set(pCtx, WIFI_COUNTER_GET_TIME_WAIT);
         }
         else
@@ -247,7 +245,7 @@ static void client_state_get_time(void* pCtx)
 
 static int client_connect_socket(void* pCtx)
 {
-    struct _g_client_context* ctx = (struct _g_client_context*)pCtx;
+    client_context* ctx = (client_context*)pCtx;
     uint16_t port;
 
     if(config_get_host_info((char*)ctx->mqtt_rx_buf, CLIENT_MQTT_RX_BUF_SIZE, &port))
@@ -256,7 +254,7 @@ static int client_connect_socket(void* pCtx)
         return -1;
     }
 
-    if(wifi_connect((char*)ctx->mqtt_rx_buf, port))
+    if(wifi_connect_start(ctx->wifi, (char*)ctx->mqtt_rx_buf, port))
     {
         /* Failed */
         return -1;
@@ -265,15 +263,43 @@ static int client_connect_socket(void* pCtx)
     return 0;
 }
 
+/* Subscriptions - one packet and one SUBACK covers them all */
+static const enum QoS client_sub_qos[CLIENT_MQTT_SUB_TOPICS] = {QOS1, QOS1};
+static const messageHandler client_sub_handlers[CLIENT_MQTT_SUB_TOPICS] = {
+    &client_process_message,    /* config */
+    &client_process_message,    /* commands - carry the same settings */
+};
+
+/* Load the topic filters the client subscribes to */
+static int client_load_sub_topics(void* pCtx)
+{
+    client_context* ctx = (client_context*)pCtx;
+    int i;
+
+    if(config_get_client_sub_topic(ctx->sub_topics[0], CLIENT_MQTT_MAX_TOPIC) ||
+        config_get_client_cmd_topic(ctx->sub_topics[1], CLIENT_MQTT_MAX_TOPIC))
+    {
+        CLIENT_PRINTF("Failed to load the subscription topic names");
+        return MQTTCLIENT_FAILURE;
+    }
+
+    for(i = 0; i < CLIENT_MQTT_SUB_TOPICS; i++)
+    {
+        ctx->sub_filters[i] = ctx->sub_topics[i];
+    }
+
+    return MQTTCLIENT_SUCCESS;
+}
+
 /* Connect the MQTT Client to the host */
 static int client_connect(void* pCtx)
 {
     MQTTPacket_connectData mqtt_options = MQTTPacket_connectData_initializer;
-    struct _g_client_context* ctx = (struct _g_client_context*)pCtx;
+    client_context* ctx = (client_context*)pCtx;
     size_t buf_bytes_remaining = CLIENT_MQTT_RX_BUF_SIZE;
 
     mqtt_options.keepAliveInterval = MQTT_KEEP_ALIVE_INTERVAL_S;
-    mqtt_options.cleansession = 1;
+    mqtt_options.cleansession = CLIENT_MQTT_CLEAN_SESSION;
 
     /* Client ID String */
     mqtt_options.clientID.cstring = (char*)&ctx->mqtt_rx_buf[0];
@@ -298,87 +324,245 @@ static int client_connect(void* pCtx)
         return MQTTCLIENT_FAILURE;
     }
 
-    return MQTTConnect(&ctx->mqtt_client, &mqtt_options);
+    /* Save a round trip by subscribing in the same write as the connect */
+    ctx->pipelined = ctx->pipeline_connect && !client_load_sub_topics(pCtx);
+    if(ctx->pipelined)
+    {
+        return MQTTConnectSubscribeStart(&ctx->mqtt_client, &mqtt_options, CLIENT_MQTT_SUB_TOPICS,
+            ctx->sub_filters, client_sub_qos, client_sub_handlers);
+    }
+
+    return MQTTConnectStart(&ctx->mqtt_client, &mqtt_options);
 }
 
-/* Subscribe to a topic */
+/* Subscribe to all the topics */
 static int client_subscribe(void* pCtx)
 {
-    struct _g_client_context* ctx = (struct _g_client_context*)pCtx;
+    client_context* ctx = (client_context*)pCtx;
     int status = MQTTCLIENT_FAILURE;
 
-    status = config_get_client_sub_topic((char*)ctx->sub_topic, sizeof(ctx->sub_topic));
+    status = client_load_sub_topics(pCtx);
     if (status != MQTTCLIENT_SUCCESS)
     {
-        CLIENT_PRINTF("Failed to load the subscription topic name");
         return status;
     }
 
-    status = MQTTSubscribe(&ctx->mqtt_client, ctx->sub_topic, QOS1, &client_process_message);
+    status = MQTTSubscribeManyStart(&ctx->mqtt_client, CLIENT_MQTT_SUB_TOPICS,
+        ctx->sub_filters, client_sub_qos, client_sub_handlers);
 
     return status;
 }
 
+/* Encode the publish topic into the telemetry publish template */
+static int client_publish_template(void* pCtx)
+{
+    client_context* ctx = (client_context*)pCtx;
+    MQTTString topic = MQTTString_initializer;
+    char topic_name[CLIENT_MQTT_MAX_TOPIC];
+
+    if(config_get_client_pub_topic(topic_name, sizeof(topic_name)))
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    topic.cstring = topic_name;
+    if(1 != MQTTPublishTemplate_init(&ctx->pub_template, ctx->pub_template_buf,
+        sizeof(ctx->pub_template_buf), QOS1, 0, topic))
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    return MQTTCLIENT_SUCCESS;
+}
+
 /* Connect to the host */
 static void client_state_connect(void* pCtx)
 {
-    int status;
+    client_context* ctx = (client_context*)pCtx;
+
     if(client_counter_finished(pCtx))
     {
-        /* Update Hold-off */
-        client_counter_set(pCtx, WIFI_COUNTER_GET_TIME_WAIT);
-
-        /* Resolve the host and connect the socket */
-        if(client_connect_socket(pCtx))
+        /* Rejoining the access point is the WIFI task's to retry - not an attempt */
+        if(!wifi_is_ready(ctx->wifi))
         {
             return;
         }
 
-        /* Connect the MQTT client */
-        status = client_connect(pCtx);
-        if(status)
+        /* Start resolving the host and connecting the socket */
+        if(client_connect_socket(pCtx))
         {
-            CLIENT_PRINTF("MQTT Client Failed to Connect (%d)\r\n", status);
+            client_counter_set(pCtx, reconnect_policy_next(&ctx->reconnect));
             return;
         }
-                        
-        /* Connect the MQTT client */
-        status = client_subscribe(pCtx);
-        if(status)
+
+        /* Move to the next state */
+        client_state_update(pCtx, CLIENT_STATE_CONNECT_SOCKET, 0);
+    }
+}
+
+/* Wait for the socket to connect */
+static void client_state_connect_socket(void* pCtx)
+{
+    client_context* ctx = (client_context*)pCtx;
+    int status;
+
+    status = wifi_connect_step(ctx->wifi);
+    if(status == MQTTCLIENT_IN_PROGRESS)
+    {
+        return;
+    }
+    if(status)
+    {
+        CLIENT_PRINTF("Socket Failed to Connect (%d)\r\n", status);
+        client_state_retry(pCtx);
+        return;
+    }
+
+    /* Drop anything left over from the previous connection */
+    network_buffer_reset(&ctx->mqtt_readahead);
+
+    /* Connect the MQTT client */
+    status = client_connect(pCtx);
+    if(status)
+    {
+        CLIENT_PRINTF("MQTT Client Failed to Connect (%d)\r\n", status);
+        client_state_retry(pCtx);
+        return;
+    }
+
+    /* Move to the next state */
+    client_state_update(pCtx, CLIENT_STATE_CONNECT_MQTT, 0);
+}
+
+/* Connected and subscribed - get ready to publish */
+static void client_connected(void* pCtx)
+{
+    client_context* ctx = (client_context*)pCtx;
+
+    /* The publish topic does not change for the life of the connection */
+    if(client_publish_template(pCtx))
+    {
+        CLIENT_PRINTF("Failed to get topic string");
+        client_state_retry(pCtx);
+        return;
+    }
+
+    /* The next failure is retried straight away */
+    reconnect_policy_reset(&ctx->reconnect);
+
+    /* Move to the next state */
+    client_state_update(pCtx, CLIENT_STATE_RUN, 0);
+}
+
+/* Wait for the MQTT connection to be acknowledged */
+static void client_state_connect_mqtt(void* pCtx)
+{
+    client_context* ctx = (client_context*)pCtx;
+    int status;
+
+    status = MQTTOperationStep(&ctx->mqtt_client);
+    if(status == MQTTCLIENT_IN_PROGRESS)
+    {
+        return;
+    }
+    if(status)
+    {
+        CLIENT_PRINTF("MQTT Client Failed to Connect (%d)\r\n", status);
+
+        /* No answer to a pipelined connect - the broker may not accept an early SUBSCRIBE, so
+         * try the next one in two steps.  If that fails too, pipelining was not the problem. */
+        if(status < 0)
         {
-            CLIENT_PRINTF("MQTT Subscription Failed (%d)\r\n", status);
-            return;
+            ctx->pipeline_connect = !ctx->pipelined;
         }
 
-        /* Move to the next state */
-        client_state_update(pCtx, CLIENT_STATE_RUN, 0);
+        client_state_retry(pCtx);
+        return;
+    }
+
+    /* The SUBACK has already been seen */
+    if(ctx->pipelined)
+    {
+        client_connected(pCtx);
+        return;
+    }
+
+    /* Subscribe to the update topic */
+    status = client_subscribe(pCtx);
+    if(status)
+    {
+        CLIENT_PRINTF("MQTT Subscription Failed (%d)\r\n", status);
+        client_state_retry(pCtx);
+        return;
+    }
+
+    /* Move to the next state */
+    client_state_update(pCtx, CLIENT_STATE_SUBSCRIBE, 0);
+}
+
+/* Wait for the subscription to be acknowledged */
+static void client_state_subscribe(void* pCtx)
+{
+    client_context* ctx = (client_context*)pCtx;
+    int status;
+
+    status = MQTTOperationStep(&ctx->mqtt_client);
+    if(status == MQTTCLIENT_IN_PROGRESS)
+    {
+        return;
+    }
+    if(status)
+    {
+        CLIENT_PRINTF("MQTT Subscription Failed (%d)\r\n", status);
+        client_state_retry(pCtx);
+        return;
     }
+
+    client_connected(pCtx);
+}
+
+/* Handle any incoming messages - returns false, and starts again, if the connection is lost */
+static bool client_poll(client_context* ctx)
+{
+    ctx->rx_ready = false;
+
+    if(MQTTPoll(&ctx->mqtt_client) || !MQTTIsConnected(&ctx->mqtt_client))
+    {
+        /* The connection is lost - drop the socket and start again */
+        CLIENT_PRINTF("CLIENT: Connection lost\r\n");
+        wifi_disconnect(ctx->wifi);
+        client_state_update(ctx, CLIENT_STATE_INIT, 0);
+        return false;
+    }
+
+    return true;
 }
 
 /* Client is connected */
 static void client_state_run(void * pCtx)
 {
-    struct _g_client_context* ctx = (struct _g_client_context*)pCtx;
+    client_context* ctx = (client_context*)pCtx;
 
-    if(wifi_has_error())
+    if(wifi_has_error(ctx->wifi))
     {
         client_state_update(pCtx, CLIENT_STATE_INIT, 0);
+        return;
     }
 
-    if(client_counter_finished(pCtx))
+    /* Handle any incoming update messages without holding up the other tasks */
+    if(!client_poll(ctx))
     {
-        client_counter_set(pCtx, ctx->update_period);
-
-        client_publish_message(&ctx->mqtt_client);
+        return;
     }
-    else
+
+    /* Send queued reports as fast as the drain rate allows */
+    publish_queue_drain(&ctx->pub_queue, &ctx->mqtt_client, &ctx->pub_template);
+
+    /* Acks and commands that arrived while sending are handled now, not on the next pass */
+    if(ctx->rx_ready)
     {
-        /* Wait for incoming update messages */
-        if(MQTTYield(&ctx->mqtt_client, MQTT_YEILD_TIMEOUT_MS))
-        {
-            /* Failure */
-        }
-   }
+        client_poll(ctx);
+    }
 }
 
 /* Wait for the client to connect successfully */
@@ -395,19 +579,74 @@ tiny_state_def g_client_states[] =
     TINY_STATE_DEF(CLIENT_STATE_INIT,       &client_state_init),
     TINY_STATE_DEF(CLIENT_STATE_GET_TIME,   &client_state_get_time),
     TINY_STATE_DEF(CLIENT_STATE_CONNECT,    &client_state_connect),
+    TINY_STATE_DEF(CLIENT_STATE_CONNECT_SOCKET, &client_state_connect_socket),
+    TINY_STATE_DEF(CLIENT_STATE_CONNECT_MQTT, &client_state_connect_mqtt),
+    TINY_STATE_DEF(CLIENT_STATE_SUBSCRIBE,  &client_state_subscribe),
     TINY_STATE_DEF(CLIENT_STATE_RUN,        &client_state_run),
     TINY_STATE_DEF(CLIENT_STATE_ERROR,      &client_state_error),
 };
 
+/** \brief Set up a client that connects over wifi and reports on sensor */
+void client_init(client_context* ctx, wifi_context* wifi, sensor_context* sensor)
+{
+    uint8_t serial[CONFIG_SERIAL_NUMBER_SIZE];
+    size_t serial_len = sizeof(serial);
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    /* Devices that lose the same broker must not all reconnect together */
+    if(config_get_serial_number(serial, sizeof(serial)))
+    {
+        serial_len = 0;
+    }
+    reconnect_policy_init(&ctx->reconnect, CLIENT_RECONNECT_BASE_WAIT, CLIENT_RECONNECT_MAX_WAIT, serial, serial_len);
+
+    tiny_state_init(ctx, g_client_states, sizeof(g_client_states)/sizeof(g_client_states[0]), CLIENT_STATE_INIT);
+    publish_queue_init(&ctx->pub_queue);
+    ctx->wifi = wifi;
+    ctx->sensor = sensor;
+    wifi_set_rx_notify(wifi, client_rx_notify, ctx);
+
+    /* Initialize the Paho MQTT Network Structure */
+    ctx->mqtt_net.mqttread  = &mqtt_packet_read;
+    ctx->mqtt_net.mqttwrite = &mqtt_packet_write;
+    ctx->mqtt_net.mqttreadsome = &mqtt_packet_read_some;
+    ctx->mqtt_net.mqttwritev = &mqtt_packet_writev;
+    ctx->mqtt_net.context = wifi;
+    ctx->transport = &ctx->mqtt_net;
+
+    /* Initialize the Paho MQTT Client Structure - once, it reads through the read-ahead buffer
+     * each connection sets up */
+    MQTTClientInit(&ctx->mqtt_client, &ctx->mqtt_readahead.net, CLIENT_MQTT_TIMEOUT_MS,
+        ctx->mqtt_tx_buf, CLIENT_MQTT_TX_BUF_SIZE,
+        ctx->mqtt_rx_buf, CLIENT_MQTT_RX_BUF_SIZE);
+
+    /* The config and command handlers are shared by every client */
+    MQTTSetMessageContext(&ctx->mqtt_client, ctx);
+
+    /* Notice a half-open connection long before the keep alive interval would */
+    MQTTSetPingTimeouts(&ctx->mqtt_client, CLIENT_MQTT_IDLE_TIMEOUT_MS, CLIENT_MQTT_PINGRESP_TIMEOUT_MS);
+
+    ctx->update_period = CLIENT_REPORT_PERIOD_DEFAULT;
+    ctx->pipeline_connect = true;
+}
+
+/** \brief Route the connection through a Network that wraps mqtt_net - call after client_init */
+void client_set_transport(client_context* ctx, Network* transport)
+{
+    ctx->transport = transport;
+}
+
 /* Assume a 100ms time basis */
-void client_task(void)
+void client_task(client_context* ctx)
 {
-    if(!g_client_context.state.count)
+    /* Reports are queued in every state so a Wi-Fi outage does not lose them */
+    if(!ctx->report_holdoff && time_utils_get_utc())
     {
-	    /* Perform the Initialization */
-	    tiny_state_init(&g_client_context, g_client_states, sizeof(g_client_states)/sizeof(g_client_states[0]), CLIENT_STATE_INIT);
+        ctx->report_holdoff = ctx->update_period / CLIENT_UPDATE_PERIOD;
+        client_publish_message(ctx);
     }
 
     /* Run the state machine*/
-    tiny_state_driver(&g_client_context);
+    tiny_state_driver(ctx);
 }
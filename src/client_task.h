@@ -32,19 +32,71 @@
 #ifndef CLIENT_TASK_H_
 #define CLIENT_TASK_H_
 
+#include "MQTTClient.h"
+#include "network_buffer.h"
+#include "publish_queue.h"
+#include "sensor_task.h"
+#include "tiny_state_machine.h"
+#include "wifi_task.h"
+
 #define CLIENT_REPORT_PERIOD_DEFAULT    (5000)
 
 #define CLIENT_MQTT_MAX_HOST_URI    (100)
+#define CLIENT_MQTT_MAX_TOPIC       (100)
+
+/** Config and commands - subscribed to with a single SUBSCRIBE */
+#define CLIENT_MQTT_SUB_TOPICS      (2)
 
 #define CLIENT_MQTT_TIMEOUT_MS      (2000)
-#define MQTT_YEILD_TIMEOUT_MS       (500)
+
+/** Reconnect backoff - the first retry is immediate, then from the base wait up to the longest */
+#define CLIENT_RECONNECT_BASE_WAIT  (1000)
+#define CLIENT_RECONNECT_MAX_WAIT   (120000)
 #define MQTT_KEEP_ALIVE_INTERVAL_S  (900)
 
+/** Probe the broker after this much receive silence and give up if the PINGRESP is this late */
+#define CLIENT_MQTT_IDLE_TIMEOUT_MS     (30000)
+#define CLIENT_MQTT_PINGRESP_TIMEOUT_MS (5000)
+
+/** Keep the broker session across reconnects so DUP retransmissions are matched up */
+#define CLIENT_MQTT_CLEAN_SESSION   (0)
+
 #define CLIENT_MQTT_RX_BUF_SIZE     (1024)
 #define CLIENT_MQTT_TX_BUF_SIZE     (1024)
+#define CLIENT_MQTT_READAHEAD_SIZE  (256)
+
+/** A device's cloud connection - set up by client_init */
+typedef struct _client_context {
+    tiny_state_ctx      state;      /**< Must be the first element */
+    uint32_t            holdoff;
+    reconnect_policy    reconnect;  /**< Spaces out the connection attempts after a failure */
+    wifi_context*       wifi;       /**< The interface the connection is made over */
+    sensor_context*     sensor;     /**< Reported on and configured by the cloud */
+    Network             mqtt_net;
+    Network*            transport;  /**< What the read-ahead reads through - mqtt_net unless wrapped */
+    NetworkBuffer       mqtt_readahead;
+    MQTTClient          mqtt_client;
+    uint8_t             mqtt_rx_buf[CLIENT_MQTT_RX_BUF_SIZE];
+    uint8_t             mqtt_tx_buf[CLIENT_MQTT_TX_BUF_SIZE];
+    uint8_t             mqtt_readahead_buf[CLIENT_MQTT_READAHEAD_SIZE];
+    char                sub_topics[CLIENT_MQTT_SUB_TOPICS][CLIENT_MQTT_MAX_TOPIC];
+    const char*         sub_filters[CLIENT_MQTT_SUB_TOPICS];
+    uint8_t             pub_template_buf[MQTTPublishTemplate_size(CLIENT_MQTT_MAX_TOPIC)];
+    MQTTPublishTemplate pub_template;   /**< Publish topic encoded once per connection */
+    uint16_t            update_period;
+    volatile uint32_t   report_holdoff; /**< Update periods until the next telemetry report */
+    publish_queue       pub_queue;      /**< Reports not yet acknowledged - kept across reconnects */
+    bool                pipeline_connect;   /**< Send the SUBSCRIBE with the CONNECT */
+    bool                pipelined;          /**< The connection in progress was pipelined */
+    bool                rx_ready;           /**< Data has arrived since the last poll */
+} client_context;
 
-void client_task(void);
-void client_timer_update(void);
+void client_init(client_context *ctx, wifi_context *wifi, sensor_context *sensor);
+void client_task(client_context *ctx);
+void client_set_transport(client_context *ctx, Network *transport);
+void client_timer_update(client_context *ctx);
+uint32_t client_publish_queue_depth(client_context *ctx);
+uint32_t client_publish_queue_dropped(client_context *ctx);
 
 
 #endif /* CLIENT_TASK_H_ */
\ No newline at end of file
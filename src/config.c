@@ -146,6 +146,29 @@ int config_get_client_username(char* buf, size_t buflen)
     return -1;
 }
 
+/* Populate the buffer with the crypto device serial number */
+int config_get_serial_number(uint8_t* buf, size_t buflen)
+{
+    ATCA_STATUS rv;
+
+    if(!buf || buflen < ATCA_SERIAL_NUM_SIZE)
+    {
+        return -1;
+    }
+
+    rv = atcab_init(&cfg_ateccx08a_i2c_default);
+    if(ATCA_SUCCESS != rv)
+    {
+        return rv;
+    }
+
+    rv = atcab_read_serial_number(buf);
+
+    atcab_release();
+
+    return rv;
+}
+
 /* Populate the buffer with the user's password */
 int config_get_client_password(char* buf, size_t buflen)
 {
@@ -208,6 +231,22 @@ int config_get_client_pub_topic(char* buf, size_t buflen)
     return -1;
 }
 
+/* Get the topic filter for the commands sent to the client */
+int config_get_client_cmd_topic(char* buf, size_t buflen)
+{
+    if(buf && buflen)
+    {
+        int rv = snprintf(buf, buflen, "/devices/%s/commands/#", config_gcp_thing_id);
+
+        if(0 < rv && rv < buflen)
+        {
+            buf[rv] = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
+
 /* Get the topic id  where the client will be publishing messages */
 int config_get_client_sub_topic(char* buf, size_t buflen)
 {
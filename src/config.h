@@ -64,6 +64,9 @@ bool config_ready(void);
 void config_crypto(void);
 
 
+/** Bytes in the crypto device serial number (ATCA_SERIAL_NUM_SIZE) */
+#define CONFIG_SERIAL_NUMBER_SIZE   (9)
+
 /* Functions to retrieve configuration data */
 int config_get_ssid(char* buf, size_t buflen);
 int config_get_password(char* buf, size_t buflen);
@@ -72,7 +75,9 @@ int config_get_client_username(char* buf, size_t buflen);
 int config_get_client_password(char* buf, size_t buflen);
 int config_get_client_pub_topic(char* buf, size_t buflen);
 int config_get_client_sub_topic(char* buf, size_t buflen);
+int config_get_client_cmd_topic(char* buf, size_t buflen);
 int config_get_host_info(char* buf, size_t buflen, uint16_t * port);
+int config_get_serial_number(uint8_t* buf, size_t buflen);
 int config_print_public_key(void);
 
 #ifdef CONFIG_DEBUG
@@ -46,6 +46,11 @@
 /* Paho Client Timer */
 #include "timer_interface.h"
 
+/* The board's one network interface, cloud connection and fan controller */
+static wifi_context    g_wifi_context;
+static client_context  g_client_context;
+static sensor_context  g_sensor_context;
+
 #if SAM0
 /* Module globals for SAM0 */
 struct usart_module  cdc_uart_module;
@@ -107,8 +112,8 @@ static void configure_rtc(void)
 
 void update_timers(void)
 {
-    wifi_timer_update();
-    client_timer_update();
+    wifi_timer_update(&g_wifi_context);
+    client_timer_update(&g_client_context);
     TimerCallback();
     atca_kit_timer_update();
 }
@@ -246,6 +251,11 @@ int main(void)
     /* Set the local configuration for the cryptographic device being used */
     config_crypto();
 
+    /* Set up the tasks before the timer starts updating them */
+    wifi_init(&g_wifi_context);
+    sensor_init(&g_sensor_context);
+    client_init(&g_client_context, &g_wifi_context, &g_sensor_context);
+
     /* Initialize a periodic timer */
     configure_periodic_timer();
 
@@ -260,7 +270,7 @@ int main(void)
     for(;;)
     {
         /* Handle WIFI state machine */
-        wifi_task();
+        wifi_task(&g_wifi_context);
 
         /* Handle Data Interface */
         atca_kit_main_handler();
@@ -270,10 +280,10 @@ int main(void)
         if(!atca_kit_lock())
         {
             /* Handle Client State Machine */
-            client_task();
+            client_task(&g_client_context);
 
             /* Handle Sensor State Machine */
-            sensor_task();
+            sensor_task(&g_sensor_context);
         }
     }
 
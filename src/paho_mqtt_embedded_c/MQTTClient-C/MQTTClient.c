@@ -22,9 +22,14 @@
 
 #include "MQTTClient.h"
 
-static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage* aMessage) {
+#include <string.h>
+
+static void NewMessageData(MQTTClient* c, MessageData* md, MQTTString* aTopicName, MQTTMessage* aMessage) {
     md->topicName = aTopicName;
     md->message = aMessage;
+    md->offset = 0;
+    md->totallen = aMessage->payloadlen;
+    md->context = c->messageContext;
 }
 
 
@@ -56,6 +61,98 @@ static int sendPacket(MQTTClient* c, int length, Timer* timer)
 }
 
 
+// the publish header is already serialized at header, the payload is written from the caller's buffer
+static int sendPublishParts(MQTTClient* c, unsigned char* header, int len, MQTTMessage* message, Timer* timer)
+{
+    NetworkIOVec iov[2];
+    int sent = 0,
+        rc = MQTTCLIENT_FAILURE;
+
+    if (c->ipstack->mqttwritev == NULL)
+    {
+        if (len + message->payloadlen > c->buf_size)
+            return MQTTCLIENT_FAILURE;
+        memmove(c->buf, header, len);
+        memcpy(c->buf + len, message->payload, message->payloadlen);
+        return sendPacket(c, len + message->payloadlen, timer);
+    }
+
+    iov[0].base = header;
+    iov[0].length = len;
+    iov[1].base = (unsigned char*)message->payload;
+    iov[1].length = message->payloadlen;
+    len += message->payloadlen;
+
+    while (sent < len && !TimerIsExpired(timer))
+    {
+        // resume after whatever a partial write managed to send
+        int i = (sent < iov[0].length) ? 0 : 1;
+        int offset = (i == 0) ? sent : sent - iov[0].length;
+        NetworkIOVec rest[2];
+
+        rest[0].base = iov[i].base + offset;
+        rest[0].length = iov[i].length - offset;
+        rest[1] = iov[1];
+        rc = c->ipstack->mqttwritev(c->ipstack, rest, 2 - i, TimerLeftMS(timer));
+        if (rc < 0)  // there was an error writing the data
+            break;
+        sent += rc;
+    }
+    if (sent == len)
+    {
+        TimerCountdown(&c->ping_timer, c->keepAliveInterval); // record the fact that we have successfully sent the packet
+        rc = MQTTCLIENT_SUCCESS;
+    }
+    else
+        rc = MQTTCLIENT_FAILURE;
+    return rc;
+}
+
+
+static int sendPublish(MQTTClient* c, MQTTString topic, MQTTMessage* message, Timer* timer)
+{
+    int len = 0;
+
+    if (c->ipstack->mqttwritev == NULL)
+    {
+        len = MQTTSerialize_publish(c->buf, c->buf_size, message->dup, message->qos, message->retained, message->id,
+                  topic, (unsigned char*)message->payload, message->payloadlen);
+        if (len <= 0)
+            return MQTTCLIENT_FAILURE;
+        return sendPacket(c, len, timer);
+    }
+
+    // only the fixed header and topic go through c->buf
+    len = MQTTSerialize_publishHeader(c->buf, c->buf_size, message->dup, message->qos, message->retained, message->id,
+              topic, message->payloadlen);
+    if (len <= 0)
+        return MQTTCLIENT_FAILURE;
+    return sendPublishParts(c, c->buf, len, message, timer);
+}
+
+
+// the topic was encoded into the template when it was created, only the lengths and packet id are filled in here
+static int sendPublishTemplate(MQTTClient* c, MQTTPublishTemplate* tmpl, MQTTMessage* message, Timer* timer)
+{
+    unsigned char* header;
+    int len = MQTTPublishTemplate_header(tmpl, message->dup, message->id, message->payloadlen, &header);
+
+    if (len <= 0)
+        return MQTTCLIENT_FAILURE;
+    return sendPublishParts(c, header, len, message, timer);
+}
+
+
+/* MQTTTransport getfn for MQTTPoll - takes whatever has already arrived */
+static int pollRead(void* sck, unsigned char* buf, int len)
+{
+    MQTTClient* c = (MQTTClient*)sck;
+    int rc = c->ipstack->mqttreadsome(c->ipstack, buf, len, 0);
+
+    return (rc < 0) ? -1 : rc;
+}
+
+
 void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeout_ms,
 		unsigned char* sendbuf, size_t sendbuf_size, unsigned char* readbuf, size_t readbuf_size)
 {
@@ -64,6 +161,12 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
     
     for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
         c->messageHandlers[i].topicFilter = 0;
+    MQTTTopicTrie_init(&c->topicTrie);
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+    {
+        c->inflightMessages[i].packetid = 0;
+        TimerInit(&c->inflightMessages[i].timer);
+    }
     c->command_timeout_ms = command_timeout_ms;
     c->buf = sendbuf;
     c->buf_size = sendbuf_size;
@@ -71,7 +174,22 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
     c->readbuf_size = readbuf_size;
     c->isconnected = 0;
     c->ping_outstanding = 0;
+    c->keepAliveInterval = 0;
+    c->pingresp_timeout_ms = command_timeout_ms;
+    c->idle_timeout_ms = 0;
+    TimerInit(&c->pingresp_timer);
+    TimerInit(&c->last_received);
+    c->chunked_delivery = 0;
+    c->stream_remaining = 0;
+    c->transport.getfn = pollRead;
+    c->transport.sck = c;
+    c->transport.state = 0;
+    c->transport.len = 0;
+    c->operation.ack = 0;
+    c->operation.chained = 0;
+    TimerInit(&c->operation.timer);
     c->defaultMessageHandler = NULL;
+    c->messageContext = NULL;
 	c->next_packetid = 1;
     TimerInit(&c->ping_timer);
 #if defined(MQTT_TASK)
@@ -80,19 +198,23 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
 }
 
 
-static int decodePacket(MQTTClient* c, int* value, int timeout)
+static int decodePacket(MQTTClient* c, unsigned char i, int* value, int timeout)
 {
-    unsigned char i;
     int multiplier = 1;
     int len = 0;
     const int MAX_NO_OF_REMAINING_LENGTH_BYTES = 4;
 
     *value = 0;
-    do
+    for (;;)
     {
         int rc = MQTTPACKET_READ_ERROR;
 
-        if (++len > MAX_NO_OF_REMAINING_LENGTH_BYTES)
+        *value += (i & 127) * multiplier;
+        multiplier *= 128;
+        if ((i & 128) == 0)
+            break;
+
+        if (++len >= MAX_NO_OF_REMAINING_LENGTH_BYTES)
         {
             rc = MQTTPACKET_READ_ERROR; /* bad data */
             goto exit;
@@ -100,11 +222,55 @@ static int decodePacket(MQTTClient* c, int* value, int timeout)
         rc = c->ipstack->mqttread(c->ipstack, &i, 1, timeout);
         if (rc != 1)
             goto exit;
-        *value += (i & 127) * multiplier;
-        multiplier *= 128;
-    } while ((i & 128) != 0);
+    }
+    return len + 1;
 exit:
-    return len;
+    return MQTTPACKET_READ_ERROR;
+}
+
+
+/* Read the next part of an oversized packet into the read buffer, returns the number of bytes read or -1 */
+static int streamRead(MQTTClient* c, int offset, int length, Timer* timer)
+{
+    if (length > c->stream_remaining)
+        length = c->stream_remaining;
+    if (c->ipstack->mqttread(c->ipstack, c->readbuf + offset, length, TimerLeftMS(timer)) != length)
+        return -1;
+    c->stream_remaining -= length;
+    return length;
+}
+
+
+static int skipStream(MQTTClient* c, Timer* timer)
+{
+    while (c->stream_remaining > 0)
+    {
+        if (streamRead(c, 0, c->readbuf_size, timer) < 0)
+            return MQTTCLIENT_FAILURE;
+    }
+    return MQTTCLIENT_SUCCESS;
+}
+
+
+static int readPacketNonBlocking(MQTTClient* c, Timer* timer)
+{
+    MQTTHeader header = {0};
+    int rc = MQTTPacket_readnb(c->readbuf, c->readbuf_size, &c->transport);
+
+    /* readnb gives up on a packet that will not fit once it has decoded the remaining length, leaving
+     * the fixed header in the buffer - pass it on the same way readPacket does */
+    if (rc == MQTTPACKET_READ_ERROR && c->transport.len > 1 &&
+        c->transport.len + c->transport.rem_len > (int)c->readbuf_size)
+    {
+        header.byte = c->readbuf[0];
+        c->stream_remaining = c->transport.rem_len;
+        c->transport.len = 0;
+        if (header.bits.type == PUBLISH)
+            rc = PUBLISH;
+        else if (skipStream(c, timer) == MQTTCLIENT_SUCCESS)
+            rc = 0; // dropped whole, the link is still in step - nothing to process
+    }
+    return rc;
 }
 
 
@@ -115,15 +281,39 @@ static int readPacket(MQTTClient* c, Timer* timer)
     int len = 0;
     int rem_len = 0;
 
-    /* 1. read the header byte.  This has the packet type in it */
-    if (c->ipstack->mqttread(c->ipstack, c->readbuf, 1, TimerLeftMS(timer)) != 1)
+    if (c->transport.state != 0)
+    {
+        /* MQTTPoll left a packet part read - finish it rather than reading from the middle of it */
+        while ((rc = readPacketNonBlocking(c, timer)) == 0 && !TimerIsExpired(timer))
+            ;
+        if (rc == 0)
+            rc = MQTTCLIENT_FAILURE;
+        goto exit;
+    }
+
+    /* 1. read the header byte and the first remaining length byte in one go - every packet has both.
+     *    The header byte has the packet type in it */
+    if (c->ipstack->mqttread(c->ipstack, c->readbuf, 2, TimerLeftMS(timer)) != 2)
         goto exit;
 
     len = 1;
-    /* 2. read the remaining length.  This is variable in itself */
-    decodePacket(c, &rem_len, TimerLeftMS(timer));
+    /* 2. read the rest of the remaining length.  This is variable in itself */
+    if (decodePacket(c, c->readbuf[1], &rem_len, TimerLeftMS(timer)) < 0)
+        goto exit;
     len += MQTTPacket_encode(c->readbuf + 1, rem_len); /* put the original remaining length back into the buffer */
 
+    header.byte = c->readbuf[0];
+    if (len + rem_len > (int)c->readbuf_size)
+    {
+        /* too large for the buffer - a publish is streamed through it by cycle(), anything else is dropped */
+        c->stream_remaining = rem_len;
+        if (header.bits.type == PUBLISH)
+            rc = PUBLISH;
+        else
+            skipStream(c, timer);
+        goto exit;
+    }
+
     /* 3. read the rest of the buffer using a callback to supply the rest of the data */
     if (rem_len > 0 && (c->ipstack->mqttread(c->ipstack, c->readbuf + len, rem_len, TimerLeftMS(timer)) != rem_len))
         goto exit;
@@ -135,52 +325,25 @@ exit:
 }
 
 
-// assume topic filter and name is in correct format
-// # can only be at end
-// + and # can only be next to separator
-static char isTopicMatched(char* topicFilter, MQTTString* topicName)
-{
-    char* curf = topicFilter;
-    char* curn = topicName->lenstring.data;
-    char* curn_end = curn + topicName->lenstring.len;
-    
-    while (*curf && curn < curn_end)
-    {
-        if (*curn == '/' && *curf != '/')
-            break;
-        if (*curf != '+' && *curf != '#' && *curf != *curn)
-            break;
-        if (*curf == '+')
-        {   // skip until we meet the next separator, or end of string
-            char* nextpos = curn + 1;
-            while (nextpos < curn_end && *nextpos != '/')
-                nextpos = ++curn + 1;
-        }
-        else if (*curf == '#')
-            curn = curn_end - 1;    // skip until end of string
-        curf++;
-        curn++;
-    };
-    
-    return (curn == curn_end) && (*curf == '\0');
-}
-
-
-int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+static int deliverMessageChunk(MQTTClient* c, MQTTString* topicName, MQTTMessage* message, size_t offset, size_t totallen)
 {
     int i;
     int rc = MQTTCLIENT_FAILURE;
+    MQTTTopicHandlerMask matched;
 
-    // we have to find the right message handler - indexed by topic
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+    // we have to find the right message handler - the trie walks the topic once for all filters
+    matched = MQTTTopicTrie_match(&c->topicTrie, topicName);
+    for (i = 0; i < MAX_MESSAGE_HANDLERS && matched != 0; ++i)
     {
-        if (c->messageHandlers[i].topicFilter != 0 && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
-                isTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName)))
+        if ((matched & ((MQTTTopicHandlerMask)1 << i)) && c->messageHandlers[i].topicFilter != 0)
         {
+            matched &= ~((MQTTTopicHandlerMask)1 << i);
             if (c->messageHandlers[i].fp != NULL)
             {
                 MessageData md;
-                NewMessageData(&md, topicName, message);
+                NewMessageData(c, &md, topicName, message);
+                md.offset = offset;
+                md.totallen = totallen;
                 c->messageHandlers[i].fp(&md);
                 rc = MQTTCLIENT_SUCCESS;
             }
@@ -190,7 +353,9 @@ int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
     if (rc == MQTTCLIENT_FAILURE && c->defaultMessageHandler != NULL) 
     {
         MessageData md;
-        NewMessageData(&md, topicName, message);
+        NewMessageData(c, &md, topicName, message);
+        md.offset = offset;
+        md.totallen = totallen;
         c->defaultMessageHandler(&md);
         rc = MQTTCLIENT_SUCCESS;
     }   
@@ -199,26 +364,174 @@ int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 }
 
 
-int keepalive(MQTTClient* c)
+int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 {
-    int rc = MQTTCLIENT_FAILURE;
+    return deliverMessageChunk(c, topicName, message, 0, message->payloadlen);
+}
+
+
+static int inflightFind(MQTTClient* c, unsigned short packetid)
+{
+    int i;
 
-    if (c->keepAliveInterval == 0)
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
     {
-        rc = MQTTCLIENT_SUCCESS;
+        if (c->inflightMessages[i].packetid == packetid)
+            return i;
+    }
+    return -1;
+}
+
+
+static void inflightComplete(MQTTClient* c, int i, int rc)
+{
+    unsigned short packetid = c->inflightMessages[i].packetid;
+    publishCompleteHandler fp = c->inflightMessages[i].fp;
+    void* context = c->inflightMessages[i].context;
+
+    // free the slot before calling back so the handler can publish again
+    c->inflightMessages[i].packetid = 0;
+    c->inflightMessages[i].fp = NULL;
+    c->inflightMessages[i].context = NULL;
+    if (fp != NULL)
+        fp(packetid, rc, context);
+}
+
+
+static void inflightExpire(MQTTClient* c)
+{
+    int i;
+
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+    {
+        if (c->inflightMessages[i].packetid != 0 && TimerIsExpired(&c->inflightMessages[i].timer))
+            inflightComplete(c, i, MQTTCLIENT_FAILURE);
+    }
+}
+
+
+static void inflightFailAll(MQTTClient* c)
+{
+    int i;
+
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+    {
+        if (c->inflightMessages[i].packetid != 0)
+            inflightComplete(c, i, MQTTCLIENT_FAILURE);
+    }
+}
+
+
+/* Deliver a publish that does not fit in the read buffer - the fixed header has been read.
+ * The variable header stays at the start of the buffer and the rest of it is a window
+ * the payload passes through */
+static int streamPublish(MQTTClient* c, MQTTMessage* msg, Timer* timer)
+{
+    int rc = MQTTCLIENT_FAILURE;
+    MQTTHeader header = {0};
+    MQTTString topicName = MQTTString_initializer;
+    unsigned char* ptr;
+    int len = MQTTPacket_len(c->stream_remaining) - c->stream_remaining; /* fixed header length */
+    int topiclen, used, window, chunk;
+    size_t totallen, offset = 0;
+
+    header.byte = c->readbuf[0];
+    msg->dup = header.bits.dup;
+    msg->qos = (enum QoS)header.bits.qos;
+    msg->retained = header.bits.retain;
+    msg->id = 0;
+
+    /* topic length, then the topic and packet id */
+    if (streamRead(c, len, 2, timer) != 2)
         goto exit;
+    ptr = c->readbuf + len;
+    topiclen = readInt(&ptr);
+    used = len + 2 + topiclen + ((msg->qos > 0) ? 2 : 0);
+    if (used >= (int)c->readbuf_size || used - len - 2 > c->stream_remaining)
+        goto exit;
+    if (streamRead(c, len + 2, used - len - 2, timer) != used - len - 2)
+        goto exit;
+    topicName.lenstring.data = (char*)c->readbuf + len + 2;
+    topicName.lenstring.len = topiclen;
+    if (msg->qos > 0)
+    {
+        ptr = c->readbuf + len + 2 + topiclen;
+        msg->id = readInt(&ptr);
+    }
+
+    totallen = c->stream_remaining;
+    window = c->readbuf_size - used;
+    msg->payload = c->readbuf + used;
+
+    while (c->stream_remaining > 0)
+    {
+        if ((chunk = streamRead(c, used, window, timer)) <= 0)
+            goto exit;
+        msg->payloadlen = chunk;
+        if (c->chunked_delivery)
+            deliverMessageChunk(c, &topicName, msg, offset, totallen);
+        offset += msg->payloadlen;
     }
+    rc = MQTTCLIENT_SUCCESS;
+
+exit:
+    if (rc != MQTTCLIENT_SUCCESS)
+        skipStream(c, timer);
+    return rc;
+}
+
+
+static void markReceived(MQTTClient* c)
+{
+    if (c->idle_timeout_ms != 0)
+        TimerCountdownMS(&c->last_received, c->idle_timeout_ms);
+    else
+        TimerCountdown(&c->last_received, c->keepAliveInterval);
+}
+
+
+static void connectionLost(MQTTClient* c)
+{
+    c->isconnected = 0;
+    c->ping_outstanding = 0;
+    c->operation.ack = 0;
+    c->operation.chained = 0;
+    inflightFailAll(c);
+}
+
 
-    if (TimerIsExpired(&c->ping_timer))
+int keepalive(MQTTClient* c)
+{
+    int rc = MQTTCLIENT_SUCCESS;
+
+    if (c->keepAliveInterval == 0 && c->idle_timeout_ms == 0)
+        goto exit;
+
+    if (c->ping_outstanding)
+    {
+        if (TimerIsExpired(&c->pingresp_timer))
+        {
+            // no PINGRESP - the link is dead even if the socket still looks open
+            connectionLost(c);
+            rc = MQTTCLIENT_DISCONNECTED;
+        }
+    }
+    else if ((c->keepAliveInterval != 0 && TimerIsExpired(&c->ping_timer)) || TimerIsExpired(&c->last_received))
     {
-        if (!c->ping_outstanding)
+        Timer timer;
+        TimerInit(&timer);
+        TimerCountdownMS(&timer, 1000);
+        int len = MQTTSerialize_pingreq(c->buf, c->buf_size);
+        if (len > 0 && (rc = sendPacket(c, len, &timer)) == MQTTCLIENT_SUCCESS) // send the ping packet
+        {
+            c->ping_outstanding = 1;
+            TimerCountdownMS(&c->pingresp_timer, c->pingresp_timeout_ms);
+        }
+        else if (len > 0)
         {
-            Timer timer;
-            TimerInit(&timer);
-            TimerCountdownMS(&timer, 1000);
-            int len = MQTTSerialize_pingreq(c->buf, c->buf_size);
-            if (len > 0 && (rc = sendPacket(c, len, &timer)) == MQTTCLIENT_SUCCESS) // send the ping packet
-                c->ping_outstanding = 1;
+            // the transport will not take the ping - retrying it on every call would never notice
+            connectionLost(c);
+            rc = MQTTCLIENT_DISCONNECTED;
         }
     }
 
@@ -227,30 +540,52 @@ exit:
 }
 
 
-int cycle(MQTTClient* c, Timer* timer)
+static int processPacket(MQTTClient* c, unsigned short packet_type, Timer* timer)
 {
-    // read the socket, see what work is due
-    unsigned short packet_type = readPacket(c, timer);
-    
     int len = 0,
         rc = MQTTCLIENT_SUCCESS;
 
+    if (packet_type >= CONNECT && packet_type <= DISCONNECT)
+        markReceived(c); // the link is alive
+
     switch (packet_type)
     {
         case CONNACK:
-        case PUBACK:
         case SUBACK:
             break;
+        case PUBACK:
+        {
+            unsigned short mypacketid;
+            unsigned char dup, type;
+            int i;
+            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
+                rc = MQTTCLIENT_FAILURE;
+            else if (mypacketid == 0)
+                rc = MQTTCLIENT_FAILURE; // packet id 0 is not allowed - and marks a free in-flight slot
+            else if ((i = inflightFind(c, mypacketid)) >= 0)
+                inflightComplete(c, i, MQTTCLIENT_SUCCESS);
+            break;
+        }
         case PUBLISH:
         {
             MQTTString topicName;
             MQTTMessage msg;
-            int intQoS;
-            if (MQTTDeserialize_publish(&msg.dup, &intQoS, &msg.retained, &msg.id, &topicName,
-               (unsigned char**)&msg.payload, (int*)&msg.payloadlen, c->readbuf, c->readbuf_size) != 1)
-                goto exit;
-            msg.qos = (enum QoS)intQoS;
-            deliverMessage(c, &topicName, &msg);
+            int intQoS, payloadlen;
+            if (c->stream_remaining > 0)
+            {
+                // the publish was larger than the read buffer
+                if ((rc = streamPublish(c, &msg, timer)) != MQTTCLIENT_SUCCESS)
+                    goto exit;
+            }
+            else
+            {
+                if (MQTTDeserialize_publish(&msg.dup, &intQoS, &msg.retained, &msg.id, &topicName,
+                   (unsigned char**)&msg.payload, &payloadlen, c->readbuf, c->readbuf_size) != 1)
+                    goto exit;
+                msg.payloadlen = payloadlen; // size_t is wider than int on 64-bit hosts
+                msg.qos = (enum QoS)intQoS;
+                deliverMessage(c, &topicName, &msg);
+            }
             if (msg.qos != QOS0)
             {
                 if (msg.qos == QOS1)
@@ -286,7 +621,9 @@ int cycle(MQTTClient* c, Timer* timer)
             c->ping_outstanding = 0;
             break;
     }
-    keepalive(c);
+    inflightExpire(c);
+    if (c->isconnected && keepalive(c) == MQTTCLIENT_DISCONNECTED)
+        rc = MQTTCLIENT_FAILURE;
 exit:
     if (rc == MQTTCLIENT_SUCCESS)
         rc = packet_type;
@@ -294,6 +631,15 @@ exit:
 }
 
 
+int cycle(MQTTClient* c, Timer* timer)
+{
+    // read the socket, see what work is due
+    unsigned short packet_type = readPacket(c, timer);
+
+    return processPacket(c, packet_type, timer);
+}
+
+
 int MQTTYield(MQTTClient* c, int timeout_ms)
 {
     int rc = MQTTCLIENT_SUCCESS;
@@ -315,6 +661,36 @@ int MQTTYield(MQTTClient* c, int timeout_ms)
 }
 
 
+int MQTTPoll(MQTTClient* c)
+{
+    int rc = MQTTCLIENT_FAILURE;
+    int packet_type;
+    Timer timer;
+
+    if (c->ipstack->mqttreadsome == NULL)
+        goto exit;
+
+    // acks, and the rest of an oversized packet, are still sent and read within the command timeout
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms);
+
+    do
+    {
+        if ((packet_type = readPacketNonBlocking(c, &timer)) == MQTTPACKET_READ_ERROR)
+        {
+            connectionLost(c); // the transport has failed
+            goto exit;
+        }
+        if (processPacket(c, packet_type, &timer) == MQTTCLIENT_FAILURE)
+            goto exit;
+    } while (packet_type != 0); // stop once no complete packet is waiting
+
+    rc = MQTTCLIENT_SUCCESS;
+exit:
+    return rc;
+}
+
+
 void MQTTRun(void* parm)
 {
 	Timer timer;
@@ -359,12 +735,53 @@ int waitfor(MQTTClient* c, int packet_type, Timer* timer)
 }
 
 
+// serialize the connect packet into buf and reset the per-connection state
+static int connectSerialize(MQTTClient* c, MQTTPacket_connectData* options)
+{
+    MQTTPacket_connectData default_options = MQTTPacket_connectData_initializer;
+
+    if (options == 0)
+        options = &default_options; /* set default options if none were supplied */
+    
+    c->keepAliveInterval = options->keepAliveInterval;
+    TimerCountdown(&c->ping_timer, c->keepAliveInterval);
+    c->ping_outstanding = 0;
+    markReceived(c);
+    c->transport.state = 0; // nothing read on a previous connection carries over
+    c->stream_remaining = 0;
+    return MQTTSerialize_connect(c->buf, c->buf_size, options);
+}
+
+
+static int connectStart(MQTTClient* c, MQTTPacket_connectData* options, Timer* timer)
+{
+    int len = 0;
+
+    if ((len = connectSerialize(c, options)) <= 0)
+        return MQTTCLIENT_FAILURE;
+    return sendPacket(c, len, timer); // send the connect packet
+}
+
+
+// the connack is in readbuf
+static int connectFinish(MQTTClient* c)
+{
+    int rc = MQTTCLIENT_FAILURE;
+    unsigned char connack_rc = 255;
+    unsigned char sessionPresent = 0;
+
+    if (MQTTDeserialize_connack(&sessionPresent, &connack_rc, c->readbuf, c->readbuf_size) == 1)
+        rc = connack_rc;
+    if (rc == MQTTCLIENT_SUCCESS)
+        c->isconnected = 1;
+    return rc;
+}
+
+
 int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
 {
     Timer connect_timer;
     int rc = MQTTCLIENT_FAILURE;
-    MQTTPacket_connectData default_options = MQTTPacket_connectData_initializer;
-    int len = 0;
 
 #if defined(MQTT_TASK)
 	MutexLock(&c->mutex);
@@ -375,49 +792,216 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
     TimerInit(&connect_timer);
     TimerCountdownMS(&connect_timer, c->command_timeout_ms);
 
-    if (options == 0)
-        options = &default_options; /* set default options if none were supplied */
-    
-    c->keepAliveInterval = options->keepAliveInterval;
-    TimerCountdown(&c->ping_timer, c->keepAliveInterval);
-    if ((len = MQTTSerialize_connect(c->buf, c->buf_size, options)) <= 0)
-        goto exit;
-    if ((rc = sendPacket(c, len, &connect_timer)) != MQTTCLIENT_SUCCESS)  // send the connect packet
+    if ((rc = connectStart(c, options, &connect_timer)) != MQTTCLIENT_SUCCESS)
         goto exit; // there was a problem
     
     // this will be a blocking call, wait for the connack
     if (waitfor(c, CONNACK, &connect_timer) == CONNACK)
-    {
-        unsigned char connack_rc = 255;
-        unsigned char sessionPresent = 0;
-        if (MQTTDeserialize_connack(&sessionPresent, &connack_rc, c->readbuf, c->readbuf_size) == 1)
-            rc = connack_rc;
-        else
-            rc = MQTTCLIENT_FAILURE;
-    }
+        rc = connectFinish(c);
     else
         rc = MQTTCLIENT_FAILURE;
     
 exit:
-    if (rc == MQTTCLIENT_SUCCESS)
-        c->isconnected = 1;
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+
+    return rc;
+}
+
+
+int MQTTConnectStart(MQTTClient* c, MQTTPacket_connectData* options)
+{
+    int rc = MQTTCLIENT_FAILURE;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+	if (c->isconnected || c->operation.ack != 0)
+		goto exit;
 
+    TimerCountdownMS(&c->operation.timer, c->command_timeout_ms);
+    if ((rc = connectStart(c, options, &c->operation.timer)) == MQTTCLIENT_SUCCESS)
+    {
+        c->operation.ack = CONNACK;
+        c->operation.chained = 0;
+    }
+
+exit:
 #if defined(MQTT_TASK)
 	MutexUnlock(&c->mutex);
 #endif
+    return rc;
+}
+
+
+static int freeHandlerCount(MQTTClient* c)
+{
+    int i, count = 0;
 
+    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
+        if (c->messageHandlers[i].topicFilter == 0)
+            ++count;
+    return count;
+}
+
+
+static int subscribeSerialize(MQTTClient* c, unsigned char* buf, int buflen, int count,
+    const char* const topicFilters[], const enum QoS qoss[])
+{
+    MQTTString topics[MAX_MESSAGE_HANDLERS];
+    int qos_vals[MAX_MESSAGE_HANDLERS];
+    int i;
+
+    // every filter needs a handler slot in case the suback grants it
+    if (count <= 0 || count > freeHandlerCount(c))
+        return MQTTCLIENT_FAILURE;
+    for (i = 0; i < count; ++i)
+    {
+        MQTTString topic = MQTTString_initializer;
+        topic.cstring = (char *)topicFilters[i];
+        topics[i] = topic;
+        qos_vals[i] = qoss[i];
+    }
+    return MQTTSerialize_subscribe(buf, buflen, 0, getNextPacketId(c), count, topics, qos_vals);
+}
+
+
+static int subscribeStart(MQTTClient* c, int count, const char* const topicFilters[], const enum QoS qoss[], Timer* timer)
+{
+    int len = 0;
+
+    if ((len = subscribeSerialize(c, c->buf, c->buf_size, count, topicFilters, qoss)) <= 0)
+        return MQTTCLIENT_FAILURE;
+    return sendPacket(c, len, timer); // send the subscribe packet
+}
+
+
+// remember what the pending suback is for - the arrays must stay valid until it arrives
+static void operationSubscribe(MQTTClient* c, int count, const char* const topicFilters[],
+    const enum QoS qoss[], const messageHandler messageHandlers[])
+{
+    c->operation.count = count;
+    c->operation.topicFilters = topicFilters;
+    c->operation.qoss = qoss;
+    c->operation.fps = messageHandlers;
+}
+
+
+// a single subscription is kept in the operation itself
+static void operationSubscribeOne(MQTTClient* c, const char* topicFilter, enum QoS qos, messageHandler messageHandler)
+{
+    c->operation.topicFilter = topicFilter;
+    c->operation.qos = qos;
+    c->operation.fp = messageHandler;
+    operationSubscribe(c, 1, &c->operation.topicFilter, &c->operation.qos, &c->operation.fp);
+}
+
+
+#define CHAINED_SUBSCRIBE_SENT 1    // went out in the same write as the connect
+#define CHAINED_SUBSCRIBE_QUEUED 2  // did not fit, send it once connected
+
+int MQTTConnectSubscribeStart(MQTTClient* c, MQTTPacket_connectData* options, int count,
+    const char* const topicFilters[], const enum QoS qoss[], const messageHandler messageHandlers[])
+{
+    int rc = MQTTCLIENT_FAILURE;
+    int len = 0, sublen = 0;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+	if (c->isconnected || c->operation.ack != 0)
+		goto exit;
+
+    TimerCountdownMS(&c->operation.timer, c->command_timeout_ms);
+    if ((len = connectSerialize(c, options)) <= 0)
+        goto exit;
+
+    // MQTT allows a subscribe straight after the connect, so append it to the same buffer
+    if ((sublen = subscribeSerialize(c, c->buf + len, c->buf_size - len, count, topicFilters, qoss)) > 0)
+    {
+        len += sublen;
+        c->operation.chained = CHAINED_SUBSCRIBE_SENT;
+    }
+    else
+        c->operation.chained = CHAINED_SUBSCRIBE_QUEUED;
+
+    if ((rc = sendPacket(c, len, &c->operation.timer)) == MQTTCLIENT_SUCCESS)
+    {
+        c->operation.ack = CONNACK;
+        operationSubscribe(c, count, topicFilters, qoss, messageHandlers);
+    }
+
+exit:
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
     return rc;
 }
 
 
-int MQTTSubscribe(MQTTClient* c, const char* topicFilter, enum QoS qos, messageHandler messageHandler)
+// connected - wait for the suback of a subscribe chained to the connect
+static int subscribeChained(MQTTClient* c, Timer* timer)
+{
+    int rc = MQTTCLIENT_SUCCESS;
+
+    if (c->operation.chained == CHAINED_SUBSCRIBE_QUEUED)
+        rc = subscribeStart(c, c->operation.count, c->operation.topicFilters, c->operation.qoss, timer);
+    c->operation.chained = 0;
+    if (rc != MQTTCLIENT_SUCCESS)
+        return rc;
+
+    c->operation.ack = SUBACK;
+    TimerCountdownMS(&c->operation.timer, c->command_timeout_ms);
+    return MQTTCLIENT_IN_PROGRESS;
+}
+
+
+// the suback is in readbuf
+static int subscribeFinish(MQTTClient* c, int count, const char* const topicFilters[],
+    const messageHandler messageHandlers[], int grantedQoSs[])
+{
+    int rc = MQTTCLIENT_SUCCESS;
+    int granted[MAX_MESSAGE_HANDLERS];
+    int i, j, n = 0;
+    unsigned short mypacketid;
+
+    if (MQTTDeserialize_suback(&mypacketid, MAX_MESSAGE_HANDLERS, &n, granted, c->readbuf, c->readbuf_size) != 1 || n != count)
+        return MQTTCLIENT_FAILURE;
+    for (i = 0; i < count; ++i)
+    {
+        if (grantedQoSs)
+            grantedQoSs[i] = granted[i]; // 0, 1, 2 or 0x80
+        if (granted[i] == 0x80)
+        {
+            rc = 0x80; // the rest are still registered
+            continue;
+        }
+        // subscribing again, on a later connection, keeps the filter's slot
+        for (j = 0; j < MAX_MESSAGE_HANDLERS; ++j)
+        {
+            if (c->messageHandlers[j].topicFilter != 0 && strcmp(c->messageHandlers[j].topicFilter, topicFilters[i]) == 0)
+                break;
+        }
+        if (j == MAX_MESSAGE_HANDLERS)
+        {
+            for (j = 0; j < MAX_MESSAGE_HANDLERS && c->messageHandlers[j].topicFilter != 0; ++j)
+                ;
+        }
+        if (j == MAX_MESSAGE_HANDLERS || MQTTTopicTrie_insert(&c->topicTrie, topicFilters[i], j) != 0)
+            return MQTTCLIENT_FAILURE; // no room left to compile the filter
+        c->messageHandlers[j].topicFilter = topicFilters[i];
+        c->messageHandlers[j].fp = messageHandlers[i];
+    }
+    return rc;
+}
+
+
+int MQTTSubscribeMany(MQTTClient* c, int count, const char* const topicFilters[], const enum QoS qoss[],
+    const messageHandler messageHandlers[], int grantedQoSs[])
 { 
     int rc = MQTTCLIENT_FAILURE;  
     Timer timer;
-    int len = 0;
-    MQTTString topic = MQTTString_initializer;
-    topic.cstring = (char *)topicFilter;
-    int qos_val = qos;
     
 #if defined(MQTT_TASK)
 	MutexLock(&c->mutex);
@@ -428,36 +1012,129 @@ int MQTTSubscribe(MQTTClient* c, const char* topicFilter, enum QoS qos, messageH
     TimerInit(&timer);
     TimerCountdownMS(&timer, c->command_timeout_ms);
     
-    len = MQTTSerialize_subscribe(c->buf, c->buf_size, 0, getNextPacketId(c), 1, &topic, &qos_val);
-    if (len <= 0)
-        goto exit;
-    if ((rc = sendPacket(c, len, &timer)) != MQTTCLIENT_SUCCESS) // send the subscribe packet
+    if ((rc = subscribeStart(c, count, topicFilters, qoss, &timer)) != MQTTCLIENT_SUCCESS)
         goto exit;             // there was a problem
     
     if (waitfor(c, SUBACK, &timer) == SUBACK)      // wait for suback 
+        rc = subscribeFinish(c, count, topicFilters, messageHandlers, grantedQoSs);
+    else 
+        rc = MQTTCLIENT_FAILURE;
+        
+exit:
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+    return rc;
+}
+
+
+int MQTTSubscribe(MQTTClient* c, const char* topicFilter, enum QoS qos, messageHandler messageHandler)
+{
+    return MQTTSubscribeMany(c, 1, &topicFilter, &qos, &messageHandler, NULL);
+}
+
+
+int MQTTSubscribeManyStart(MQTTClient* c, int count, const char* const topicFilters[], const enum QoS qoss[],
+    const messageHandler messageHandlers[])
+{
+    int rc = MQTTCLIENT_FAILURE;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+	if (!c->isconnected || c->operation.ack != 0)
+		goto exit;
+
+    TimerCountdownMS(&c->operation.timer, c->command_timeout_ms);
+    if ((rc = subscribeStart(c, count, topicFilters, qoss, &c->operation.timer)) == MQTTCLIENT_SUCCESS)
+    {
+        c->operation.ack = SUBACK;
+        c->operation.chained = 0;
+        operationSubscribe(c, count, topicFilters, qoss, messageHandlers);
+    }
+
+exit:
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+    return rc;
+}
+
+
+int MQTTSubscribeStart(MQTTClient* c, const char* topicFilter, enum QoS qos, messageHandler messageHandler)
+{
+    int rc = MQTTCLIENT_FAILURE;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+	if (!c->isconnected || c->operation.ack != 0)
+		goto exit;
+
+    TimerCountdownMS(&c->operation.timer, c->command_timeout_ms);
+    operationSubscribeOne(c, topicFilter, qos, messageHandler);
+    if ((rc = subscribeStart(c, 1, c->operation.topicFilters, c->operation.qoss, &c->operation.timer)) == MQTTCLIENT_SUCCESS)
+    {
+        c->operation.ack = SUBACK;
+        c->operation.chained = 0;
+    }
+
+exit:
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+    return rc;
+}
+
+
+int MQTTOperationStep(MQTTClient* c)
+{
+    int rc = MQTTCLIENT_IN_PROGRESS;
+    int packet_type;
+    Timer timer;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+    if (c->operation.ack == 0 || c->ipstack->mqttreadsome == NULL)
+    {
+        rc = MQTTCLIENT_FAILURE;
+        goto exit;
+    }
+
+    // acks for anything else that arrives are still sent within the command timeout
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms);
+
+    do
     {
-        int count = 0, grantedQoS = -1;
-        unsigned short mypacketid;
-        if (MQTTDeserialize_suback(&mypacketid, 1, &count, &grantedQoS, c->readbuf, c->readbuf_size) == 1)
-            rc = grantedQoS; // 0, 1, 2 or 0x80 
-        if (rc != 0x80)
+        if ((packet_type = readPacketNonBlocking(c, &timer)) == MQTTPACKET_READ_ERROR ||
+            processPacket(c, packet_type, &timer) == MQTTCLIENT_FAILURE)
         {
-            int i;
-            for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-            {
-                if (c->messageHandlers[i].topicFilter == 0)
-                {
-                    c->messageHandlers[i].topicFilter = topicFilter;
-                    c->messageHandlers[i].fp = messageHandler;
-                    rc = 0;
-                    break;
-                }
-            }
+            rc = MQTTCLIENT_FAILURE;
+            break;
+        }
+        if (packet_type == c->operation.ack)
+        {
+            if (packet_type == CONNACK)
+                rc = connectFinish(c);
+            else
+                rc = subscribeFinish(c, c->operation.count, c->operation.topicFilters, c->operation.fps, NULL);
+            if (rc == MQTTCLIENT_SUCCESS && c->operation.chained)
+                rc = subscribeChained(c, &timer); // the suback may already be in this read
+            if (rc != MQTTCLIENT_IN_PROGRESS)
+                break;
         }
+    } while (packet_type != 0); // stop once no complete packet is waiting
+
+    if (rc == MQTTCLIENT_IN_PROGRESS && TimerIsExpired(&c->operation.timer))
+        rc = MQTTCLIENT_FAILURE; // the ack never came
+    if (rc != MQTTCLIENT_IN_PROGRESS)
+    {
+        c->operation.ack = 0;
+        c->operation.chained = 0;
     }
-    else 
-        rc = MQTTCLIENT_FAILURE;
-        
+
 exit:
 #if defined(MQTT_TASK)
 	MutexUnlock(&c->mutex);
@@ -466,24 +1143,57 @@ exit:
 }
 
 
-int MQTTUnsubscribe(MQTTClient* c, const char* topicFilter)
+// the unsuback is in - forget the filters' handlers and compile the trie again from the rest,
+// which also gives back the nodes only the removed filters used
+static void unsubscribeFinish(MQTTClient* c, int count, const char* const topicFilters[])
+{
+    int i, j;
+
+    for (i = 0; i < count; ++i)
+    {
+        for (j = 0; j < MAX_MESSAGE_HANDLERS; ++j)
+        {
+            if (c->messageHandlers[j].topicFilter != 0 && strcmp(c->messageHandlers[j].topicFilter, topicFilters[i]) == 0)
+            {
+                c->messageHandlers[j].topicFilter = 0;
+                c->messageHandlers[j].fp = NULL;
+            }
+        }
+    }
+
+    MQTTTopicTrie_init(&c->topicTrie);
+    for (j = 0; j < MAX_MESSAGE_HANDLERS; ++j)
+    {
+        if (c->messageHandlers[j].topicFilter != 0)
+            MQTTTopicTrie_insert(&c->topicTrie, c->messageHandlers[j].topicFilter, j); // they all fitted before
+    }
+}
+
+
+int MQTTUnsubscribeMany(MQTTClient* c, int count, const char* const topicFilters[])
 {   
     int rc = MQTTCLIENT_FAILURE;
     Timer timer;    
-    MQTTString topic = MQTTString_initializer;
-    topic.cstring = (char *)topicFilter;
-    int len = 0;
+    MQTTString topics[MAX_MESSAGE_HANDLERS];
+    int i, len = 0;
 
 #if defined(MQTT_TASK)
 	MutexLock(&c->mutex);
 #endif
-	if (!c->isconnected)
+	if (!c->isconnected || count <= 0 || count > MAX_MESSAGE_HANDLERS)
 		goto exit;
 
     TimerInit(&timer);
     TimerCountdownMS(&timer, c->command_timeout_ms);
+
+    for (i = 0; i < count; ++i)
+    {
+        MQTTString topic = MQTTString_initializer;
+        topic.cstring = (char *)topicFilters[i];
+        topics[i] = topic;
+    }
     
-    if ((len = MQTTSerialize_unsubscribe(c->buf, c->buf_size, 0, getNextPacketId(c), 1, &topic)) <= 0)
+    if ((len = MQTTSerialize_unsubscribe(c->buf, c->buf_size, 0, getNextPacketId(c), count, topics)) <= 0)
         goto exit;
     if ((rc = sendPacket(c, len, &timer)) != MQTTCLIENT_SUCCESS) // send the subscribe packet
         goto exit; // there was a problem
@@ -492,7 +1202,10 @@ int MQTTUnsubscribe(MQTTClient* c, const char* topicFilter)
     {
         unsigned short mypacketid;  // should be the same as the packetid above
         if (MQTTDeserialize_unsuback(&mypacketid, c->readbuf, c->readbuf_size) == 1)
-            rc = 0; 
+        {
+            unsubscribeFinish(c, count, topicFilters);
+            rc = 0;
+        }
     }
     else
         rc = MQTTCLIENT_FAILURE;
@@ -505,13 +1218,18 @@ exit:
 }
 
 
+int MQTTUnsubscribe(MQTTClient* c, const char* topicFilter)
+{
+    return MQTTUnsubscribeMany(c, 1, &topicFilter);
+}
+
+
 int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
 {
     int rc = MQTTCLIENT_FAILURE;
     Timer timer;   
     MQTTString topic = MQTTString_initializer;
     topic.cstring = (char *)topicName;
-    int len = 0;
 
 #if defined(MQTT_TASK)
 	MutexLock(&c->mutex);
@@ -523,26 +1241,32 @@ int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
     TimerCountdownMS(&timer, c->command_timeout_ms);
 
     if (message->qos == QOS1 || message->qos == QOS2)
-        message->id = getNextPacketId(c);
+    {
+        do
+            message->id = getNextPacketId(c);
+        while (inflightFind(c, message->id) >= 0);
+    }
     
-    len = MQTTSerialize_publish(c->buf, c->buf_size, 0, message->qos, message->retained, message->id, 
-              topic, (unsigned char*)message->payload, message->payloadlen);
-    if (len <= 0)
-        goto exit;
-    if ((rc = sendPacket(c, len, &timer)) != MQTTCLIENT_SUCCESS) // send the subscribe packet
+    message->dup = 0;
+    if ((rc = sendPublish(c, topic, message, &timer)) != MQTTCLIENT_SUCCESS) // send the publish packet
         goto exit; // there was a problem
     
     if (message->qos == QOS1)
     {
-        if (waitfor(c, PUBACK, &timer) == PUBACK)
+        rc = MQTTCLIENT_FAILURE;
+        // pubacks for asynchronous publishes may arrive first, keep waiting for ours
+        while (waitfor(c, PUBACK, &timer) == PUBACK)
         {
             unsigned short mypacketid;
             unsigned char dup, type;
             if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
-                rc = MQTTCLIENT_FAILURE;
+                break;
+            if (mypacketid == message->id)
+            {
+                rc = MQTTCLIENT_SUCCESS;
+                break;
+            }
         }
-        else
-            rc = MQTTCLIENT_FAILURE;
     }
     else if (message->qos == QOS2)
     {
@@ -565,6 +1289,142 @@ exit:
 }
 
 
+static int publishAsync(MQTTClient* c, const char* topicName, MQTTPublishTemplate* tmpl, MQTTMessage* message,
+        publishCompleteHandler handler, void* context)
+{
+    int rc = MQTTCLIENT_FAILURE;
+    Timer timer;
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char *)topicName;
+    int slot = -1;
+
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+	if (!c->isconnected)
+		goto exit;
+
+    if (message->qos == QOS2)
+    {
+        rc = MQTTCLIENT_BAD_QOS; // the in-flight table only tracks the single puback of QoS1
+        goto exit;
+    }
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms);
+
+    if (message->qos == QOS1)
+    {
+        if ((slot = inflightFind(c, 0)) < 0)
+        {
+            rc = MQTTCLIENT_MAX_MESSAGES_INFLIGHT;
+            goto exit;
+        }
+        // a retransmission keeps the packet id the broker may already have seen
+        if (!message->dup || message->id == 0 || inflightFind(c, message->id) >= 0)
+        {
+            message->dup = 0;
+            // never reuse a packet id that is still awaiting its puback
+            do
+                message->id = getNextPacketId(c);
+            while (inflightFind(c, message->id) >= 0);
+        }
+    }
+    else
+        message->dup = 0;
+
+    if (tmpl != NULL)
+        rc = sendPublishTemplate(c, tmpl, message, &timer);
+    else
+        rc = sendPublish(c, topic, message, &timer);
+    if (rc != MQTTCLIENT_SUCCESS) // send the publish packet
+        goto exit; // there was a problem
+
+    if (slot >= 0)
+    {
+        c->inflightMessages[slot].packetid = message->id;
+        c->inflightMessages[slot].fp = handler;
+        c->inflightMessages[slot].context = context;
+        TimerCountdownMS(&c->inflightMessages[slot].timer, c->command_timeout_ms);
+    }
+    else if (handler != NULL)
+        handler(message->id, MQTTCLIENT_SUCCESS, context); // QoS0 is complete once it is sent
+
+exit:
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+    return rc;
+}
+
+
+int MQTTPublishAsync(MQTTClient* c, const char* topicName, MQTTMessage* message,
+        publishCompleteHandler handler, void* context)
+{
+    return publishAsync(c, topicName, NULL, message, handler, context);
+}
+
+
+int MQTTPublishTemplateAsync(MQTTClient* c, MQTTPublishTemplate* tmpl, MQTTMessage* message,
+        publishCompleteHandler handler, void* context)
+{
+    message->qos = (enum QoS)tmpl->qos;
+    message->retained = tmpl->retained;
+    return publishAsync(c, NULL, tmpl, message, handler, context);
+}
+
+
+int MQTTInflightCount(MQTTClient* c)
+{
+    int i, count = 0;
+
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+    {
+        if (c->inflightMessages[i].packetid != 0)
+            count++;
+    }
+    return count;
+}
+
+
+void MQTTSetPingTimeouts(MQTTClient* c, unsigned int idle_ms, unsigned int pingresp_ms)
+{
+    c->idle_timeout_ms = idle_ms;
+    c->pingresp_timeout_ms = pingresp_ms;
+    markReceived(c);
+}
+
+
+int MQTTIsConnected(MQTTClient* c)
+{
+    return c->isconnected;
+}
+
+
+void MQTTConnectionLost(MQTTClient* c)
+{
+#if defined(MQTT_TASK)
+	MutexLock(&c->mutex);
+#endif
+    connectionLost(c);
+#if defined(MQTT_TASK)
+	MutexUnlock(&c->mutex);
+#endif
+}
+
+
+void MQTTSetChunkedDelivery(MQTTClient* c, int enable)
+{
+    c->chunked_delivery = (enable != 0);
+}
+
+
+void MQTTSetMessageContext(MQTTClient* c, void* context)
+{
+    c->messageContext = context;
+}
+
+
 int MQTTDisconnect(MQTTClient* c)
 {  
     int rc = MQTTCLIENT_FAILURE;
@@ -581,7 +1441,7 @@ int MQTTDisconnect(MQTTClient* c)
     if (len > 0)
         rc = sendPacket(c, len, &timer);            // send the disconnect packet
         
-    c->isconnected = 0;
+    connectionLost(c);
 
 #if defined(MQTT_TASK)
 	MutexUnlock(&c->mutex);
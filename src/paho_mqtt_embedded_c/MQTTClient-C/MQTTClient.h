@@ -56,6 +56,12 @@
 #define MAX_MESSAGE_HANDLERS 5 /* redefinable - how many subscriptions do you want? */
 #endif
 
+#if !defined(MAX_INFLIGHT_MESSAGES)
+#define MAX_INFLIGHT_MESSAGES 4 /* redefinable - how many QoS1 publishes may await a puback at once? */
+#endif
+
+#include "MQTTTopicTrie.h"
+
 enum QoS { QOS0, QOS1, QOS2 };
 
 /**
@@ -107,6 +113,10 @@ enum QoS { QOS0, QOS1, QOS2 };
  * Return code: Attempting SSL connection using non-SSL version of library
  */
 #define MQTTCLIENT_SSL_NOT_SUPPORTED -10
+/**
+ * Return code: A started operation is still waiting for its acknowledgement
+ */
+#define MQTTCLIENT_IN_PROGRESS -11
 
 #if 0
 /* all failure return codes must be negative */
@@ -145,10 +155,17 @@ typedef struct MessageData
 {
     MQTTMessage* message;
     MQTTString* topicName;
+    size_t offset;      /* where message->payload starts within the whole payload */
+    size_t totallen;    /* length of the whole payload - more than payloadlen when delivered in chunks */
+    void* context;      /* set by MQTTSetMessageContext */
 } MessageData;
 
 typedef void (*messageHandler)(MessageData*);
 
+/* Called once per asynchronous publish with the packet id and MQTTCLIENT_SUCCESS
+ * when the puback arrives, or MQTTCLIENT_FAILURE if it timed out or the client disconnected */
+typedef void (*publishCompleteHandler)(unsigned short packetid, int rc, void* context);
+
 typedef struct MQTTClient
 {
     unsigned int next_packetid,
@@ -160,17 +177,48 @@ typedef struct MQTTClient
     unsigned int keepAliveInterval;
     char ping_outstanding;
     int isconnected;
+    char chunked_delivery;
+    int stream_remaining;   /* bytes of an oversized publish still to be read from the network */
+    MQTTTransport transport;    /* the packet MQTTPoll is part way through reading */
 
     struct MessageHandlers
     {
         const char* topicFilter;
         void (*fp) (MessageData*);
     } messageHandlers[MAX_MESSAGE_HANDLERS];      /* Message handlers are indexed by subscription topic */
+    MQTTTopicTrie topicTrie;                      /* The subscribed filters compiled for dispatch */
 
     void (*defaultMessageHandler) (MessageData*);
+    void* messageContext;                         /* passed to the message handlers in MessageData */
+
+    struct InflightMessages
+    {
+        unsigned short packetid;
+        publishCompleteHandler fp;
+        void* context;
+        Timer timer;
+    } inflightMessages[MAX_INFLIGHT_MESSAGES];    /* QoS1 publishes awaiting a puback, packetid 0 is a free slot */
+
+    struct PendingOperation
+    {
+        int ack;                    /* CONNACK or SUBACK, 0 when no operation is in progress */
+        int chained;                /* a SUBACK is to follow the CONNACK */
+        int count;                  /* filters in the pending subscribe */
+        const char* const* topicFilters;
+        const enum QoS* qoss;
+        const messageHandler* fps;
+        const char* topicFilter;    /* the arrays for a single subscribe point here */
+        enum QoS qos;
+        messageHandler fp;
+        Timer timer;
+    } operation;                                  /* Started by MQTTConnectStart/MQTTSubscribeStart */
 
     Network* ipstack;
     Timer ping_timer;
+    Timer pingresp_timer;               /* deadline for the PINGRESP to the outstanding ping */
+    Timer last_received;                /* restarted by every packet that arrives */
+    unsigned int pingresp_timeout_ms;
+    unsigned int idle_timeout_ms;       /* 0 uses the keepalive interval */
 #if defined(MQTT_TASK)
 	Mutex mutex;
 	Thread thread;
@@ -197,6 +245,27 @@ DLLExport void MQTTClientInit(MQTTClient* client, Network* network, unsigned int
  */
 DLLExport int MQTTConnect(MQTTClient* client, MQTTPacket_connectData* options);
 
+/** MQTT Connect Start - send an MQTT connect packet and return without waiting for the Connack.
+ *  Call MQTTOperationStep until it no longer returns MQTTCLIENT_IN_PROGRESS.
+ *  @param options - connect options
+ *  @return success code
+ */
+DLLExport int MQTTConnectStart(MQTTClient* client, MQTTPacket_connectData* options);
+
+/** MQTT Connect Subscribe Start - send an MQTT connect packet and a subscribe packet in one write,
+ *  saving a round trip.  If both do not fit in the send buffer the subscribe is sent when the
+ *  Connack arrives.  Call MQTTOperationStep until it no longer returns MQTTCLIENT_IN_PROGRESS;
+ *  it returns what MQTTSubscribeMany would once the suback has been seen.  If the Connack is
+ *  refused the broker drops the subscribe, and the Connack return code is returned.
+ *  The arrays must stay valid until the operation is finished.
+ *  @param options - connect options
+ *  @param count - the number of topic filters
+ *  @param topicFilters - the topic filters to subscribe to
+ *  @return success code
+ */
+DLLExport int MQTTConnectSubscribeStart(MQTTClient* client, MQTTPacket_connectData* options, int count,
+    const char* const topicFilters[], const enum QoS qoss[], const messageHandler messageHandlers[]);
+
 /** MQTT Publish - send an MQTT publish packet and wait for all acks to complete for all QoSs
  *  @param client - the client object to use
  *  @param topic - the topic to publish to
@@ -205,6 +274,49 @@ DLLExport int MQTTConnect(MQTTClient* client, MQTTPacket_connectData* options);
  */
 DLLExport int MQTTPublish(MQTTClient* client, const char*, MQTTMessage*);
 
+/** MQTT Publish Async - send an MQTT QoS0 or QoS1 publish packet and return without waiting for the puback.
+ *  QoS1 packet ids are held in the in-flight table until cycle() matches the puback.
+ *  @param client - the client object to use
+ *  @param topic - the topic to publish to
+ *  @param message - the message to send, message->id is set to the packet id used.  A QoS1 message
+ *  with dup set is a retransmission and is resent under its existing message->id
+ *  @param handler - called when the publish completes or fails, may be NULL
+ *  @param context - passed through to the handler
+ *  @return success code, MQTTCLIENT_MAX_MESSAGES_INFLIGHT if the in-flight table is full
+ */
+DLLExport int MQTTPublishAsync(MQTTClient* client, const char*, MQTTMessage*, publishCompleteHandler, void*);
+
+/** MQTT Publish Template Async - as MQTTPublishAsync, but the topic, QoS and retained flag come from a
+ *  template made with MQTTPublishTemplate_init, so the topic is not encoded again for every message.
+ *  @param client - the client object to use
+ *  @param tmpl - the publish template
+ *  @param message - the message to send, message->id is set to the packet id used
+ *  @param handler - called when the publish completes or fails, may be NULL
+ *  @param context - passed through to the handler
+ *  @return success code, MQTTCLIENT_MAX_MESSAGES_INFLIGHT if the in-flight table is full
+ */
+DLLExport int MQTTPublishTemplateAsync(MQTTClient* client, MQTTPublishTemplate*, MQTTMessage*, publishCompleteHandler, void*);
+
+/** MQTT Inflight Count - number of asynchronous QoS1 publishes still waiting for a puback
+ *  @param client - the client object to use
+ *  @return the number of occupied in-flight slots
+ */
+DLLExport int MQTTInflightCount(MQTTClient* client);
+
+/** MQTT Set Chunked Delivery - publishes too large for the read buffer are passed to the
+ *  message handlers in fragments as they arrive, rather than being discarded. Each call
+ *  carries the topic, the fragment in message->payload and its offset/totallen.
+ *  @param client - the client object to use
+ *  @param enable - non-zero to deliver oversized publishes in chunks
+ */
+DLLExport void MQTTSetChunkedDelivery(MQTTClient* client, int enable);
+
+/** MQTT Set Message Context - lets a handler shared by several clients tell them apart
+ *  @param client - the client object to use
+ *  @param context - passed to every message handler as MessageData.context
+ */
+DLLExport void MQTTSetMessageContext(MQTTClient* client, void* context);
+
 /** MQTT Subscribe - send an MQTT subscribe packet and wait for suback before returning.
  *  @param client - the client object to use
  *  @param topicFilter - the topic filter to subscribe to
@@ -213,6 +325,44 @@ DLLExport int MQTTPublish(MQTTClient* client, const char*, MQTTMessage*);
  */
 DLLExport int MQTTSubscribe(MQTTClient* client, const char* topicFilter, enum QoS, messageHandler);
 
+/** MQTT Subscribe Many - subscribe to several topic filters with one packet and wait for the
+ *  single suback that answers them all.  A handler is registered for every filter granted.
+ *  @param client - the client object to use
+ *  @param count - the number of topic filters, at most the free message handler slots
+ *  @param topicFilters - the topic filters to subscribe to
+ *  @param grantedQoSs - set to the QoS granted for each filter, or 0x80; may be NULL
+ *  @return success code, or 0x80 if any filter was refused
+ */
+DLLExport int MQTTSubscribeMany(MQTTClient* client, int count, const char* const topicFilters[],
+    const enum QoS qoss[], const messageHandler messageHandlers[], int grantedQoSs[]);
+
+/** MQTT Subscribe Many Start - send one MQTT subscribe packet for several topic filters and return
+ *  without waiting for the suback.  The arrays must stay valid until MQTTOperationStep finishes.
+ *  @param client - the client object to use
+ *  @param count - the number of topic filters
+ *  @param topicFilters - the topic filters to subscribe to
+ *  @return success code
+ */
+DLLExport int MQTTSubscribeManyStart(MQTTClient* client, int count, const char* const topicFilters[],
+    const enum QoS qoss[], const messageHandler messageHandlers[]);
+
+/** MQTT Subscribe Start - send an MQTT subscribe packet and return without waiting for the suback.
+ *  The handler is registered when MQTTOperationStep sees the suback.
+ *  @param client - the client object to use
+ *  @param topicFilter - the topic filter to subscribe to
+ *  @return success code
+ */
+DLLExport int MQTTSubscribeStart(MQTTClient* client, const char* topicFilter, enum QoS, messageHandler);
+
+/** MQTT Operation Step - process whatever has arrived without waiting, and finish the operation
+ *  begun by MQTTConnectStart, MQTTConnectSubscribeStart or MQTTSubscribeStart once its
+ *  acknowledgement is seen.
+ *  Requires a network with mqttreadsome.
+ *  @param client - the client object to use
+ *  @return MQTTCLIENT_IN_PROGRESS, or what MQTTConnect/MQTTSubscribe would have returned
+ */
+DLLExport int MQTTOperationStep(MQTTClient* client);
+
 /** MQTT Subscribe - send an MQTT unsubscribe packet and wait for unsuback before returning.
  *  @param client - the client object to use
  *  @param topicFilter - the topic filter to unsubscribe from
@@ -220,6 +370,37 @@ DLLExport int MQTTSubscribe(MQTTClient* client, const char* topicFilter, enum Qo
  */
 DLLExport int MQTTUnsubscribe(MQTTClient* client, const char* topicFilter);
 
+/** MQTT Unsubscribe Many - unsubscribe from several topic filters with one packet and wait for the unsuback.
+ *  Once it arrives the filters' message handlers are removed and no longer match.
+ *  @param client - the client object to use
+ *  @param count - the number of topic filters
+ *  @param topicFilters - the topic filters to unsubscribe from
+ *  @return success code
+ */
+DLLExport int MQTTUnsubscribeMany(MQTTClient* client, int count, const char* const topicFilters[]);
+
+/** MQTT Set Ping Timeouts - bound how long a dead connection goes unnoticed.  A ping is sent after
+ *  idle_ms with nothing received, as well as after the keepalive interval with nothing sent, and
+ *  the connection is marked lost if its PINGRESP does not arrive within pingresp_ms.
+ *  @param client - the client object to use
+ *  @param idle_ms - receive silence before probing, 0 for the keepalive interval
+ *  @param pingresp_ms - how long to wait for a PINGRESP
+ */
+DLLExport void MQTTSetPingTimeouts(MQTTClient* client, unsigned int idle_ms, unsigned int pingresp_ms);
+
+/** MQTT Is Connected - false once a connection has been lost or disconnected
+ *  @param client - the client object to use
+ *  @return 1 while connected, 0 otherwise
+ */
+DLLExport int MQTTIsConnected(MQTTClient* client);
+
+/** MQTT Connection Lost - the network connection has gone without a DISCONNECT, so the client is no
+ *  longer connected.  Publishes still awaiting a puback are failed through their handlers, so they can
+ *  be sent again on the next connection.  The subscriptions and the packet id sequence are kept.
+ *  @param client - the client object to use
+ */
+DLLExport void MQTTConnectionLost(MQTTClient* client);
+
 /** MQTT Disconnect - send an MQTT disconnect packet and close the connection
  *  @param client - the client object to use
  *  @return success code
@@ -233,6 +414,14 @@ DLLExport int MQTTDisconnect(MQTTClient* client);
  */
 DLLExport int MQTTYield(MQTTClient* client, int time);
 
+/** MQTT Poll - MQTT background without waiting for data.  Processes any packets which have
+ *  fully arrived and returns as soon as the network has nothing more to give; a packet which
+ *  has only partly arrived is resumed on the next call.  Requires a network with mqttreadsome.
+ *  @param client - the client object to use
+ *  @return success code
+ */
+DLLExport int MQTTPoll(MQTTClient* client);
+
 #if defined(MQTT_TASK)
 /** MQTT start background thread for a client.  After this, MQTTYield should not be called.
 *  @param client - the client object to use
@@ -0,0 +1,179 @@
+/**
+ * \file
+ * \brief  Topic filter trie used to dispatch inbound PUBLISH messages
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <string.h>
+
+#include "MQTTClient.h"
+#include "MQTTTopicTrie.h"
+
+#if MAX_MESSAGE_HANDLERS > 32
+#error "MAX_MESSAGE_HANDLERS must fit in an MQTTTopicHandlerMask"
+#endif
+
+
+static int levelLength(const char* level, const char* end)
+{
+    const char* cur = level;
+
+    while (cur < end && *cur != '/')
+        cur++;
+    return cur - level;
+}
+
+
+static int findChild(MQTTTopicTrie* trie, int parent, const char* level, int levellen)
+{
+    int i;
+
+    for (i = trie->nodes[parent].child; i != MQTT_TOPIC_TRIE_NONE; i = trie->nodes[i].sibling)
+    {
+        if (trie->nodes[i].levellen == levellen && strncmp(trie->nodes[i].level, level, levellen) == 0)
+            return i;
+    }
+    return MQTT_TOPIC_TRIE_NONE;
+}
+
+
+void MQTTTopicTrie_init(MQTTTopicTrie* trie)
+{
+    memset(&trie->nodes[0], 0, sizeof(trie->nodes[0]));
+    trie->count = 1; // just the root
+}
+
+
+int MQTTTopicTrie_insert(MQTTTopicTrie* trie, const char* topicFilter, int handler)
+{
+    const char* end = topicFilter + strlen(topicFilter);
+    const char* level = topicFilter;
+    int node = 0;
+
+    for (;;)
+    {
+        int levellen = levelLength(level, end);
+        int child = findChild(trie, node, level, levellen);
+
+        if (child == MQTT_TOPIC_TRIE_NONE)
+        {
+            MQTTTopicTrieNode* n;
+
+            if (trie->count >= MAX_TOPIC_TRIE_NODES)
+                return -1;
+
+            child = trie->count++;
+            n = &trie->nodes[child];
+            n->level = level;
+            n->levellen = levellen;
+            n->child = MQTT_TOPIC_TRIE_NONE;
+            n->sibling = MQTT_TOPIC_TRIE_NONE;
+            n->handlers = 0;
+
+            if (levellen == 1 && (*level == '+' || *level == '#'))
+            {
+                // wildcards go to the end of the list so literal levels are compared first
+                unsigned char* link = &trie->nodes[node].child;
+
+                while (*link != MQTT_TOPIC_TRIE_NONE)
+                    link = &trie->nodes[*link].sibling;
+                *link = child;
+            }
+            else
+            {
+                n->sibling = trie->nodes[node].child;
+                trie->nodes[node].child = child;
+            }
+        }
+        node = child;
+
+        level += levellen;
+        if (level == end)
+            break;
+        level++; // skip the separator, a trailing one leaves an empty last level
+    }
+
+    trie->nodes[node].handlers |= ((MQTTTopicHandlerMask)1 << handler);
+    return 0;
+}
+
+
+static MQTTTopicHandlerMask matchLevel(MQTTTopicTrie* trie, int node, const char* level, const char* end)
+{
+    MQTTTopicHandlerMask found = 0;
+    int levellen = levelLength(level, end);
+    int last = (level + levellen == end);
+    int i;
+
+    for (i = trie->nodes[node].child; i != MQTT_TOPIC_TRIE_NONE; i = trie->nodes[i].sibling)
+    {
+        MQTTTopicTrieNode* n = &trie->nodes[i];
+
+        if (n->levellen == 1 && n->level[0] == '#')
+            found |= n->handlers; // matches this and every following level
+        else if ((n->levellen == 1 && n->level[0] == '+') ||
+                 (n->levellen == levellen && strncmp(n->level, level, levellen) == 0))
+        {
+            if (last)
+            {
+                int j;
+
+                found |= n->handlers;
+                // "a/#" also matches "a"
+                for (j = n->child; j != MQTT_TOPIC_TRIE_NONE; j = trie->nodes[j].sibling)
+                {
+                    if (trie->nodes[j].levellen == 1 && trie->nodes[j].level[0] == '#')
+                        found |= trie->nodes[j].handlers;
+                }
+            }
+            else
+                found |= matchLevel(trie, i, level + levellen + 1, end);
+        }
+    }
+    return found;
+}
+
+
+MQTTTopicHandlerMask MQTTTopicTrie_match(MQTTTopicTrie* trie, MQTTString* topicName)
+{
+    const char* name;
+    int len;
+
+    if (topicName->cstring)
+    {
+        name = topicName->cstring;
+        len = strlen(name);
+    }
+    else
+    {
+        name = topicName->lenstring.data;
+        len = topicName->lenstring.len;
+    }
+
+    return matchLevel(trie, 0, name, name + len);
+}
@@ -0,0 +1,84 @@
+/**
+ * \file
+ * \brief  Topic filter trie used to dispatch inbound PUBLISH messages
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#if !defined(MQTTTOPICTRIE_H_)
+#define MQTTTOPICTRIE_H_
+
+#include "MQTTPacket.h"
+
+#if !defined(MAX_TOPIC_TRIE_NODES)
+#define MAX_TOPIC_TRIE_NODES (1 + 6 * MAX_MESSAGE_HANDLERS) /* redefinable - one per distinct filter level plus the root */
+#endif
+
+#if MAX_TOPIC_TRIE_NODES > 255
+#error "MAX_TOPIC_TRIE_NODES must fit in an unsigned char index"
+#endif
+
+#define MQTT_TOPIC_TRIE_NONE 0  /* node 0 is the root so it is never a child or sibling */
+
+/* One bit per message handler slot */
+typedef unsigned long MQTTTopicHandlerMask;
+
+typedef struct MQTTTopicTrieNode
+{
+    const char* level;              /* this level of the filter, not terminated - points into the subscribed filter */
+    unsigned short levellen;
+    unsigned char child;            /* first child, MQTT_TOPIC_TRIE_NONE if a leaf */
+    unsigned char sibling;          /* next child of the same parent */
+    MQTTTopicHandlerMask handlers;  /* handlers whose filter ends at this node */
+} MQTTTopicTrieNode;
+
+/* Filters are compiled into the trie when subscribed so a lookup walks the topic
+ * name once instead of comparing it against every filter */
+typedef struct MQTTTopicTrie
+{
+    MQTTTopicTrieNode nodes[MAX_TOPIC_TRIE_NODES];
+    int count;
+} MQTTTopicTrie;
+
+void MQTTTopicTrie_init(MQTTTopicTrie* trie);
+
+/** Add a topic filter to the trie
+ *  @param trie - the trie to add to
+ *  @param topicFilter - the filter, must stay valid while it is in the trie
+ *  @param handler - index of the message handler to report on a match
+ *  @return 0 on success, -1 if the trie is full
+ */
+int MQTTTopicTrie_insert(MQTTTopicTrie* trie, const char* topicFilter, int handler);
+
+/** Find every filter that matches a topic name
+ *  @param trie - the trie to search
+ *  @param topicName - the topic name of the received message
+ *  @return a mask with the bit of each matching handler index set
+ */
+MQTTTopicHandlerMask MQTTTopicTrie_match(MQTTTopicTrie* trie, MQTTString* topicName);
+
+#endif
@@ -28,6 +28,28 @@
 DLLExport int MQTTSerialize_publish(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained, unsigned short packetid,
 		MQTTString topicName, unsigned char* payload, int payloadlen);
 
+DLLExport int MQTTSerialize_publishHeader(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+		unsigned short packetid, MQTTString topicName, int payloadlen);
+
+/** A publish topic encoded once for the life of a connection.  buf holds room for the
+ *  fixed header, then the length-prefixed topic, then the packet id */
+typedef struct
+{
+	unsigned char* buf;
+	int topiclen;	/* the encoded topic, including its 2 byte length */
+	int qos;
+	unsigned char retained;
+} MQTTPublishTemplate;
+
+#define MQTTPUBLISH_TEMPLATE_HEADROOM 5 /* header byte and the longest remaining length */
+#define MQTTPublishTemplate_size(topiclen) (MQTTPUBLISH_TEMPLATE_HEADROOM + 2 + (topiclen) + 2)
+
+DLLExport int MQTTPublishTemplate_init(MQTTPublishTemplate* tmpl, unsigned char* buf, int buflen, int qos,
+		unsigned char retained, MQTTString topicName);
+
+DLLExport int MQTTPublishTemplate_header(MQTTPublishTemplate* tmpl, unsigned char dup, unsigned short packetid,
+		int payloadlen, unsigned char** header);
+
 DLLExport int MQTTDeserialize_publish(unsigned char* dup, int* qos, unsigned char* retained, unsigned short* packetid, MQTTString* topicName,
 		unsigned char** payload, int* payloadlen, unsigned char* buf, int len);
 
@@ -58,6 +58,45 @@ int MQTTSerialize_publishLength(int qos, MQTTString topicName, int payloadlen)
   */
 int MQTTSerialize_publish(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained, unsigned short packetid,
 		MQTTString topicName, unsigned char* payload, int payloadlen)
+{
+	unsigned char *ptr = buf;
+	int rc = 0;
+
+	FUNC_ENTRY;
+	if (MQTTPacket_len(MQTTSerialize_publishLength(qos, topicName, payloadlen)) > buflen)
+	{
+		rc = MQTTPACKET_BUFFER_TOO_SHORT;
+		goto exit;
+	}
+
+	ptr += MQTTSerialize_publishHeader(ptr, buflen, dup, qos, retained, packetid, topicName, payloadlen);
+
+	memcpy(ptr, payload, payloadlen);
+	ptr += payloadlen;
+
+	rc = ptr - buf;
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/**
+  * Serializes everything of a publish packet except the payload, which the caller
+  * sends separately (e.g. straight from its own buffer with a vectored write)
+  * @param buf the buffer into which the header will be serialized
+  * @param buflen the length in bytes of the supplied buffer
+  * @param dup integer - the MQTT dup flag
+  * @param qos integer - the MQTT QoS value
+  * @param retained integer - the MQTT retained flag
+  * @param packetid integer - the MQTT packet identifier
+  * @param topicName MQTTString - the MQTT topic in the publish
+  * @param payloadlen integer - the length of the MQTT payload that will follow
+  * @return the length of the serialized header.  <= 0 indicates error
+  */
+int MQTTSerialize_publishHeader(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+		unsigned short packetid, MQTTString topicName, int payloadlen)
 {
 	unsigned char *ptr = buf;
 	MQTTHeader header = {0};
@@ -65,7 +104,8 @@ int MQTTSerialize_publish(unsigned char* buf, int buflen, unsigned char dup, int
 	int rc = 0;
 
 	FUNC_ENTRY;
-	if (MQTTPacket_len(rem_len = MQTTSerialize_publishLength(qos, topicName, payloadlen)) > buflen)
+	rem_len = MQTTSerialize_publishLength(qos, topicName, payloadlen);
+	if (MQTTPacket_len(rem_len) - payloadlen > buflen)
 	{
 		rc = MQTTPACKET_BUFFER_TOO_SHORT;
 		goto exit;
@@ -84,9 +124,6 @@ int MQTTSerialize_publish(unsigned char* buf, int buflen, unsigned char dup, int
 	if (qos > 0)
 		writeInt(&ptr, packetid);
 
-	memcpy(ptr, payload, payloadlen);
-	ptr += payloadlen;
-
 	rc = ptr - buf;
 
 exit:
@@ -95,6 +132,88 @@ exit:
 }
 
 
+/**
+  * Encodes a publish topic into a template so that each later publish on it only
+  * has to fill in the remaining length and packet id
+  * @param tmpl the template to initialize
+  * @param buf storage for the template, at least MQTTPublishTemplate_size(topic length) bytes
+  * @param buflen the length in bytes of the supplied buffer
+  * @param qos integer - the MQTT QoS value
+  * @param retained integer - the MQTT retained flag
+  * @param topicName MQTTString - the MQTT topic in the publish
+  * @return 1 for success.  <= 0 indicates error
+  */
+int MQTTPublishTemplate_init(MQTTPublishTemplate* tmpl, unsigned char* buf, int buflen, int qos,
+		unsigned char retained, MQTTString topicName)
+{
+	unsigned char *ptr = buf + MQTTPUBLISH_TEMPLATE_HEADROOM;
+	int rc = 0;
+
+	FUNC_ENTRY;
+	tmpl->topiclen = 2 + MQTTstrlen(topicName);
+	if (MQTTPublishTemplate_size(tmpl->topiclen - 2) > buflen)
+	{
+		rc = MQTTPACKET_BUFFER_TOO_SHORT;
+		goto exit;
+	}
+
+	writeMQTTString(&ptr, topicName);
+	tmpl->buf = buf;
+	tmpl->qos = qos;
+	tmpl->retained = retained;
+	rc = 1;
+
+exit:
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
+
+/**
+  * Completes the header of a publish from a template.  The fixed header is written
+  * just in front of the stored topic so the whole header is contiguous
+  * @param tmpl the template initialized by MQTTPublishTemplate_init
+  * @param dup integer - the MQTT dup flag
+  * @param packetid integer - the MQTT packet identifier
+  * @param payloadlen integer - the length of the MQTT payload that will follow
+  * @param header set to the start of the header within the template
+  * @return the length of the header.  <= 0 indicates error
+  */
+int MQTTPublishTemplate_header(MQTTPublishTemplate* tmpl, unsigned char dup, unsigned short packetid,
+		int payloadlen, unsigned char** header)
+{
+	unsigned char encoded[4];
+	unsigned char *ptr = tmpl->buf + MQTTPUBLISH_TEMPLATE_HEADROOM + tmpl->topiclen;
+	MQTTHeader fixed = {0};
+	int rem_len = tmpl->topiclen + payloadlen;
+	int enclen = 0;
+	int rc = 0;
+
+	FUNC_ENTRY;
+	if (tmpl->qos > 0)
+	{
+		writeInt(&ptr, packetid);
+		rem_len += 2;
+	}
+	rc = ptr - (tmpl->buf + MQTTPUBLISH_TEMPLATE_HEADROOM);
+
+	enclen = MQTTPacket_encode(encoded, rem_len);
+	ptr = tmpl->buf + MQTTPUBLISH_TEMPLATE_HEADROOM - 1 - enclen;
+	*header = ptr;
+
+	fixed.bits.type = PUBLISH;
+	fixed.bits.dup = dup;
+	fixed.bits.qos = tmpl->qos;
+	fixed.bits.retain = tmpl->retained;
+	writeChar(&ptr, fixed.byte); /* write header */
+	memcpy(ptr, encoded, enclen); /* write remaining length */
+
+	rc += 1 + enclen;
+
+	FUNC_EXIT_RC(rc);
+	return rc;
+}
+
 
 /**
   * Serializes the ack packet into the supplied buffer.
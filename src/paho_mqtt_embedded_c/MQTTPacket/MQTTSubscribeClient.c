@@ -124,12 +124,12 @@ int MQTTDeserialize_suback(unsigned short* packetid, int maxcount, int* count, i
 	*count = 0;
 	while (curdata < enddata)
 	{
-		if (*count > maxcount)
+		if (*count >= maxcount)
 		{
 			rc = -1;
 			goto exit;
 		}
-		grantedQoSs[(*count)++] = readChar(&curdata);
+		grantedQoSs[(*count)++] = (unsigned char)readChar(&curdata); /* 0x80 is a failure, not -128 */
 	}
 
 	rc = 1;
@@ -0,0 +1,296 @@
+/**
+ * \file
+ * \brief  Read-ahead buffer between the MQTT client and its Network transport
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <string.h>
+
+#include "network_buffer.h"
+#include "timer_interface.h"
+
+/* Number of bytes waiting in the buffer */
+static inline int network_buffer_used(NetworkBuffer *nb)
+{
+    return nb->tail - nb->head;
+}
+
+/* Read up to length bytes from the transport, returning as soon as any arrive */
+static int network_buffer_transport_read(NetworkBuffer *nb, unsigned char *read_buffer, int length, int min_length, Timer *timer)
+{
+    nb->transport_reads++;
+
+    if (nb->transport->mqttreadsome)
+    {
+        return nb->transport->mqttreadsome(nb->transport, read_buffer, length, TimerLeftMS(timer));
+    }
+    else
+    {
+        /* Transport only supports exact reads so never ask for more than is required */
+        return nb->transport->mqttread(nb->transport, read_buffer, min_length, TimerLeftMS(timer));
+    }
+}
+
+/* Make sure at least length bytes are buffered - returns the number buffered, or the transport's
+ * error if it failed with nothing buffered */
+static int network_buffer_fill(NetworkBuffer *nb, int length, Timer *timer)
+{
+    int rc = 0;
+
+    /* Move the unread bytes to the front so the transport can fill the rest */
+    if (nb->head > 0)
+    {
+        memmove(nb->buf, &nb->buf[nb->head], network_buffer_used(nb));
+        nb->tail -= nb->head;
+        nb->head = 0;
+    }
+
+    while (nb->tail < length)
+    {
+        rc = network_buffer_transport_read(nb, &nb->buf[nb->tail], nb->size - nb->tail,
+            length - nb->tail, timer);
+        if (rc <= 0)
+        {
+            /* Error or timeout - leave whatever has been buffered */
+            break;
+        }
+        nb->tail += rc;
+    }
+
+    return (rc < 0 && nb->tail == 0) ? rc : nb->tail;
+}
+
+/**
+ * \brief Initialize a read-ahead buffer on top of a transport
+ *
+ * \param nb[out]                   The buffer to initialize
+ * \param transport[in]             The transport that will supply the data
+ * \param buf[in]                   Storage for the read-ahead data
+ * \param size[in]                  Size of the storage
+ */
+void network_buffer_init(NetworkBuffer *nb, Network *transport, unsigned char *buf, int size)
+{
+    memset(&nb->net, 0, sizeof(nb->net));
+    nb->net.mqttread = &network_buffer_read;
+    nb->net.mqttreadsome = &network_buffer_read_some;
+    nb->net.mqttwrite = &network_buffer_write;
+    nb->net.mqttwritev = (transport->mqttwritev) ? &network_buffer_writev : NULL;
+    nb->net.context = transport->context;
+
+    nb->transport = transport;
+    nb->buf = buf;
+    nb->size = size;
+    nb->transport_reads = 0;
+
+    network_buffer_reset(nb);
+}
+
+/**
+ * \brief Discard any buffered data - used when the transport is reconnected
+ *
+ * \param nb[in]                    The read-ahead buffer
+ */
+void network_buffer_reset(NetworkBuffer *nb)
+{
+    nb->head = 0;
+    nb->tail = 0;
+}
+
+/**
+ * \brief Look at the next bytes of the stream without consuming them
+ *
+ * \param nb[in]                    The read-ahead buffer
+ * \param data[out]                 Set to the first unread byte
+ * \param length[in]                The number of bytes required
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The number of bytes available at data (less than length on
+ *            timeout) or a negative value if length exceeds the buffer or
+ *            the transport failed with nothing buffered
+ */
+int network_buffer_peek(NetworkBuffer *nb, unsigned char **data, int length, int timeout_ms)
+{
+    Timer timer;
+
+    if (length > nb->size)
+    {
+        return -1;
+    }
+
+    if (network_buffer_used(nb) < length)
+    {
+        TimerInit(&timer);
+        TimerCountdownMS(&timer, timeout_ms);
+        if (network_buffer_fill(nb, length, &timer) < 0)
+        {
+            return -1;
+        }
+    }
+
+    *data = &nb->buf[nb->head];
+
+    return network_buffer_used(nb);
+}
+
+/**
+ * \brief Drop bytes returned by network_buffer_peek
+ *
+ * \param nb[in]                    The read-ahead buffer
+ * \param length[in]                The number of bytes to drop
+ */
+void network_buffer_consume(NetworkBuffer *nb, int length)
+{
+    if (length > network_buffer_used(nb))
+    {
+        length = network_buffer_used(nb);
+    }
+
+    nb->head += length;
+
+    if (nb->head == nb->tail)
+    {
+        network_buffer_reset(nb);
+    }
+}
+
+/**
+ * \brief Reads exactly length bytes - Network mqttread operation
+ *
+ * \param network[in]               The read-ahead buffer's Network
+ * \param read_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    length on success otherwise the MQTT status
+ */
+int network_buffer_read(Network *network, unsigned char *read_buffer, int length, int timeout_ms)
+{
+    NetworkBuffer *nb = (NetworkBuffer*)network;
+    unsigned char *data;
+    int copied;
+    int rc;
+    Timer timer;
+
+    if (length <= nb->size)
+    {
+        /* Serve from the read-ahead buffer */
+        if (network_buffer_peek(nb, &data, length, timeout_ms) < length)
+        {
+            return -1;
+        }
+        memcpy(read_buffer, data, length);
+        network_buffer_consume(nb, length);
+        return length;
+    }
+
+    /* Too large to stage - drain what is buffered then read straight into the caller's buffer */
+    copied = network_buffer_used(nb);
+    memcpy(read_buffer, &nb->buf[nb->head], copied);
+    network_buffer_reset(nb);
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, timeout_ms);
+
+    while (copied < length)
+    {
+        rc = network_buffer_transport_read(nb, &read_buffer[copied], length - copied, length - copied, &timer);
+        if (rc <= 0)
+        {
+            return -1;
+        }
+        copied += rc;
+    }
+
+    return length;
+}
+
+/**
+ * \brief Reads up to length bytes - Network mqttreadsome operation
+ *
+ * \param network[in]               The read-ahead buffer's Network
+ * \param read_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The number of bytes read, 0 on timeout, or the MQTT status
+ */
+int network_buffer_read_some(Network *network, unsigned char *read_buffer, int length, int timeout_ms)
+{
+    NetworkBuffer *nb = (NetworkBuffer*)network;
+    unsigned char *data;
+    int available;
+
+    available = network_buffer_peek(nb, &data, 1, timeout_ms);
+    if (available <= 0)
+    {
+        return available;
+    }
+
+    if (available > length)
+    {
+        available = length;
+    }
+    memcpy(read_buffer, data, available);
+    network_buffer_consume(nb, available);
+
+    return available;
+}
+
+/**
+ * \brief Writes pass straight through to the transport
+ *
+ * \param network[in]               The read-ahead buffer's Network
+ * \param send_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The MQTT status
+ */
+int network_buffer_write(Network *network, unsigned char *send_buffer, int length, int timeout_ms)
+{
+    NetworkBuffer *nb = (NetworkBuffer*)network;
+
+    return nb->transport->mqttwrite(nb->transport, send_buffer, length, timeout_ms);
+}
+
+/**
+ * \brief Vectored writes pass straight through to the transport
+ *
+ * \param network[in]               The read-ahead buffer's Network
+ * \param iov[in]                   The buffers
+ * \param iovcnt[in]                The number of buffers
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The number of bytes written or the MQTT status
+ */
+int network_buffer_writev(Network *network, NetworkIOVec *iov, int iovcnt, int timeout_ms)
+{
+    NetworkBuffer *nb = (NetworkBuffer*)network;
+
+    return nb->transport->mqttwritev(nb->transport, iov, iovcnt, timeout_ms);
+}
@@ -0,0 +1,70 @@
+/**
+ * \file
+ * \brief  Read-ahead buffer between the MQTT client and its Network transport
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef MQTT_NETWORK_BUFFER_H
+#define MQTT_NETWORK_BUFFER_H
+
+#include "network_interface.h"
+
+/**
+ * \defgroup Read-ahead Network Buffer
+ *
+ * Wraps a transport Network and presents itself as a Network to the client.
+ * Bytes are pulled from the transport in bulk (via mqttreadsome when the
+ * transport provides it) so the small header and remaining-length reads made
+ * for every packet are served from memory rather than the transport.
+ *
+ * @{
+ */
+
+typedef struct mqtt_network_buffer {
+    Network         net;                /**< Must be the first element - handed to the client */
+    Network        *transport;          /**< Underlying transport */
+    unsigned char  *buf;                /**< Read-ahead storage */
+    int             size;               /**< Size of the storage */
+    int             head;               /**< Offset of the next unread byte */
+    int             tail;               /**< Offset one past the last buffered byte */
+    unsigned int    transport_reads;    /**< Number of calls made into the transport */
+} NetworkBuffer;
+
+void network_buffer_init(NetworkBuffer *nb, Network *transport, unsigned char *buf, int size);
+void network_buffer_reset(NetworkBuffer *nb);
+int network_buffer_peek(NetworkBuffer *nb, unsigned char **data, int length, int timeout_ms);
+void network_buffer_consume(NetworkBuffer *nb, int length);
+
+int network_buffer_read(Network *network, unsigned char *read_buffer, int length, int timeout_ms);
+int network_buffer_read_some(Network *network, unsigned char *read_buffer, int length, int timeout_ms);
+int network_buffer_write(Network *network, unsigned char *send_buffer, int length, int timeout_ms);
+int network_buffer_writev(Network *network, NetworkIOVec *iov, int iovcnt, int timeout_ms);
+
+/** @} */
+
+#endif // MQTT_NETWORK_BUFFER_H
@@ -55,11 +55,32 @@
  * \param length[in]                The buffer length
  * \param timeout_ms[in]            The timeout
  *
- * \return    The MQTT status
+ * \return    length, fewer bytes if the read failed part way, or the MQTT status
  */
 int mqtt_packet_read(Network *network, unsigned char *read_buffer, int length, int timeout_ms)
 {
-    return wifi_read_data(read_buffer, length, timeout_ms);
+    return wifi_read_data(network->context, read_buffer, length, timeout_ms);
+}
+
+/**
+ * \brief Reads whatever data the WINC1500 module has received, up to length.
+ *
+ * \param network[in]               The Eclipse Paho MQTT network information
+ * \param read_buffer[in]           The buffer
+ * \param length[in]                The buffer length
+ * \param timeout_ms[in]            The timeout - zero returns straight away
+ *
+ * \return    The number of bytes read, 0 on timeout, or the MQTT status
+ */
+int mqtt_packet_read_some(Network *network, unsigned char *read_buffer, int length, int timeout_ms)
+{
+    if (timeout_ms == 0)
+    {
+        /* The WINC treats a zero recv timeout as wait forever */
+        return wifi_read_poll(network->context, read_buffer, length);
+    }
+
+    return wifi_read_some(network->context, read_buffer, length, timeout_ms);
 }
 
 /**
@@ -74,5 +95,46 @@ int mqtt_packet_read(Network *network, unsigned char *read_buffer, int length, i
  */
 int mqtt_packet_write(Network *network, unsigned char *send_buffer, int length, int timeout_ms)
 {
-    return wifi_send_data(send_buffer, length, timeout_ms);
+    return wifi_send_data(network->context, send_buffer, length, timeout_ms);
+}
+
+/**
+ * \brief Writes a list of buffers to the WINC1500 module without joining them.
+ *
+ * \param network[in]               The Eclipse Paho MQTT network information
+ * \param iov[in]                   The buffers
+ * \param iovcnt[in]                The number of buffers
+ * \param timeout_ms[in]            The timeout
+ *
+ * \return    The number of bytes written or the MQTT status
+ */
+int mqtt_packet_writev(Network *network, NetworkIOVec *iov, int iovcnt, int timeout_ms)
+{
+    int total = 0;
+    int offset;
+    int length;
+    int rc;
+    int i;
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        /* The WINC limits the size of a single send */
+        for (offset = 0; offset < iov[i].length; offset += length)
+        {
+            length = iov[i].length - offset;
+            if (length > WIFI_MAX_SEND_SIZE)
+            {
+                length = WIFI_MAX_SEND_SIZE;
+            }
+
+            rc = wifi_send_data(network->context, &iov[i].base[offset], length, timeout_ms);
+            if (rc != length)
+            {
+                return (total > 0) ? total : rc;
+            }
+            total += rc;
+        }
+    }
+
+    return total;
 }
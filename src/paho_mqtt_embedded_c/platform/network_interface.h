@@ -47,12 +47,26 @@
 
 #include <stdint.h>
 
+/* One buffer of a vectored write */
+typedef struct mqtt_network_iovec {
+	unsigned char *base;
+	int length;
+} NetworkIOVec;
+
 typedef struct mqtt_network {
 	int (*mqttread)(struct mqtt_network *network, unsigned char *read_buffer, int length, int timeout_ms);
 	int (*mqttwrite)(struct mqtt_network *network, unsigned char *send_buffer, int length, int timeout_ms);
+	/* Optional - returns as soon as any bytes (up to length) are available, 0 on timeout */
+	int (*mqttreadsome)(struct mqtt_network *network, unsigned char *read_buffer, int length, int timeout_ms);
+	/* Optional - writes the buffers in order without joining them, returns the total bytes written */
+	int (*mqttwritev)(struct mqtt_network *network, NetworkIOVec *iov, int iovcnt, int timeout_ms);
+	/* The connection the functions act on - the wifi context on this platform */
+	void *context;
 } Network;
 
 int mqtt_packet_read(Network *network, unsigned char *read_buffer, int length, int timeout_ms);
+int mqtt_packet_read_some(Network *network, unsigned char *read_buffer, int length, int timeout_ms);
 int mqtt_packet_write(Network *network, unsigned char *send_buffer, int length, int timeout_ms);
+int mqtt_packet_writev(Network *network, NetworkIOVec *iov, int iovcnt, int timeout_ms);
 
 #endif // MQTT_NETWORK_INTERFACE_H
\ No newline at end of file
@@ -0,0 +1,235 @@
+/**
+ * \file
+ * \brief  Bounded queue of QoS1 telemetry messages awaiting a puback
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <string.h>
+#include "asf.h"
+#include "config.h"
+#include "publish_queue.h"
+
+#if PUBLISH_QUEUE_DEPTH <= MAX_INFLIGHT_MESSAGES
+#error "A full queue must always hold a message that is not in flight to drop"
+#endif
+
+static publish_queue_entry *publish_queue_entry_at(publish_queue *queue, uint8_t index)
+{
+    return &queue->entries[(queue->head + index) % PUBLISH_QUEUE_DEPTH];
+}
+
+/* Remove the entry at index, moving the newer ones up so no free slots are left between
+   head and count */
+static void publish_queue_remove(publish_queue *queue, uint8_t index)
+{
+    queue->count--;
+
+    for (; index < queue->count; index++)
+    {
+        memcpy(publish_queue_entry_at(queue, index), publish_queue_entry_at(queue, index + 1),
+            sizeof(publish_queue_entry));
+    }
+
+    publish_queue_entry_at(queue, queue->count)->state = PUBLISH_QUEUE_FREE;
+}
+
+/* Called by the MQTT client when a queued publish is acknowledged or fails */
+static void publish_queue_complete(unsigned short packetid, int rc, void *context)
+{
+    publish_queue *queue = (publish_queue*)context;
+    publish_queue_entry *entry;
+    uint8_t i;
+
+    for (i = 0; i < queue->count; i++)
+    {
+        entry = publish_queue_entry_at(queue, i);
+        if (PUBLISH_QUEUE_INFLIGHT == entry->state && packetid == entry->id)
+        {
+            if (MQTTCLIENT_SUCCESS == rc)
+            {
+                publish_queue_remove(queue, i);
+            }
+            else
+            {
+                /* No puback, or the connection was lost - send it again */
+                entry->state = PUBLISH_QUEUE_PENDING;
+                entry->dup = 1;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * \brief Empty the queue and clear its counters
+ *
+ * \param queue[in]                 The queue
+ */
+void publish_queue_init(publish_queue *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+/**
+ * \brief Count down the drain hold-off - must be called on the CLIENT_UPDATE_PERIOD
+ *
+ * \param queue[in]                 The queue
+ */
+void publish_queue_timer_update(publish_queue *queue)
+{
+    if (queue->holdoff)
+    {
+        queue->holdoff--;
+    }
+}
+
+/**
+ * \brief Add a message to the queue, discarding the oldest message not in flight if it is full
+ *
+ * \param queue[in]                 The queue
+ * \param payload[in]               The message payload
+ * \param length[in]                The payload length
+ *
+ * \return    The MQTT status
+ */
+int publish_queue_push(publish_queue *queue, const uint8_t *payload, uint16_t length)
+{
+    publish_queue_entry *entry;
+    uint8_t i;
+
+    if (length > PUBLISH_QUEUE_MSG_SIZE)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    if (PUBLISH_QUEUE_DEPTH == queue->count)
+    {
+        /* The newest telemetry is the most useful so make room by dropping the oldest. One in
+           flight keeps its slot - the client still holds its packet id. */
+        i = 0;
+        while (PUBLISH_QUEUE_INFLIGHT == publish_queue_entry_at(queue, i)->state)
+        {
+            i++;
+        }
+        publish_queue_remove(queue, i);
+        queue->dropped++;
+    }
+
+    entry = publish_queue_entry_at(queue, queue->count);
+    entry->state = PUBLISH_QUEUE_PENDING;
+    entry->dup = 0;
+    entry->id = 0;
+    entry->length = length;
+    memcpy(entry->payload, payload, length);
+
+    queue->count++;
+
+    return MQTTCLIENT_SUCCESS;
+}
+
+/**
+ * \brief Send pending messages, oldest first, within the drain rate and the
+ *        client's in-flight window
+ *
+ * \param queue[in]                 The queue
+ * \param mqtt_client[in]           A connected MQTT client
+ * \param topic[in]                 The QoS1 publish template for the topic
+ *
+ * \return    The number of messages sent or the MQTT status
+ */
+int publish_queue_drain(publish_queue *queue, MQTTClient *mqtt_client, MQTTPublishTemplate *topic)
+{
+    publish_queue_entry *entry;
+    MQTTMessage message;
+    int status;
+    int sent = 0;
+    uint8_t i;
+
+    if (queue->holdoff)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < queue->count && sent < PUBLISH_QUEUE_DRAIN_BURST; i++)
+    {
+        entry = publish_queue_entry_at(queue, i);
+        if (PUBLISH_QUEUE_PENDING != entry->state)
+        {
+            continue;
+        }
+
+        if (MQTTInflightCount(mqtt_client) >= MAX_INFLIGHT_MESSAGES)
+        {
+            break;
+        }
+
+        message.dup        = entry->dup;
+        message.id         = entry->id;
+        message.payload    = entry->payload;
+        message.payloadlen = entry->length;
+
+        status = MQTTPublishTemplateAsync(mqtt_client, topic, &message, &publish_queue_complete, queue);
+        if (MQTTCLIENT_SUCCESS != status)
+        {
+            /* Leave it queued for the next attempt */
+            return status;
+        }
+
+        if (message.dup)
+        {
+            queue->retransmits++;
+        }
+
+        entry->id = message.id;
+        entry->state = PUBLISH_QUEUE_INFLIGHT;
+        sent++;
+    }
+
+    if (sent)
+    {
+        queue->holdoff = PUBLISH_QUEUE_DRAIN_PERIOD_MS / CLIENT_UPDATE_PERIOD;
+    }
+
+    return sent;
+}
+
+/**
+ * \brief Number of messages not yet acknowledged by the broker
+ */
+uint32_t publish_queue_depth(publish_queue *queue)
+{
+    return queue->count;
+}
+
+/**
+ * \brief Number of messages discarded because the queue was full
+ */
+uint32_t publish_queue_dropped(publish_queue *queue)
+{
+    return queue->dropped;
+}
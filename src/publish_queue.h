@@ -0,0 +1,81 @@
+/**
+ * \file
+ * \brief  Bounded queue of QoS1 telemetry messages awaiting a puback
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef PUBLISH_QUEUE_H_
+#define PUBLISH_QUEUE_H_
+
+#include <stdint.h>
+#include "MQTTClient.h"
+
+/** Number of messages held while offline or awaiting a puback */
+#define PUBLISH_QUEUE_DEPTH             (8)
+
+/** Largest payload that can be queued */
+#define PUBLISH_QUEUE_MSG_SIZE          (160)
+
+/** Messages sent each drain period - keeps a backlog from flooding the broker on reconnect */
+#define PUBLISH_QUEUE_DRAIN_BURST       (2)
+#define PUBLISH_QUEUE_DRAIN_PERIOD_MS   (500)
+
+typedef enum
+{
+    PUBLISH_QUEUE_FREE = 0,     /**< Acknowledged or dropped */
+    PUBLISH_QUEUE_PENDING,      /**< Waiting to be (re)sent */
+    PUBLISH_QUEUE_INFLIGHT      /**< Sent and awaiting the puback */
+} PUBLISH_QUEUE_STATES;
+
+typedef struct
+{
+    uint8_t     state;
+    uint8_t     dup;            /**< Already sent once - resend with DUP under the same id */
+    uint16_t    id;             /**< Packet id of the last send */
+    uint16_t    length;
+    uint8_t     payload[PUBLISH_QUEUE_MSG_SIZE];
+} publish_queue_entry;
+
+typedef struct
+{
+    publish_queue_entry entries[PUBLISH_QUEUE_DEPTH];
+    uint8_t             head;       /**< Oldest entry */
+    uint8_t             count;      /**< Entries not yet acknowledged - kept together from head */
+    volatile uint32_t   holdoff;    /**< Update periods until the next drain */
+    uint32_t            dropped;    /**< Messages discarded because the queue was full */
+    uint32_t            retransmits;/**< Messages resent with DUP */
+} publish_queue;
+
+void publish_queue_init(publish_queue *queue);
+void publish_queue_timer_update(publish_queue *queue);
+int publish_queue_push(publish_queue *queue, const uint8_t *payload, uint16_t length);
+int publish_queue_drain(publish_queue *queue, MQTTClient *mqtt_client, MQTTPublishTemplate *topic);
+uint32_t publish_queue_depth(publish_queue *queue);
+uint32_t publish_queue_dropped(publish_queue *queue);
+
+#endif /* PUBLISH_QUEUE_H_ */
@@ -0,0 +1,120 @@
+/**
+ * \file
+ * \brief  Reconnect backoff with a per-device jitter
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include <string.h>
+#include "reconnect_policy.h"
+
+/* Used when there is no serial number - every device then has the same jitter */
+#define RECONNECT_POLICY_DEFAULT_SEED   (0x9E3779B9)
+
+/* xorshift32 */
+static uint32_t reconnect_policy_random(reconnect_policy *policy)
+{
+    uint32_t x = policy->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    policy->seed = x;
+
+    return x;
+}
+
+/**
+ * \brief Set up a policy with no failures
+ *
+ * \param policy[in]                The policy
+ * \param base_ms[in]               Wait after the second failure in a row
+ * \param max_ms[in]                Longest wait
+ * \param serial[in]                Bytes unique to the device, such as the crypto device serial number - may be NULL
+ * \param serial_len[in]            The number of bytes
+ */
+void reconnect_policy_init(reconnect_policy *policy, uint32_t base_ms, uint32_t max_ms,
+    const uint8_t *serial, size_t serial_len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    memset(policy, 0, sizeof(*policy));
+    policy->base_ms = base_ms;
+    policy->max_ms = max_ms;
+
+    /* FNV-1a */
+    for (i = 0; serial && i < serial_len; i++)
+    {
+        hash = (hash ^ serial[i]) * 16777619u;
+    }
+
+    policy->seed = (serial && serial_len && hash) ? hash : RECONNECT_POLICY_DEFAULT_SEED;
+}
+
+/**
+ * \brief Count a failed attempt
+ *
+ * \param policy[in]                The policy
+ *
+ * \return    Milliseconds to wait before the next attempt
+ */
+uint32_t reconnect_policy_next(reconnect_policy *policy)
+{
+    uint32_t wait = policy->base_ms;
+    uint32_t half;
+    uint32_t i;
+
+    if (policy->failures++ == 0)
+    {
+        return 0;
+    }
+
+    for (i = 1; i < policy->failures - 1 && wait < policy->max_ms; i++)
+    {
+        wait *= 2;
+    }
+
+    if (wait > policy->max_ms)
+    {
+        wait = policy->max_ms;
+    }
+
+    half = wait / 2;
+
+    return half + (reconnect_policy_random(policy) % (wait - half + 1));
+}
+
+/**
+ * \brief Count a successful attempt - the next failure is retried straight away
+ *
+ * \param policy[in]                The policy
+ */
+void reconnect_policy_reset(reconnect_policy *policy)
+{
+    policy->failures = 0;
+}
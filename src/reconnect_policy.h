@@ -0,0 +1,56 @@
+/**
+ * \file
+ * \brief  Reconnect backoff with a per-device jitter
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef RECONNECT_POLICY_H_
+#define RECONNECT_POLICY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The first retry after a failure is immediate - most failures are a blip. After that the
+ * wait doubles from base_ms up to max_ms, and each wait is drawn from its upper half so that
+ * devices which lost the same access point or broker at the same moment do not retry together.
+ */
+typedef struct
+{
+    uint32_t    base_ms;    /**< Wait after the second failure in a row */
+    uint32_t    max_ms;     /**< Longest wait */
+    uint32_t    failures;   /**< Failed attempts since the last success */
+    uint32_t    seed;       /**< Jitter generator state - never 0 */
+} reconnect_policy;
+
+void reconnect_policy_init(reconnect_policy *policy, uint32_t base_ms, uint32_t max_ms,
+    const uint8_t *serial, size_t serial_len);
+uint32_t reconnect_policy_next(reconnect_policy *policy);
+void reconnect_policy_reset(reconnect_policy *policy);
+
+#endif /* RECONNECT_POLICY_H_ */
@@ -40,7 +40,7 @@
 #include "parson.h"
 #endif
 
-static uint16_t g_temp_speed_map[] = {
+static const uint16_t g_default_speed_map[SENSOR_SPEED_MAP_ENTRIES * 2] = {
     0,      0,
     24000,  1000,
     24500,  1500,
@@ -50,74 +50,77 @@ static uint16_t g_temp_speed_map[] = {
     27000,  4000
 };
 
-static uint16_t override_speed;
-static uint32_t override_end;
+/** \brief Set up a context with the default speed map */
+void sensor_init(sensor_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    memcpy(ctx->temp_speed_map, g_default_speed_map, sizeof(ctx->temp_speed_map));
+}
 
-static uint16_t get_speed_from_map(uint16_t temp)
+static uint16_t get_speed_from_map(sensor_context *ctx, uint16_t temp)
 {
     uint16_t i;
-    uint16_t target;
-    for(i=0; i < sizeof(g_temp_speed_map)/sizeof(g_temp_speed_map[0]); i += 2 )
+    uint16_t target = 0;
+    for(i=0; i < sizeof(ctx->temp_speed_map)/sizeof(ctx->temp_speed_map[0]); i += 2 )
     {
-        if(temp > g_temp_speed_map[i])
+        if(temp > ctx->temp_speed_map[i])
         {
-            target = g_temp_speed_map[i+1];
+            target = ctx->temp_speed_map[i+1];
         }
     }
     return target;
 }
 
 #ifdef CONFIG_USE_JSON_LIB
-bool update_settings_from_json(JSON_Array * json_map)
+bool update_settings_from_json(sensor_context *ctx, JSON_Array * json_map)
 {
     JSON_Array * json_array_element = NULL;
     uint8_t i;
 
-    for(i=0; i< json_array_get_count(json_map); i++)
+    /* A longer map would run into the rest of the context */
+    for(i=0; i< json_array_get_count(json_map) && i < SENSOR_SPEED_MAP_ENTRIES; i++)
     {
         json_array_element = json_array_get_array(json_map,i);
-        g_temp_speed_map[i*2] = json_array_get_number(json_array_element, 0);
-        g_temp_speed_map[i*2+1] = json_array_get_number(json_array_element, 1);
+        ctx->temp_speed_map[i*2] = json_array_get_number(json_array_element, 0);
+        ctx->temp_speed_map[i*2+1] = json_array_get_number(json_array_element, 1);
     }
-    for(i=i*2;i < sizeof(g_temp_speed_map)/2; i+= 2)
+    for(i=i*2;i < sizeof(ctx->temp_speed_map)/2; i+= 2)
     {
-        g_temp_speed_map[i] = UINT16_MAX;
+        ctx->temp_speed_map[i] = UINT16_MAX;
     }
+    return true;
 }
 
-bool override_from_json(JSON_Object * json_override_object)
+bool override_from_json(sensor_context *ctx, JSON_Object * json_override_object)
 {
 
-    override_speed = json_object_get_number(json_override_object, "fan-speed");
-    override_end = time_utils_get_utc() + json_object_get_number(json_override_object, "duration");
+    ctx->override_speed = json_object_get_number(json_override_object, "fan-speed");
+    ctx->override_end = time_utils_get_utc() + json_object_get_number(json_override_object, "duration");
+    return true;
 }
 
 #endif
 
-#define TEMP_SENSOR_SAMPLES    4
-static uint16_t g_temp_buffer[TEMP_SENSOR_SAMPLES];
-static uint8_t g_temp_buf_idx;
-
-static uint16_t get_averaged_temp(void)
+static uint16_t get_averaged_temp(sensor_context *ctx)
 {
     uint32_t avg;
     uint8_t i;
 
-    g_temp_buffer[g_temp_buf_idx++] = th5_read_sensor(0);
-    if(TEMP_SENSOR_SAMPLES <= g_temp_buf_idx)
+    ctx->temp_buffer[ctx->temp_buf_idx++] = th5_read_sensor(0);
+    if(SENSOR_TEMP_SAMPLES <= ctx->temp_buf_idx)
     {
-        g_temp_buf_idx = 0;
+        ctx->temp_buf_idx = 0;
     }
-    avg = g_temp_buffer[0];
-    for(i=1; i<TEMP_SENSOR_SAMPLES; i++ )
+    avg = ctx->temp_buffer[0];
+    for(i=1; i<SENSOR_TEMP_SAMPLES; i++ )
     {
-        avg += g_temp_buffer[i];
+        avg += ctx->temp_buffer[i];
     }
     
-    return (avg / TEMP_SENSOR_SAMPLES);
+    return (avg / SENSOR_TEMP_SAMPLES);
 }
 
-static void write_map_to_buffer(uint8_t *buffer, size_t buflen)
+static void write_map_to_buffer(sensor_context *ctx, uint8_t *buffer, size_t buflen)
 {
     uint16_t i;
     size_t bytes_writen;
@@ -130,9 +133,9 @@ static void write_map_to_buffer(uint8_t *buffer, size_t buflen)
     buffer[0] = '[';
     buffer++;
 
-    for(i=0; i < sizeof(g_temp_speed_map)/sizeof(g_temp_speed_map[0]) && 0 < buflen; i += 2)
+    for(i=0; i < sizeof(ctx->temp_speed_map)/sizeof(ctx->temp_speed_map[0]) && 0 < buflen; i += 2)
     {
-        bytes_writen = snprintf((char*)buffer, buflen, "[%d,%d],", g_temp_speed_map[i]/1000, g_temp_speed_map[i+1]);
+        bytes_writen = snprintf((char*)buffer, buflen, "[%d,%d],", ctx->temp_speed_map[i]/1000, ctx->temp_speed_map[i+1]);
         buffer += bytes_writen;
         buflen -= bytes_writen;
     }
@@ -144,47 +147,47 @@ static void write_map_to_buffer(uint8_t *buffer, size_t buflen)
     }
 }
 
-uint32_t sensor_get_temperature(void)
+uint32_t sensor_get_temperature(sensor_context *ctx)
 {
 #ifdef CONFIG_SENSOR_SIMULATOR
-	if (24000 > g_temp_buffer[0] || 30000 < g_temp_buffer[0])
+	if (24000 > ctx->temp_buffer[0] || 30000 < ctx->temp_buffer[0])
 	{
-		g_temp_buffer[0] = 24000;
+		ctx->temp_buffer[0] = 24000;
 	}
 	else
 	{
-		g_temp_buffer[0] += 1000;
+		ctx->temp_buffer[0] += 1000;
 	}
-	return g_temp_buffer[0];
+	return ctx->temp_buffer[0];
 #else
 	return th5_read_sensor(0);
 #endif
 }
 
-uint16_t sensor_get_fan_speed(void)
+uint16_t sensor_get_fan_speed(sensor_context *ctx)
 {
 #ifdef CONFIG_SENSOR_SIMULATOR
-	return get_speed_from_map(g_temp_buffer[0]);
+	return get_speed_from_map(ctx, ctx->temp_buffer[0]);
 #else
 	return fan_click_get_tach();
 #endif
 }
 
- void sensor_task(void)
+ void sensor_task(sensor_context *ctx)
 {
 #ifndef CONFIG_SENSOR_SIMULATOR
     uint16_t temp;
     uint16_t speed;
 
-    if(override_end <= time_utils_get_utc())
+    if(ctx->override_end <= time_utils_get_utc())
     {
         /* Get new sensor reading and target */
-        temp = get_averaged_temp();
-        speed = get_speed_from_map(temp);
+        temp = get_averaged_temp(ctx);
+        speed = get_speed_from_map(ctx, temp);
     }
     else
     {
-        speed = override_speed;
+        speed = ctx->override_speed;
     }
 
     /* Set new target */
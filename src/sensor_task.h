@@ -34,14 +34,29 @@
 
 #include "config.h"
 
-void sensor_task(void);
-uint32_t sensor_get_temperature(void);
-uint16_t sensor_get_fan_speed(void);
+/** Temperature (millidegrees) and fan speed pairs */
+#define SENSOR_SPEED_MAP_ENTRIES    (7)
+
+#define SENSOR_TEMP_SAMPLES         (4)
+
+/** A fan controller - set up by sensor_init */
+typedef struct _sensor_context {
+    uint16_t    temp_speed_map[SENSOR_SPEED_MAP_ENTRIES * 2];
+    uint16_t    override_speed;
+    uint32_t    override_end;
+    uint16_t    temp_buffer[SENSOR_TEMP_SAMPLES];
+    uint8_t     temp_buf_idx;
+} sensor_context;
+
+void sensor_init(sensor_context *ctx);
+void sensor_task(sensor_context *ctx);
+uint32_t sensor_get_temperature(sensor_context *ctx);
+uint16_t sensor_get_fan_speed(sensor_context *ctx);
 
 #ifdef CONFIG_USE_JSON_LIB
 #include "parson.h"
-bool update_settings_from_json(JSON_Array * json_map);
-bool override_from_json(JSON_Object * json_override_object);
+bool update_settings_from_json(sensor_context *ctx, JSON_Array * json_map);
+bool override_from_json(sensor_context *ctx, JSON_Object * json_override_object);
 #endif
 
 #endif /* SENSOR_TASK_H_ */
\ No newline at end of file
@@ -82,6 +82,9 @@ uint32_t time_utils_get_utc(void)
         rtc_get_time(RTC, &hour, &minute, &second);
         
         return time_utils_convert(year, month, day, hour, minute, second);
+#else
+        /* Host build - the board keeps UTC */
+        return host_time_utc();
 #endif
     }
     else
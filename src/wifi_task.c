@@ -50,41 +50,35 @@
 #define WIFI_PRINTF(...)  __NOP()
 #endif
 
-/* Global structures */
-static struct _g_wifi_context {
-    tiny_state_ctx      state;      /**< Must be the first element */
-	uint32_t            holdoff;
-    uint32_t            host;
-    SOCKET              sock;
-    uint8_t             rxbuf[WIFI_BUFFER_SIZE];
-    uint32_t            rxloc;
-    uint32_t            txlen;
-} g_wifi_context;
+/* The WINC driver callbacks carry no context - they act on the context that initialized the module */
+static wifi_context* g_wifi_winc;
 
 /* Check if the timeout has elapsed */
-static inline bool wifi_counter_finished(void)
+static inline bool wifi_counter_finished(wifi_context* ctx)
 {
-    return (0 == g_wifi_context.holdoff);
+    return (0 == ctx->holdoff);
 }
 
 /* Set timeout in milliseconds */
-static void wifi_counter_set(uint32_t val)
+static void wifi_counter_set(wifi_context* ctx, uint32_t val)
 {
     /* Convert to loop time*/
-    g_wifi_context.holdoff = val / WIFI_UPDATE_PERIOD;
+    ctx->holdoff = val / WIFI_UPDATE_PERIOD;
 
-    if(val && !g_wifi_context.holdoff)
+    if(val && !ctx->holdoff)
     {
-        g_wifi_context.holdoff = 1;
+        ctx->holdoff = 1;
     }
 }
 
 /* Must be called on the WIFI_UPDATE_PERIOD */
-void wifi_timer_update(void)
+void wifi_timer_update(wifi_context* ctx)
 {
-    if(g_wifi_context.holdoff)
+    ctx->clock++;
+
+    if(ctx->holdoff)
     {
-        g_wifi_context.holdoff--;
+        ctx->holdoff--;
     }
 }
 
@@ -99,24 +93,24 @@ enum {
     WIFI_STATE_ERROR        /**< Error states can be anywhere but are recommended at the end */
 } WIFI_STATES;
 
-int wifi_is_ready(void)
+int wifi_is_ready(wifi_context* ctx)
 {
-    return (WIFI_STATE_READY == g_wifi_context.state.state);
+    return (WIFI_STATE_READY == ctx->state.state);
 }
 
-int wifi_is_busy(void)
+int wifi_is_busy(wifi_context* ctx)
 {
-    return (WIFI_STATE_WAIT == g_wifi_context.state.state);
+    return (WIFI_STATE_WAIT == ctx->state.state);
 }
 
-int wifi_has_error(void)
+int wifi_has_error(wifi_context* ctx)
 {
-    return (WIFI_STATE_ERROR == g_wifi_context.state.state);
+    return (WIFI_STATE_ERROR == ctx->state.state);
 }
 
 static void wifi_state_update(void* ctx, uint32_t next, uint32_t wait)
 {
-    struct _g_wifi_context * pCtx = ctx;
+    wifi_context * pCtx = ctx;
 
     WIFI_PRINTF("%s(%u) -> %s(%u)\r\n", tiny_state_name(ctx, pCtx->state.state), 
         pCtx->state.state, tiny_state_name(ctx, next), next);
@@ -125,7 +119,100 @@ static void wifi_state_update(void* ctx, uint32_t next, uint32_t wait)
     tiny_state_update(ctx, next);
 
     /* Set the holdoff/wait */
-    wifi_counter_set(wait);
+    wifi_counter_set(pCtx, wait);
+}
+
+/* Go to the error state, to retry after the wait the reconnect policy gives */
+static void wifi_state_failed(wifi_context* ctx)
+{
+    if(WIFI_STATE_ERROR == ctx->state.state)
+    {
+        /* Already counted - one failure can be reported by more than one callback */
+        return;
+    }
+
+    wifi_state_update(ctx, WIFI_STATE_ERROR, reconnect_policy_next(&ctx->reconnect));
+}
+
+/* Bytes received and not yet read */
+static inline uint32_t wifi_rx_available(wifi_context* ctx)
+{
+    return ctx->rxhead - ctx->rxtail;
+}
+
+/* Check the ring has room for the largest single receive */
+static inline bool wifi_rx_has_room(wifi_context* ctx)
+{
+    return (WIFI_RX_RING_SIZE - wifi_rx_available(ctx)) >= WIFI_BUFFER_SIZE;
+}
+
+/* Post a receive straight into the ring at its head - the ring must have room */
+static sint16 wifi_rx_post(wifi_context* ctx, uint32_t timeout_ms)
+{
+    return recv(ctx->sock, &ctx->rxbuf[ctx->rxhead & (WIFI_RX_RING_SIZE - 1)], WIFI_BUFFER_SIZE, timeout_ms);
+}
+
+/* Keep a receive posted while the connection is open and the ring has room, so data
+   is moved to the ring as soon as it arrives rather than waiting in the WINC */
+static void wifi_rx_arm(wifi_context* ctx)
+{
+    if (ctx->sock_open && !ctx->rxpending && wifi_rx_has_room(ctx))
+    {
+        /* Posted with no timeout - it completes whenever data arrives */
+        if (SOCK_ERR_NO_ERROR == wifi_rx_post(ctx, 0))
+        {
+            ctx->rxpending = true;
+        }
+    }
+}
+
+/* Add the bytes a receive placed at the head to the ring */
+static void wifi_rx_commit(wifi_context* ctx, uint32_t length)
+{
+    uint32_t head = ctx->rxhead & (WIFI_RX_RING_SIZE - 1);
+
+    if (head + length > WIFI_RX_RING_SIZE)
+    {
+        /* The receive ran past the end of the ring - move that part to the start */
+        memcpy(&ctx->rxbuf[0], &ctx->rxbuf[WIFI_RX_RING_SIZE], head + length - WIFI_RX_RING_SIZE);
+    }
+
+    ctx->rxhead += length;
+}
+
+/* Take length bytes out of the ring - there must be that many */
+static void wifi_rx_copy(wifi_context* ctx, uint8_t *read_buffer, uint32_t length)
+{
+    uint32_t tail = ctx->rxtail & (WIFI_RX_RING_SIZE - 1);
+    uint32_t first = WIFI_RX_RING_SIZE - tail;
+
+    if (first > length)
+    {
+        first = length;
+    }
+
+    memcpy(&read_buffer[0], &ctx->rxbuf[tail], first);
+    memcpy(&read_buffer[first], &ctx->rxbuf[0], length - first);
+
+    ctx->rxtail += length;
+
+    /* A full ring left the receive unposted */
+    wifi_rx_arm(ctx);
+}
+
+/* Take whatever has been received, up to length bytes, out of the ring */
+static int wifi_rx_read(wifi_context* ctx, uint8_t *read_buffer, uint32_t length)
+{
+    uint32_t available = wifi_rx_available(ctx);
+
+    if (available > length)
+    {
+        available = length;
+    }
+
+    wifi_rx_copy(ctx, read_buffer, available);
+
+    return (int)available;
 }
 
 static sint8 wifi_print_winc_version(void)
@@ -153,9 +240,11 @@ static sint8 wifi_print_winc_version(void)
 
 static void wifi_socket_handler_cb(SOCKET sock, uint8 u8Msg, void * pvMsg)
 {
+    wifi_context* ctx = g_wifi_winc;
     tstrSocketConnectMsg *socket_connect_message = NULL;
     tstrSocketRecvMsg *socket_receive_message = NULL;
     sint16 *bytes_sent = NULL;
+    sint16 sent_length;
     
     // Check for the WINC1500 WIFI socket events
     switch (u8Msg)
@@ -166,11 +255,13 @@ static void wifi_socket_handler_cb(SOCKET sock, uint8 u8Msg, void * pvMsg)
         {
             if (socket_connect_message->s8Error != SOCK_ERR_NO_ERROR)
             {
-                wifi_state_update(&g_wifi_context, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
+                wifi_state_failed(ctx);
             }
             else
             {
-                wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
+                /* Reached the server - the next failure is retried straight away */
+                reconnect_policy_reset(&ctx->reconnect);
+                wifi_state_update(ctx, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
             }
         }
         break;
@@ -178,47 +269,63 @@ static void wifi_socket_handler_cb(SOCKET sock, uint8 u8Msg, void * pvMsg)
         case SOCKET_MSG_RECV:
         case SOCKET_MSG_RECVFROM:
         socket_receive_message = (tstrSocketRecvMsg*)pvMsg;
-        if (socket_receive_message != NULL)
+        if (socket_receive_message == NULL || !ctx->rxpending || sock != ctx->sock)
         {
-            if (socket_receive_message->s16BufferSize >= 0)
-            {
-                /* The message was received */
-                if (socket_receive_message->u16RemainingSize == 0)
-                {
-                    wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
-                }
-            }
-            else
+            /* Not the receive kept posted on the open connection */
+            break;
+        }
+
+        if (socket_receive_message->s16BufferSize > 0 && socket_receive_message->u16RemainingSize != 0)
+        {
+            /* More than the posted buffer - the driver delivers every chunk to the same place
+               in the ring, so the ones before the last would be overwritten. The buffer is
+               larger than a WINC socket buffer, so this is not expected. */
+            ctx->rxpending = false;
+            wifi_state_failed(ctx);
+        }
+        else if (socket_receive_message->s16BufferSize > 0)
+        {
+            /* The data is already in the ring */
+            wifi_rx_commit(ctx, socket_receive_message->s16BufferSize);
+
+            /* Post the next receive before anything else can arrive */
+            ctx->rxpending = false;
+            wifi_rx_arm(ctx);
+
+            if (ctx->rx_notify)
             {
-                if (socket_receive_message->s16BufferSize == SOCK_ERR_TIMEOUT)
-                {
-                    /* A timeout has occurred */
-                    wifi_state_update(&g_wifi_context, WIFI_STATE_TIMEOUT, WIFI_COUNTER_NO_WAIT);
-                }
-                else
-                {
-                    /* An error has occurred */
-                    wifi_state_update(&g_wifi_context, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
-                }
+                ctx->rx_notify(ctx->rx_notify_arg);
             }
         }
+        else
+        {
+            /* Posted without a timeout so this is always an error - or the peer closed the connection */
+            ctx->rxpending = false;
+            wifi_state_failed(ctx);
+        }
         break;
         
         case SOCKET_MSG_SEND:
         bytes_sent = (sint16*)pvMsg;
-        
-        if (*bytes_sent <= 0 || *bytes_sent > (int32_t)g_wifi_context.txlen)
+        if (bytes_sent == NULL || !ctx->txcount || sock != ctx->sock)
+        {
+            /* Not a send on the open connection */
+            break;
+        }
+
+        /* Sends complete in the order they were made */
+        sent_length = ctx->txlen[ctx->txhead];
+        ctx->txhead = (ctx->txhead + 1) % WIFI_TX_QUEUE_SIZE;
+        ctx->txcount--;
+
+        if (*bytes_sent != sent_length)
         {
+            // A short send has failed part way.
             // Seen an odd instance where bytes_sent is way more than the requested bytes sent.
             // This happens when we're expecting an error, so were assuming this is an error
             // condition.
 
-            wifi_state_update(&g_wifi_context, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
-        }
-        else if (*bytes_sent == g_wifi_context.txlen)
-        {
-            /* The message was sent */
-            wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
+            wifi_state_failed(ctx);
         }
         break;
 
@@ -228,19 +335,112 @@ static void wifi_socket_handler_cb(SOCKET sock, uint8 u8Msg, void * pvMsg)
     }
 }
 
+/* The cache entry for a hostname, NULL if it has none */
+static wifi_dns_entry* wifi_dns_find(wifi_context* ctx, const char* host)
+{
+    int i;
+
+    for (i = 0; i < WIFI_DNS_CACHE_SIZE; i++)
+    {
+        if (ctx->dns[i].name[0] && !strcmp(ctx->dns[i].name, host))
+        {
+            return &ctx->dns[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* The cache entry for a hostname, taking over the least recently resolved one if it has none */
+static wifi_dns_entry* wifi_dns_get(wifi_context* ctx, const char* host)
+{
+    wifi_dns_entry* entry = wifi_dns_find(ctx, host);
+    int i;
+
+    if (entry)
+    {
+        return entry;
+    }
+
+    /* Stop at an unused entry */
+    for (i = 0; i < WIFI_DNS_CACHE_SIZE && (!entry || entry->name[0]); i++)
+    {
+        if (!entry || !ctx->dns[i].name[0] ||
+            (ctx->clock - ctx->dns[i].resolved) > (ctx->clock - entry->resolved))
+        {
+            entry = &ctx->dns[i];
+        }
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    strcpy(entry->name, host);
+
+    return entry;
+}
+
+/* Check at least ms milliseconds have passed since the clock read since */
+static inline bool wifi_clock_passed(wifi_context* ctx, uint32_t since, uint32_t ms)
+{
+    return (ctx->clock - since) >= (ms / WIFI_UPDATE_PERIOD);
+}
+
+/* Ask for a name to be resolved again - returns false if the WINC did not take the request */
+static bool wifi_dns_refresh(wifi_context* ctx, wifi_dns_entry* entry)
+{
+    entry->refreshed = ctx->clock;
+
+    return (MQTTCLIENT_SUCCESS == gethostbyname((uint8*)entry->name));
+}
+
+/* Refresh an address on the next connect - it stays in use until the refresh answers */
+static void wifi_dns_expire(wifi_context* ctx, uint32_t addr)
+{
+    int i;
+
+    for (i = 0; i < WIFI_DNS_CACHE_SIZE; i++)
+    {
+        if (ctx->dns[i].addr == addr && !wifi_clock_passed(ctx, ctx->dns[i].resolved, WIFI_DNS_TTL))
+        {
+            ctx->dns[i].resolved = ctx->clock - (WIFI_DNS_TTL / WIFI_UPDATE_PERIOD);
+        }
+    }
+}
+
 static void wifi_resolve_handler_cb(uint8* pu8DomainName, uint32 u32ServerIP)
 {
+    wifi_context* ctx = g_wifi_winc;
+    wifi_dns_entry* entry = wifi_dns_find(ctx, (char*)pu8DomainName);
+
+    if (entry == NULL)
+    {
+        /* Not asked for */
+        return;
+    }
+
+    if (u32ServerIP != 0)
+    {
+        entry->addr = u32ServerIP;
+        entry->resolved = ctx->clock;
+    }
+
+    if (entry != ctx->dns_wait)
+    {
+        /* A background refresh - if it failed the cached address stays in use */
+        return;
+    }
+    ctx->dns_wait = NULL;
+
     if (u32ServerIP != 0)
     {
-        g_wifi_context.host = u32ServerIP;
+        ctx->host = u32ServerIP;
 
         /* Return to ready state */
-        wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
+        wifi_state_update(ctx, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
     }
     else
     {
         /* Failed to Resolve */
-        wifi_state_update(&g_wifi_context, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
+        wifi_state_failed(ctx);
     }
 }
 
@@ -249,20 +449,53 @@ static void wifi_tls_handler_cb(uint8 u8MsgType, void * pvMsg)
 
 }
 
+/* A join limited to the last channel failed - returns true if a scan of every channel has been started */
+static bool wifi_join_fallback(wifi_context* ctx)
+{
+    if(!ctx->joining || !ctx->join_channel)
+    {
+        return false;
+    }
+
+    WIFI_PRINTF("WINC1500 WIFI: Access point not on channel %u\r\n", ctx->join_channel);
+
+    /* The access point has moved - the next join finds it again */
+    ctx->ap_channel = 0;
+    ctx->joining = false;
+    wifi_state_update(ctx, WIFI_STATE_CONNECT, WIFI_COUNTER_NO_WAIT);
+
+    return true;
+}
+
 static void wifi_app_cb_process_connection(void *pvMsg)
 {
+    wifi_context* ctx = g_wifi_winc;
     tstrM2mWifiStateChanged* msg = (tstrM2mWifiStateChanged*)pvMsg;
     
     if(M2M_WIFI_CONNECTED == msg->u8CurrState)
     {
+        if(ctx->joining)
+        {
+            /* Joined - the rejoin wait only bounds the association, the DHCP lease gets the full wait */
+            wifi_counter_set(ctx, WIFI_COUNTER_CONNECT_WAIT);
+        }
+        ctx->joining = false;
         m2m_wifi_enable_sntp(1);
         WIFI_PRINTF("WINC1500 WIFI: Connected to the WIFI access point\r\n");
+
+        /* Find out which access point it was so the next join can skip the scan */
+        m2m_wifi_get_connection_info();
     }
     else if(M2M_WIFI_DISCONNECTED == msg->u8CurrState)
     {
         WIFI_PRINTF("WINC1500 WIFI: Disconnected from the WIFI access point\r\n");
 
-        wifi_state_update(&g_wifi_context, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
+        ctx->scanning = false;
+        if(!wifi_join_fallback(ctx))
+        {
+            ctx->joining = false;
+            wifi_state_failed(ctx);
+        }
     }
     else
     {
@@ -270,20 +503,85 @@ static void wifi_app_cb_process_connection(void *pvMsg)
     }
 }
 
+static void wifi_app_cb_process_conn_info(void *pvMsg)
+{
+    wifi_context* ctx = g_wifi_winc;
+    tstrM2MConnInfo* info = (tstrM2MConnInfo*)pvMsg;
+
+    memcpy(ctx->ap_bssid, info->au8MACAddress, sizeof(ctx->ap_bssid));
+
+    if(ctx->join_channel)
+    {
+        /* Joined on the last channel, so that is where it still is */
+        return;
+    }
+
+    /* The connection info has no channel - look the access point up in a scan */
+    if(M2M_SUCCESS == m2m_wifi_request_scan(M2M_WIFI_CH_ALL))
+    {
+        ctx->scanning = true;
+    }
+}
+
+static void wifi_app_cb_process_scan_done(void *pvMsg)
+{
+    wifi_context* ctx = g_wifi_winc;
+    tstrM2mScanDone* msg = (tstrM2mScanDone*)pvMsg;
+
+    if(!ctx->scanning)
+    {
+        return;
+    }
+
+    ctx->scan_count = msg->u8NumofCh;
+    ctx->scan_index = 0;
+    if(M2M_SUCCESS != msg->s8ScanState || !ctx->scan_count ||
+        M2M_SUCCESS != m2m_wifi_req_scan_result(ctx->scan_index))
+    {
+        ctx->scanning = false;
+    }
+}
+
+static void wifi_app_cb_process_scan_result(void *pvMsg)
+{
+    wifi_context* ctx = g_wifi_winc;
+    tstrM2mWifiscanResult* result = (tstrM2mWifiscanResult*)pvMsg;
+
+    if(!ctx->scanning)
+    {
+        return;
+    }
+
+    if(0 == memcmp(result->au8BSSID, ctx->ap_bssid, sizeof(ctx->ap_bssid)))
+    {
+        WIFI_PRINTF("WINC1500 WIFI: Access point on channel %u\r\n", result->u8ch);
+        ctx->ap_channel = result->u8ch;
+        ctx->scanning = false;
+    }
+    else if(++ctx->scan_index >= ctx->scan_count ||
+        M2M_SUCCESS != m2m_wifi_req_scan_result(ctx->scan_index))
+    {
+        /* Not found - joins keep scanning every channel */
+        ctx->scanning = false;
+    }
+}
+
 static void wifi_app_cb_process_dhcp(void *pvMsg)
 {
+    wifi_context* ctx = g_wifi_winc;
     tstrM2MIPConfig* ip_config = (tstrM2MIPConfig*)pvMsg;
     uint8_t * ip_address = (uint8_t*)&ip_config->u32StaticIP;
     
     WIFI_PRINTF("WINC1500 WIFI: Device IP Address: %u.%u.%u.%u\r\n",
-        ip_address[0], ip_address[1], ip_address[3], ip_address[4]);
+        ip_address[0], ip_address[1], ip_address[2], ip_address[3]);
 
     /* Transition to ready state */
-    wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
+    wifi_state_update(ctx, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
 }
 
 static void wifi_app_cb_process_time(void *pvMsg)
 {
+    wifi_context* ctx = g_wifi_winc;
     tstrSystemTime * msg = (tstrSystemTime *)pvMsg;
 
     WIFI_PRINTF("WINC1500 WIFI: Device Time:       %02d/%02d/%02d %02d:%02d:%02d\r\n",
@@ -301,7 +599,7 @@ static void wifi_app_cb_process_time(void *pvMsg)
     }
 
     /* Return to ready state */
-    wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
+    wifi_state_update(ctx, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
 }
 
 struct _wifi_app_cb {
@@ -311,12 +609,12 @@ struct _wifi_app_cb {
 
 static struct _wifi_app_cb wifi_app_cb_list[] = {
 	{ M2M_WIFI_RESP_CON_STATE_CHANGED, wifi_app_cb_process_connection },
-	//{ M2M_WIFI_RESP_CONN_INFO, NULL},
+    { M2M_WIFI_RESP_CONN_INFO, wifi_app_cb_process_conn_info},
     { M2M_WIFI_REQ_DHCP_CONF, wifi_app_cb_process_dhcp},
 	//{ M2M_WIFI_REQ_WPS, NULL},
 	//{ M2M_WIFI_RESP_IP_CONFLICT, NULL},
-	//{ M2M_WIFI_RESP_SCAN_DONE, NULL},
-	//{ M2M_WIFI_RESP_SCAN_RESULT, NULL},
+    { M2M_WIFI_RESP_SCAN_DONE, wifi_app_cb_process_scan_done},
+    { M2M_WIFI_RESP_SCAN_RESULT, wifi_app_cb_process_scan_result},
 	//{ M2M_WIFI_RESP_CURRENT_RSSI, NULL},
 	//{ M2M_WIFI_RESP_CLIENT_INFO, NULL},
 	//{ M2M_WIFI_RESP_PROVISION_INFO, NULL},
@@ -355,11 +653,14 @@ static void wifi_state_init(void * ctx)
     tstrWifiInitParam wifi_paramaters;
 
     /* Wait until the device has been "provisioned" or is configured to run */
-    if(!config_ready() || !wifi_counter_finished())
+    if(!config_ready() || !wifi_counter_finished(ctx))
     {
         return;
     }
 
+    /* There is one module - its events are delivered to this context */
+    g_wifi_winc = ctx;
+
     /* Perform the BSP Initialization for the WIFI module */
     nm_bsp_init();
 
@@ -371,7 +672,7 @@ static void wifi_state_init(void * ctx)
     if(M2M_SUCCESS != m2m_wifi_init(&wifi_paramaters))
     {
         WIFI_PRINTF("m2m_wifi_init failed\r\n");
-		wifi_counter_set(WIFI_COUNTER_CONNECT_WAIT);
+		wifi_counter_set(ctx, WIFI_COUNTER_CONNECT_WAIT);
         return;
     }
 
@@ -422,6 +723,8 @@ static void wifi_state_tls_init(void * ctx)
 /* Initialize the network connection */
 static void wifi_state_connect(void * ctx)
 {
+    wifi_context* pCtx = ctx;
+    uint16_t channel = pCtx->ap_channel ? pCtx->ap_channel : M2M_WIFI_CH_ALL;
     char ssid[WIFI_MAX_SSID_SIZE];
     char pass[WIFI_MAX_PASS_SIZE];
     int32_t status;
@@ -443,36 +746,45 @@ static void wifi_state_connect(void * ctx)
             break;
         }
 
-        /* Check the password length returned. If it's non zero then use it - if not assume an open AP */
+        /* Check the password length returned. If it's non zero then use it - if not assume an open AP.
+           Only the last access point's channel is tried if it is known - scanning them all takes seconds */
         if (strlen(pass) > 0)
         {
-            status = m2m_wifi_connect(ssid, strlen(ssid), M2M_WIFI_SEC_WPA_PSK, pass, M2M_WIFI_CH_ALL);
+            status = m2m_wifi_connect(ssid, strlen(ssid), M2M_WIFI_SEC_WPA_PSK, pass, channel);
         }
         else
         {
-            status = m2m_wifi_connect(ssid, strlen(ssid), M2M_WIFI_SEC_OPEN, pass, M2M_WIFI_CH_ALL);
+            status = m2m_wifi_connect(ssid, strlen(ssid), M2M_WIFI_SEC_OPEN, pass, channel);
         }
     } while(false);
 
     if (M2M_SUCCESS == status)
     {
+        pCtx->join_channel = pCtx->ap_channel;
+        pCtx->joining = true;
+        pCtx->scanning = false;
+
         /* Move to the next state */
-        wifi_state_update(ctx, WIFI_STATE_WAIT, WIFI_COUNTER_CONNECT_WAIT);
+        wifi_state_update(ctx, WIFI_STATE_WAIT,
+            pCtx->join_channel ? WIFI_COUNTER_REJOIN_WAIT : WIFI_COUNTER_CONNECT_WAIT);
     }
     else
     {
         /* Go to the error state */
-        wifi_state_update(ctx, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
+        wifi_state_failed(ctx);
     }
 }
 
 /* Wait last command to finish */
 static void wifi_state_wait(void * ctx)
 {
-    if(wifi_counter_finished())
+    if(wifi_counter_finished(ctx))
     {
         /* Command failed to finish in the given timeout */
-        wifi_state_update(ctx, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
+        if(!wifi_join_fallback(ctx))
+        {
+            wifi_state_failed(ctx);
+        }
     }
 }
 
@@ -491,7 +803,7 @@ static void wifi_state_timeout(void * ctx)
 /* Handle the generic error state */
 static void wifi_state_error(void * ctx)
 {
-    if(wifi_counter_finished())
+    if(wifi_counter_finished(ctx))
     {
         WIFI_PRINTF("Retrying Connection\r\n");
         wifi_state_update(ctx, WIFI_STATE_CONNECT, WIFI_COUNTER_NO_WAIT);
@@ -510,80 +822,104 @@ tiny_state_def g_wifi_states[] =
     TINY_STATE_DEF(WIFI_STATE_ERROR,            &wifi_state_error)
 };
 
-/* WIFI State Controller */
-void wifi_task(void)
+/** \brief Set up a context - required before any other call with it */
+void wifi_init(wifi_context* ctx)
 {
-    if(!g_wifi_context.state.count)
+    uint8_t serial[CONFIG_SERIAL_NUMBER_SIZE];
+    size_t serial_len = sizeof(serial);
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    /* Devices that lose the same access point must not all retry together */
+    if(config_get_serial_number(serial, sizeof(serial)))
     {
-        /* Perform the Initialization */
-        tiny_state_init(&g_wifi_context, g_wifi_states, sizeof(g_wifi_states)/sizeof(g_wifi_states[0]), WIFI_STATE_INIT);
+        serial_len = 0;
     }
+    reconnect_policy_init(&ctx->reconnect, WIFI_RECONNECT_BASE_WAIT, WIFI_COUNTER_RECONNECT_WAIT, serial, serial_len);
+
+    tiny_state_init(ctx, g_wifi_states, sizeof(g_wifi_states)/sizeof(g_wifi_states[0]), WIFI_STATE_INIT);
+}
 
+/* WIFI State Controller */
+void wifi_task(wifi_context* ctx)
+{
     /* Run the state machine*/
-    tiny_state_driver(&g_wifi_context);
+    tiny_state_driver(ctx);
 
     /* Handle WINC1500 pending events */
     m2m_wifi_handle_events(NULL);
 }
 
 /* Used internally for blocking calls */
-static inline void wifi_task_block_until_done(void)
+static inline void wifi_task_block_until_done(wifi_context* ctx)
 {
     do
     {
-        wifi_task();
-    } while (wifi_is_busy());
+        wifi_task(ctx);
+    } while (wifi_is_busy(ctx));
 }
 
 /* Request Time from NTP servers and update clock */
-void wifi_request_time(void)
+void wifi_request_time(wifi_context* ctx)
 {
-    if(wifi_is_ready())
+    if(wifi_is_ready(ctx))
     {
         m2m_wifi_get_sytem_time();
-        wifi_state_update(&g_wifi_context, WIFI_STATE_WAIT, WIFI_COUNTER_GET_TIME_WAIT);
+        wifi_state_update(ctx, WIFI_STATE_WAIT, WIFI_COUNTER_GET_TIME_WAIT);
     }
 }
 
-/* Request the winc to resolve a name */
-static void wifi_resolve_host(char * host)
+/* Request the winc to resolve a name and wait for it */
+static void wifi_resolve_host(wifi_context* ctx, wifi_dns_entry* entry)
 {
-    g_wifi_context.host = 0;
+    ctx->host = 0;
 
-    if(MQTTCLIENT_SUCCESS == gethostbyname((uint8*)host))
+    if(wifi_dns_refresh(ctx, entry))
     {
-        wifi_state_update(&g_wifi_context, WIFI_STATE_WAIT, WIFI_COUNTER_GET_TIME_WAIT);
+        ctx->dns_wait = entry;
+        wifi_state_update(ctx, WIFI_STATE_WAIT, WIFI_COUNTER_GET_TIME_WAIT);
     }
     else
     {
-        wifi_state_update(&g_wifi_context, WIFI_STATE_ERROR, WIFI_COUNTER_RECONNECT_WAIT);
+        wifi_state_failed(ctx);
     }
 }
 
-/* Connect to a host and create a socket - blocking call */
-int wifi_connect(char * host, int port)
+/* Use the cached address of a name if it has one, otherwise resolve it */
+static void wifi_lookup_host(wifi_context* ctx, wifi_dns_entry* entry)
 {
-    int status = MQTTCLIENT_FAILURE;
-    SOCKET new_socket = SOCK_ERR_INVALID;
-    struct sockaddr_in socket_address;
-    int optval;
-
-    if(!wifi_is_ready())
+    if(!entry->addr || wifi_clock_passed(ctx, entry->resolved, WIFI_DNS_STALE_LIMIT))
     {
-        return status;
+        wifi_resolve_host(ctx, entry);
+        return;
     }
 
-    /* Send the resolve command */
-    wifi_resolve_host(host);
+    /* Connect straight away */
+    ctx->host = entry->addr;
 
-    /* Wait for the command to complete or timeout */
-    wifi_task_block_until_done();
-
-    /* Check for failures */
-    if(!wifi_is_ready())
+    /* Refresh it for the next connect - unless a refresh may still be answered */
+    if(wifi_clock_passed(ctx, entry->resolved, WIFI_DNS_TTL) &&
+        wifi_clock_passed(ctx, entry->refreshed, WIFI_COUNTER_GET_TIME_WAIT))
     {
-        return status;
+        wifi_dns_refresh(ctx, entry);
     }
+}
+
+/* Steps of a non-blocking connect */
+enum
+{
+    WIFI_CONNECT_IDLE,
+    WIFI_CONNECT_RESOLVE,
+    WIFI_CONNECT_SOCKET
+};
+
+/* Create the socket and start connecting it to the resolved host */
+static int wifi_open_socket(wifi_context* ctx)
+{
+    int status = MQTTCLIENT_FAILURE;
+    SOCKET new_socket = SOCK_ERR_INVALID;
+    struct sockaddr_in socket_address;
+    int optval;
 
     // Create the socket
     new_socket = socket(AF_INET, SOCK_STREAM, 1);
@@ -595,8 +931,8 @@ int wifi_connect(char * host, int port)
         
     /* Set the socket information */
     socket_address.sin_family      = AF_INET;
-    socket_address.sin_addr.s_addr = g_wifi_context.host;
-    socket_address.sin_port        = _htons(port);
+    socket_address.sin_addr.s_addr = ctx->host;
+    socket_address.sin_port        = _htons(ctx->connect_port);
 
     optval = 1;
     setsockopt(new_socket, SOL_SSL_SOCKET, SO_SSL_ENABLE_SESSION_CACHING,
@@ -619,110 +955,298 @@ int wifi_connect(char * host, int port)
         return status;
     }
 
-    /* */
-    wifi_state_update(&g_wifi_context, WIFI_STATE_WAIT, WIFI_COUNTER_CONNECT_WAIT);
+    /* Completed by SOCKET_MSG_CONNECT */
+    wifi_state_update(ctx, WIFI_STATE_WAIT, WIFI_COUNTER_CONNECT_WAIT);
+    ctx->connect_sock = new_socket;
+
+    return MQTTCLIENT_SUCCESS;
+}
 
-    /* Wait for the command to complete or timeout */
-    wifi_task_block_until_done();
+/* Start connecting a socket to a host - finish with wifi_connect_step */
+int wifi_connect_start(wifi_context* ctx, char * host, int port)
+{
+    if(!wifi_is_ready(ctx) || ctx->connect_step != WIFI_CONNECT_IDLE)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
 
-    /* Check for failures */
-    if(!wifi_is_ready())
+    /* The WINC cannot resolve a longer name */
+    if(strlen(host) >= WIFI_DNS_NAME_SIZE)
     {
-        /* Close the socket */
-        close(new_socket);
         return MQTTCLIENT_FAILURE;
     }
 
-    /* Save the socket for use */
-    g_wifi_context.sock = new_socket;
+    /* The WINC has few sockets - never leak the last connection's */
+    wifi_disconnect(ctx);
+
+    ctx->connect_port = port;
+    ctx->connect_step = WIFI_CONNECT_RESOLVE;
+    ctx->dns_wait = NULL;
+
+    wifi_lookup_host(ctx, wifi_dns_get(ctx, host));
 
     return MQTTCLIENT_SUCCESS;
 }
 
-/* Read data from a socket - blocking call */
-int wifi_read_data(uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms)
+/* Advance a connect started by wifi_connect_start - returns MQTTCLIENT_IN_PROGRESS until it is done */
+int wifi_connect_step(wifi_context* ctx)
 {
-    int status = MQTTCLIENT_FAILURE;
-    
-    if(!wifi_is_ready())
+    if(ctx->connect_step == WIFI_CONNECT_IDLE)
     {
-        return status;
+        return MQTTCLIENT_FAILURE;
+    }
+
+    if(wifi_is_busy(ctx))
+    {
+        return MQTTCLIENT_IN_PROGRESS;
     }
 
-    if ((WIFI_BUFFER_SIZE - g_wifi_context.rxloc) >= read_length)
+    switch(ctx->connect_step)
     {
-        status = MQTTCLIENT_SUCCESS;
+        case WIFI_CONNECT_RESOLVE:
+        if(wifi_is_ready(ctx) && MQTTCLIENT_SUCCESS == wifi_open_socket(ctx))
+        {
+            ctx->connect_step = WIFI_CONNECT_SOCKET;
+            return MQTTCLIENT_IN_PROGRESS;
+        }
+        break;
+
+        case WIFI_CONNECT_SOCKET:
+        if(wifi_is_ready(ctx))
+        {
+            /* Save the socket for use */
+            ctx->sock = ctx->connect_sock;
+            ctx->sock_open = true;
 
-        /* Get the data from the existing received buffer */
-        memcpy(&read_buffer[0], &g_wifi_context.rxbuf[g_wifi_context.rxloc], read_length);
+            /* Nothing from a previous connection may be handed out */
+            ctx->rxhead = 0;
+            ctx->rxtail = 0;
+            ctx->rxpending = false;
+            wifi_rx_arm(ctx);
 
-        g_wifi_context.rxloc += read_length;
+            ctx->txhead = 0;
+            ctx->txcount = 0;
+
+            ctx->connect_step = WIFI_CONNECT_IDLE;
+            return MQTTCLIENT_SUCCESS;
+        }
+
+        /* Close the socket */
+        close(ctx->connect_sock);
+
+        /* The host may have moved */
+        wifi_dns_expire(ctx, ctx->host);
+        break;
+
+        default:
+        break;
     }
-    else
+
+    ctx->connect_step = WIFI_CONNECT_IDLE;
+    return MQTTCLIENT_FAILURE;
+}
+
+/* Close the connected socket, if there is one */
+void wifi_disconnect(wifi_context* ctx)
+{
+    if(ctx->sock_open)
+    {
+        close(ctx->sock);
+        ctx->sock_open = false;
+    }
+
+    /* A recv or send still outstanding on the old socket will never complete */
+    ctx->rxpending = false;
+    ctx->txcount = 0;
+}
+
+/* Set a function called, from wifi_task, each time received data lands in the ring */
+void wifi_set_rx_notify(wifi_context* ctx, void (*notify)(void *arg), void *arg)
+{
+    ctx->rx_notify = notify;
+    ctx->rx_notify_arg = arg;
+}
+
+/* Connect to a host and create a socket - blocking call */
+int wifi_connect(wifi_context* ctx, char * host, int port)
+{
+    int status;
+
+    if(MQTTCLIENT_SUCCESS != (status = wifi_connect_start(ctx, host, port)))
     {
-        g_wifi_context.rxloc = 0;
-        memset(&g_wifi_context.rxbuf[0], 0, WIFI_BUFFER_SIZE);
+        return status;
+    }
+
+    /* Wait for each step to complete or timeout */
+    while(MQTTCLIENT_IN_PROGRESS == (status = wifi_connect_step(ctx)))
+    {
+        wifi_task(ctx);
+    }
 
-        /* Receive the incoming message */
-        if(MQTTCLIENT_SUCCESS != (status = recv(g_wifi_context.sock, g_wifi_context.rxbuf, WIFI_BUFFER_SIZE, timeout_ms)))
+    return status;
+}
+
+/* Wait for the posted receive to bring in more - returns 1 when it does, 0 on a timeout or the MQTT status */
+static int wifi_rx_wait(wifi_context* ctx, uint32_t timeout_ms)
+{
+    Timer timer;
+    uint32_t head = ctx->rxhead;
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, timeout_ms);
+
+    while (ctx->rxhead == head)
+    {
+        /* Only a failed post leaves it unposted with room in the ring */
+        wifi_rx_arm(ctx);
+        if (!ctx->rxpending)
         {
-            return status;
+            return MQTTCLIENT_FAILURE;
+        }
+
+        if (TimerIsExpired(&timer))
+        {
+            return 0;
+        }
+
+        wifi_task(ctx);
+
+        if (wifi_has_error(ctx))
+        {
+            return MQTTCLIENT_FAILURE;
         }
+    }
+
+    return 1;
+}
+
+/* Read data from a socket - blocking call. Bytes already taken out of the ring when the
+   wait fails are returned as a short count rather than lost. */
+int wifi_read_data(wifi_context* ctx, uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms)
+{
+    Timer timer;
+    uint32_t copied = 0;
+    uint32_t available;
+    int status;
 
-        wifi_state_update(&g_wifi_context, WIFI_STATE_WAIT, timeout_ms + WIFI_UPDATE_PERIOD);
+    if(!wifi_is_ready(ctx))
+    {
+        return MQTTCLIENT_FAILURE;
+    }
 
-        /* Wait for the command to complete or timeout */
-        wifi_task_block_until_done();
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, timeout_ms);
+
+    while ((available = wifi_rx_available(ctx)) < (read_length - copied))
+    {
+        if (!ctx->rxpending && !wifi_rx_has_room(ctx))
+        {
+            /* Too long to wait for in the ring - hand over what is there to make room */
+            wifi_rx_copy(ctx, &read_buffer[copied], available);
+            copied += available;
+        }
 
-        /* Check for failures */
-        if(!wifi_is_ready())
+        if (1 != (status = wifi_rx_wait(ctx, TimerLeftMS(&timer))))
         {
-            status = MQTTCLIENT_FAILURE;
-            if(!wifi_has_error())
+            if (copied > 0)
             {
-                /* Timed out but we aren't going to retry */
-                wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
+                return (int)copied;
             }
+            return (status == 0) ? MQTTCLIENT_FAILURE : status;
         }
-        else
+    }
+
+    wifi_rx_copy(ctx, &read_buffer[copied], read_length - copied);
+
+    return (int)read_length;
+}
+
+/* Read whatever has been received, up to read_length bytes - blocks only while nothing is buffered */
+int wifi_read_some(wifi_context* ctx, uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms)
+{
+    int status;
+
+    if(!wifi_is_ready(ctx))
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    if (wifi_rx_available(ctx) == 0)
+    {
+        if (1 != (status = wifi_rx_wait(ctx, timeout_ms)))
         {
-            status = MQTTCLIENT_SUCCESS;
-            memcpy(&read_buffer[0], &g_wifi_context.rxbuf[0], read_length);
-            g_wifi_context.rxloc += read_length;
+            return status;
         }
     }
-    
-    return ((status == MQTTCLIENT_SUCCESS) ? (int)read_length : status);
+
+    return wifi_rx_read(ctx, read_buffer, read_length);
 }
 
-/* Send data to a socket - blocking call */
-int wifi_send_data(uint8_t *send_buffer, uint32_t send_length, uint32_t timeout_ms)
+/* Read whatever has been received, up to read_length bytes, without waiting */
+int wifi_read_poll(wifi_context* ctx, uint8_t *read_buffer, uint32_t read_length)
 {
-    int status = MQTTCLIENT_FAILURE;
-    
-    if(!wifi_is_ready())
+    if (wifi_rx_available(ctx) == 0)
     {
-        return status;
+        /* Only a failed post leaves it unposted with the ring empty */
+        wifi_rx_arm(ctx);
+        if (!ctx->rxpending)
+        {
+            return MQTTCLIENT_FAILURE;
+        }
+
+        /* Let the driver deliver anything that has already arrived */
+        wifi_task(ctx);
+
+        if(wifi_has_error(ctx))
+        {
+            return MQTTCLIENT_FAILURE;
+        }
     }
 
-    status = send(g_wifi_context.sock, send_buffer, send_length, 0);
-    g_wifi_context.txlen = send_length;
+    return wifi_rx_read(ctx, read_buffer, read_length);
+}
+
+/* Send data to a socket - returns once the WINC has taken a copy, waiting only while
+   WIFI_TX_QUEUE_SIZE sends are already in flight. Their completions arrive in the socket
+   callback, and a failed one puts the interface in error */
+int wifi_send_data(wifi_context* ctx, uint8_t *send_buffer, uint32_t send_length, uint32_t timeout_ms)
+{
+    Timer timer;
+    sint16 status = SOCK_ERR_BUFFER_FULL;
 
-    wifi_state_update(&g_wifi_context, WIFI_STATE_WAIT, WIFI_COUNTER_GET_TIME_WAIT);
+    if(!wifi_is_ready(ctx))
+    {
+        return MQTTCLIENT_FAILURE;
+    }
 
-    /* Wait for the command to complete or timeout */
-    wifi_task_block_until_done();
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, timeout_ms);
 
-    /* Check for failures */
-    if(!wifi_is_ready())
+    /* The WINC may also be out of buffers before the queue is full */
+    while (ctx->txcount == WIFI_TX_QUEUE_SIZE ||
+        SOCK_ERR_BUFFER_FULL == (status = send(ctx->sock, send_buffer, send_length, 0)))
     {
-        status = MQTTCLIENT_FAILURE;
-        if(!wifi_has_error())
+        if (TimerIsExpired(&timer))
+        {
+            return MQTTCLIENT_FAILURE;
+        }
+
+        /* Wait for a send to complete */
+        wifi_task(ctx);
+
+        if(!wifi_is_ready(ctx))
         {
-            /* Timed out but we aren't going to retry */
-            wifi_state_update(&g_wifi_context, WIFI_STATE_READY, WIFI_COUNTER_NO_WAIT);
+            return MQTTCLIENT_FAILURE;
         }
     }
-    
-    return ((status == MQTTCLIENT_SUCCESS) ? (int)send_length : status);
+
+    if (status != SOCK_ERR_NO_ERROR)
+    {
+        return MQTTCLIENT_FAILURE;
+    }
+
+    ctx->txlen[(ctx->txhead + ctx->txcount) % WIFI_TX_QUEUE_SIZE] = send_length;
+    ctx->txcount++;
+
+    return (int)send_length;
 }
@@ -32,6 +32,11 @@
 #ifndef WIFI_TASK_H_
 #define WIFI_TASK_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "tiny_state_machine.h"
+#include "reconnect_policy.h"
+
 /* WIFI Control Configuration */
 
 /** Maximum Allowed SSID Length */
@@ -40,28 +45,100 @@
 /** Maximum Allowed Password Length */
 #define WIFI_MAX_PASS_SIZE  64
 
-/** Maximum Static RX buffer to use */
+/** Access point BSSID length (M2M_MAC_ADDRES_LEN) */
+#define WIFI_BSSID_SIZE     (6)
+
+/** Largest single receive - more than the WINC delivers for one TCP segment */
 #define WIFI_BUFFER_SIZE    (1500)
 
+/** Receive ring size - must be a power of two */
+#define WIFI_RX_RING_SIZE   (2048)
+
+/** Largest single send the WINC accepts (SOCKET_BUFFER_MAX_LENGTH) */
+#define WIFI_MAX_SEND_SIZE  (1400)
+
+/** Sends in flight before wifi_send_data waits for one to complete */
+#define WIFI_TX_QUEUE_SIZE  (4)
+
+/** Hostnames whose addresses are kept across reconnects */
+#define WIFI_DNS_CACHE_SIZE (2)
+
+/** Longest hostname the WINC resolves (HOSTNAME_MAX_SIZE), with its terminator */
+#define WIFI_DNS_NAME_SIZE  (64 + 1)
+
 /* Wait times are specified in milliseconds */
 #define WIFI_COUNTER_NO_WAIT            0
 #define WIFI_COUNTER_GET_TIME_WAIT      10000
 #define WIFI_COUNTER_CONNECT_WAIT       10000
-#define WIFI_COUNTER_RECONNECT_WAIT     30000
+#define WIFI_COUNTER_REJOIN_WAIT        2000    /**< A join on the last channel - much quicker than a scan */
+#define WIFI_COUNTER_RECONNECT_WAIT     30000   /**< Longest wait before rejoining */
+#define WIFI_RECONNECT_BASE_WAIT        1000    /**< Wait after the second failure in a row */
+
+/* A cached address is refreshed in the background once older than the TTL,
+   and no longer connected to once older than the stale limit */
+#define WIFI_DNS_TTL                    300000
+#define WIFI_DNS_STALE_LIMIT            86400000
+
+/** An address resolved before */
+typedef struct _wifi_dns_entry {
+    char                name[WIFI_DNS_NAME_SIZE];
+    uint32_t            addr;       /**< 0 until the name has been resolved */
+    uint32_t            resolved;   /**< wifi_context clock when addr was resolved */
+    uint32_t            refreshed;  /**< wifi_context clock when a refresh was last asked for */
+} wifi_dns_entry;
+
+/** A network interface and its one connection - set up by wifi_init */
+typedef struct _wifi_context {
+    tiny_state_ctx      state;      /**< Must be the first element */
+    uint32_t            holdoff;
+    reconnect_policy    reconnect;  /**< Spaces out the retries after a failure */
+    uint32_t            clock;      /**< WIFI_UPDATE_PERIODs since wifi_init */
+    uint32_t            host;
+    uint8_t             ap_bssid[WIFI_BSSID_SIZE];  /**< The access point last joined */
+    uint8_t             ap_channel; /**< Its channel - 0 until known, when joins scan every channel */
+    uint8_t             join_channel;   /**< Channel the last join was limited to, 0 for a scan */
+    bool                joining;    /**< A join has been asked for and not answered */
+    bool                scanning;   /**< Looking for ap_bssid in a scan to learn ap_channel */
+    uint8_t             scan_count; /**< Access points the scan found */
+    uint8_t             scan_index; /**< The scan result asked for */
+    wifi_dns_entry      dns[WIFI_DNS_CACHE_SIZE];
+    wifi_dns_entry*     dns_wait;   /**< The entry the connect in progress is waiting to resolve */
+    int                 sock;
+    bool                sock_open;  /**< sock belongs to a connection that has not been closed */
+    uint8_t             rxbuf[WIFI_RX_RING_SIZE + WIFI_BUFFER_SIZE];    /**< Receive ring - a recv posted near the end runs on past it */
+    uint32_t            rxhead;     /**< Bytes received into the ring - free running */
+    uint32_t            rxtail;     /**< Bytes read out of the ring - free running */
+    bool                rxpending;  /**< The recv kept posted into the ring has not completed */
+    void                (*rx_notify)(void *arg);    /**< Called when data lands in the ring */
+    void                *rx_notify_arg;
+    uint8_t             connect_step;   /**< Where wifi_connect_step has got to */
+    int                 connect_sock;   /**< Socket being connected by wifi_connect_step */
+    uint16_t            connect_port;
+    uint16_t            txlen[WIFI_TX_QUEUE_SIZE];  /**< Length of each send not yet completed by the WINC */
+    uint8_t             txhead;     /**< The oldest send in txlen */
+    uint8_t             txcount;
+} wifi_context;
 
 /* WIFI Control API */
-void wifi_task(void);
-void wifi_timer_update(void);
-int wifi_is_ready(void);
-int wifi_is_busy(void);
-int wifi_has_error(void);
+void wifi_init(wifi_context *ctx);
+void wifi_task(wifi_context *ctx);
+void wifi_timer_update(wifi_context *ctx);
+int wifi_is_ready(wifi_context *ctx);
+int wifi_is_busy(wifi_context *ctx);
+int wifi_has_error(wifi_context *ctx);
 
 /* WIFI Feature API */
-void wifi_request_time(void);
+void wifi_request_time(wifi_context *ctx);
 
 /* WIFI Socket Handling API */
-int wifi_connect(char * host, int port);
-int wifi_read_data(uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms);
-int wifi_send_data(uint8_t *send_buffer, uint32_t send_length, uint32_t timeout_ms);
+int wifi_connect(wifi_context *ctx, char * host, int port);
+int wifi_connect_start(wifi_context *ctx, char * host, int port);
+int wifi_connect_step(wifi_context *ctx);
+void wifi_disconnect(wifi_context *ctx);
+void wifi_set_rx_notify(wifi_context *ctx, void (*notify)(void *arg), void *arg);
+int wifi_read_data(wifi_context *ctx, uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms);
+int wifi_read_some(wifi_context *ctx, uint8_t *read_buffer, uint32_t read_length, uint32_t timeout_ms);
+int wifi_read_poll(wifi_context *ctx, uint8_t *read_buffer, uint32_t read_length);
+int wifi_send_data(wifi_context *ctx, uint8_t *send_buffer, uint32_t send_length, uint32_t timeout_ms);
 
 #endif /* WIFI_TASK_H_ */
\ No newline at end of file
@@ -0,0 +1,87 @@
+/**
+ * \file
+ * \brief  WINC1500 SPI transfers split between the CPU and DMA
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#include "winc_bus.h"
+
+/**
+ * \brief Run one transfer with the chip select held throughout.
+ *
+ * \param ops[in]               The bus wrapper
+ * \param mosi[in]              Bytes to send, NULL if there is nothing to send
+ * \param miso[out]             Bytes received, NULL to discard them
+ * \param len[in]               Bytes each way
+ *
+ * \return    0, WINC_BUS_ERR_ARG if there is nothing to transfer or
+ *            WINC_BUS_ERR_DMA if a DMA transfer failed part way
+ */
+int winc_bus_transfer(const winc_bus_ops *ops, const uint8_t *mosi, uint8_t *miso, uint16_t len)
+{
+    uint16_t n;
+
+    if ((mosi == NULL && miso == NULL) || len == 0)
+    {
+        return WINC_BUS_ERR_ARG;
+    }
+
+    ops->select(ops->ctx, true);
+
+    while (len)
+    {
+        if (!ops->dma_min || len < ops->dma_min)
+        {
+            /* Short, or the tail of a long one */
+            ops->pio(ops->ctx, mosi, miso, len);
+            break;
+        }
+
+        n = (len > ops->dma_max) ? ops->dma_max : len;
+
+        if (ops->dma(ops->ctx, mosi, miso, n))
+        {
+            ops->select(ops->ctx, false);
+            return WINC_BUS_ERR_DMA;
+        }
+
+        if (mosi)
+        {
+            mosi += n;
+        }
+        if (miso)
+        {
+            miso += n;
+        }
+        len -= n;
+    }
+
+    ops->select(ops->ctx, false);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * \file
+ * \brief  WINC1500 SPI transfers split between the CPU and DMA
+ *
+ * \copyright (c) 2017 Microchip Technology Inc. and its subsidiaries.
+ *            You may use this software and any derivatives exclusively with
+ *            Microchip products.
+ *
+ * \page License
+ * 
+ * (c) 2017 Microchip Technology Inc. and its subsidiaries. You may use this
+ * software and any derivatives exclusively with Microchip products.
+ * 
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE, OR ITS INTERACTION WITH MICROCHIP PRODUCTS, COMBINATION
+ * WITH ANY OTHER PRODUCTS, OR USE IN ANY APPLICATION.
+ * 
+ * IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+ * INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+ * WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP HAS
+ * BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO THE
+ * FULLEST EXTENT ALLOWED BY LAW, MICROCHIPS TOTAL LIABILITY ON ALL CLAIMS IN
+ * ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT OF FEES, IF ANY,
+ * THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS SOFTWARE.
+ * 
+ * MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE OF THESE
+ * TERMS.
+ */
+
+#ifndef WINC_BUS_H_
+#define WINC_BUS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** winc_bus_transfer was given nothing to transfer */
+#define WINC_BUS_ERR_ARG    (-1)
+/** A DMA transfer failed - the chip select has been released */
+#define WINC_BUS_ERR_DMA    (-2)
+
+/**
+ * How a bus wrapper moves bytes. Most transfers the WINC driver makes are a few
+ * bytes of command or response, where setting up DMA costs more than it saves,
+ * so those are clocked by the CPU. Payloads go by DMA, in pieces no longer than
+ * the controller takes.
+ *
+ * A transfer has nothing to send (mosi NULL) or nothing to keep (miso NULL) on
+ * one side. pio and dma both handle that themselves, without splitting it.
+ *
+ * dma returns 0 once the bytes are through, or non-zero if the controller
+ * reported an error or did not finish in time. It leaves the controller stopped
+ * and ready for the next transfer either way.
+ */
+typedef struct _winc_bus_ops {
+    void        *ctx;   /**< Passed to the functions below */
+    void        (*select)(void *ctx, bool enable);  /**< Drive the chip select */
+    void        (*pio)(void *ctx, const uint8_t *mosi, uint8_t *miso, uint16_t len);
+    int         (*dma)(void *ctx, const uint8_t *mosi, uint8_t *miso, uint16_t len);    /**< Returns 0 when done */
+    uint16_t    dma_min;    /**< Shortest transfer given to dma - 0 for never */
+    uint16_t    dma_max;    /**< Longest transfer given to dma - at least dma_min */
+} winc_bus_ops;
+
+int winc_bus_transfer(const winc_bus_ops *ops, const uint8_t *mosi, uint8_t *miso, uint16_t len);
+
+#endif /* WINC_BUS_H_ */